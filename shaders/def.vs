@@ -2,7 +2,16 @@
 layout(location = 0) in vec3 pos;
 layout(location = 1) in vec4 color;
 out vec4 vs_color;
-uniform mat4 camera;
+layout(std140) uniform camera_block
+{
+	mat4 camera;
+	mat4 view;
+	mat4 projection;
+	mat4 inverseCamera;
+	vec3 camPos;
+	float time;
+};
+
 uniform mat4 model;
 void main(){
     gl_Position = camera * vec4(vec3(model * vec4(pos, 1.0f)), 1.0);
@@ -5,7 +5,23 @@ layout(location = 2) in vec3 norm;
 
 uniform mat4 model;
 
+layout(std140) uniform lighting_block
+{
+	mat4 lightProjection[4];
+	vec4 lightColor;
+	vec3 lightDir;
+	float ambient;
+	float specularStrength;
+	float cascade0range;
+	float cascade1range;
+	float cascade2range;
+	float cascade3range;
+	vec4 cascadeRect[4];
+};
+
+uniform int cascade; // shadow pass draws one cascade at a time
+
 void main()
 {
-    gl_Position = model * vec4(pos, 1.0);
+    gl_Position = lightProjection[cascade] * model * vec4(pos, 1.0);
 }
\ No newline at end of file
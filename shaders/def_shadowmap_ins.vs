@@ -2,11 +2,60 @@
 layout(location = 0) in vec3 pos;
 layout(location = 1) in vec2 tex;
 layout(location = 2) in vec3 norm;
+// instance attributes follow INS_FORMAT of the manager
+#if defined(INS_VOXEL)
+layout(location = 3) in ivec3 voxel;
+layout(location = 4) in uvec2 face_texture;
+#elif defined(INS_PACKED)
+layout(location = 3) in vec3 position;
+layout(location = 4) in vec3 scale;
+layout(location = 5) in vec4 rotation;
+layout(location = 6) in float text_id;
+#else
 layout(location = 3) in mat4 model;
 layout(location = 7) in mat4 normalMatrix;
 layout(location = 11) in float text_id;
+#endif
+
+layout(std140) uniform lighting_block
+{
+	mat4 lightProjection[4];
+	vec4 lightColor;
+	vec3 lightDir;
+	float ambient;
+	float specularStrength;
+	float cascade0range;
+	float cascade1range;
+	float cascade2range;
+	float cascade3range;
+	vec4 cascadeRect[4];
+};
+
+uniform int cascade; // shadow pass draws one cascade at a time
+
+#if defined(INS_VOXEL)
+const mat3 faces[6] = mat3[6](
+	mat3(0, 0, -1, 0, 1, 0, 1, 0, 0),
+	mat3(0, 0, 1, 0, 1, 0, -1, 0, 0),
+	mat3(1, 0, 0, 0, 0, -1, 0, 1, 0),
+	mat3(1, 0, 0, 0, 0, 1, 0, -1, 0),
+	mat3(1, 0, 0, 0, 1, 0, 0, 0, 1),
+	mat3(-1, 0, 0, 0, 1, 0, 0, 0, -1));
+#elif defined(INS_PACKED)
+vec3 rotate(vec4 q, vec3 v)
+{
+	return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+#endif
 
 void main()
 {
-    gl_Position = model * vec4(pos, 1.0);
-}
\ No newline at end of file
+#if defined(INS_VOXEL)
+    vec3 world = vec3(voxel) + faces[face_texture.x] * pos;
+#elif defined(INS_PACKED)
+    vec3 world = position + rotate(normalize(rotation), pos * scale);
+#else
+    vec3 world = vec3(model * vec4(pos, 1.0));
+#endif
+    gl_Position = lightProjection[cascade] * vec4(world, 1.0);
+}
@@ -7,7 +7,16 @@ out vec2 texCoord;
 out vec3 normal;
 out vec3 crntPos;
 
-uniform mat4 camera;
+layout(std140) uniform camera_block
+{
+	mat4 camera;
+	mat4 view;
+	mat4 projection;
+	mat4 inverseCamera;
+	vec3 camPos;
+	float time;
+};
+
 uniform mat4 model;
 uniform mat4 normalMatrix;
 
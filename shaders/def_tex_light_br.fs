@@ -5,25 +5,62 @@ in vec3 normal;
 in vec3 crntPos;
 flat in int texture_id;
 
-uniform sampler2D textures[32];
-uniform sampler2DArrayShadow shadowMap;
+uniform sampler2DArray materials;
 
-uniform vec4 lightColor;
-uniform vec3 lightDir;
-uniform float ambient;
-uniform float specularStrength;
-uniform vec3 camPos;
-uniform mat4 view;
+// material is array * 256 + layer, the draw binds its one array to materials.
+// 8388608 is added to materials whose v is clamped inside the texture instead of repeating
+vec4 sample_material(int material, vec2 uv)
+{
+	if (material >= 8388608)
+	{
+		material -= 8388608;
+		float edge = 0.5 / float(textureSize(materials, 0).y);
+		uv.y = clamp(uv.y, edge, 1.0 - edge);
+	}
+	return texture(materials, vec3(uv, material % 256));
+}
+uniform sampler2D shadowMap;
+
+layout(std140) uniform camera_block
+{
+	mat4 camera;
+	mat4 view;
+	mat4 projection;
+	mat4 inverseCamera;
+	vec3 camPos;
+	float time;
+};
 
-uniform mat4 lightProjection[4];
-uniform float cascade0range;
-uniform float cascade1range;
-uniform float cascade2range;
-uniform float cascade3range;
+layout(std140) uniform lighting_block
+{
+	mat4 lightProjection[4];
+	vec4 lightColor;
+	vec3 lightDir;
+	float ambient;
+	float specularStrength;
+	float cascade0range;
+	float cascade1range;
+	float cascade2range;
+	float cascade3range;
+	vec4 cascadeRect[4];
+};
 
-uniform float fog_start;
-uniform float fog_end;
-uniform vec3 fog_color;
+layout(std140) uniform fog_block
+{
+	vec3 fog_color;
+	float fog_start;
+	float fog_end;
+};
+
+// cascades share one atlas, coord is inside the cascade and outside of it is lit
+float sample_shadow(int cascade, vec2 coord, float depth)
+{
+	if(coord.x < 0 || coord.y < 0 || coord.x > 1 || coord.y > 1){
+		return 0;
+	}
+	vec4 rect = cascadeRect[cascade];
+	return depth > texture(shadowMap, rect.xy + coord * rect.zw).r ? 1 : 0;
+}
 
 void main(){
 	float depthValue = abs((view*vec4(crntPos,1.0f)).z);
@@ -65,15 +102,12 @@ void main(){
 			lightCoords = (lightCoords + 1.0f) / 2.0f;
 			float currentDepth = lightCoords.z;
 			int sampleRadius = 3;
-			vec2 pixelSize = 1.0 / vec2(textureSize(shadowMap, 0));
+			vec2 pixelSize = 1.0 / (vec2(textureSize(shadowMap, 0)) * cascadeRect[layer].zw);
 			for(int y = -sampleRadius; y <= sampleRadius; y++)
 			{
 				for(int x = -sampleRadius; x <= sampleRadius; x++)
 				{
-					float closestDepth = texture(shadowMap, vec4(lightCoords.xy + vec2(x, y) * pixelSize, layer, 1));
-					if (currentDepth > closestDepth){
-						shadow += 1.0f;     
-					}
+					shadow += sample_shadow(layer, lightCoords.xy + vec2(x, y) * pixelSize, currentDepth);
 				}    
 			}
 			shadow /= pow((sampleRadius * 2 + 1), 2);
@@ -82,7 +116,7 @@ void main(){
 
 	diffuse = diffuse * (1.0f - shadow);
 	specular = specular * (1.0f - shadow);
-	FragColor = texture(textures[texture_id], texCoord) * lightColor * (diffuse + ambient + specular);
+	FragColor = sample_material(texture_id, texCoord) * lightColor * (diffuse + ambient + specular);
 
 	float dist = distance(vec3(crntPos.x,0,crntPos.z), vec3(camPos.x,0,camPos.z));
 
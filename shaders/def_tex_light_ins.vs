@@ -2,21 +2,70 @@
 layout(location = 0) in vec3 pos;
 layout(location = 1) in vec2 tex;
 layout(location = 2) in vec3 norm;
+// instance attributes follow INS_FORMAT of the manager
+#if defined(INS_VOXEL)
+layout(location = 3) in ivec3 voxel;
+layout(location = 4) in uvec2 face_texture;
+#elif defined(INS_PACKED)
+layout(location = 3) in vec3 position;
+layout(location = 4) in vec3 scale;
+layout(location = 5) in vec4 rotation;
+layout(location = 6) in float text_id;
+#else
 layout(location = 3) in mat4 model;
 layout(location = 7) in mat4 normalMatrix;
 layout(location = 11) in float text_id; 
+#endif
 
 out vec2 texCoord;
 out vec3 normal;
 out vec3 crntPos;
 flat out int texture_id;
 
-uniform mat4 camera;
+layout(std140) uniform camera_block
+{
+	mat4 camera;
+	mat4 view;
+	mat4 projection;
+	mat4 inverseCamera;
+	vec3 camPos;
+	float time;
+};
+
+#if defined(INS_VOXEL)
+// tangent, bitangent and normal of every face, same as ins_face_basis
+const mat3 faces[6] = mat3[6](
+	mat3(0, 0, -1, 0, 1, 0, 1, 0, 0),
+	mat3(0, 0, 1, 0, 1, 0, -1, 0, 0),
+	mat3(1, 0, 0, 0, 0, -1, 0, 1, 0),
+	mat3(1, 0, 0, 0, 0, 1, 0, -1, 0),
+	mat3(1, 0, 0, 0, 1, 0, 0, 0, 1),
+	mat3(-1, 0, 0, 0, 1, 0, 0, 0, -1));
+#elif defined(INS_PACKED)
+vec3 rotate(vec4 q, vec3 v)
+{
+	return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+#endif
 
 void main(){
+#if defined(INS_VOXEL)
+	// faces are rotations so the normal needs no inverse
+	mat3 face = faces[face_texture.x];
+	crntPos = vec3(voxel) + face * pos;
+	normal = normalize(face * norm);
+	texture_id = int(face_texture.y);
+#elif defined(INS_PACKED)
+	vec4 q = normalize(rotation);
+	crntPos = position + rotate(q, pos * scale);
+	// inverse transpose of rotation * scale is rotation / scale
+	normal = normalize(rotate(q, norm / scale));
+	texture_id = int(text_id);
+#else
 	crntPos = vec3(model * vec4(pos, 1.0f));
-  gl_Position = camera * vec4(crntPos, 1.0f);
 	normal = normalize(norm * mat3(normalMatrix));
-	texCoord = tex;
 	texture_id = int(text_id);
-}
\ No newline at end of file
+#endif
+  gl_Position = camera * vec4(crntPos, 1.0f);
+	texCoord = tex;
+}
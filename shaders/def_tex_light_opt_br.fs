@@ -10,18 +10,62 @@ in float diffuse;
 in float fogmult;
 flat in int texture_id;
 
-uniform sampler2D textures[32];
-uniform vec4 lightColor;
-uniform float ambient;
-uniform vec3 fog_color;
+uniform sampler2DArray materials;
 
-uniform mat4 view;
-uniform mat4 lightProjection[4];
-uniform float cascade0range;
-uniform float cascade1range;
-uniform float cascade2range;
-uniform float cascade3range;
-uniform sampler2DArrayShadow shadowMap;
+// material is array * 256 + layer, the draw binds its one array to materials.
+// 8388608 is added to materials whose v is clamped inside the texture instead of repeating
+vec4 sample_material(int material, vec2 uv)
+{
+	if (material >= 8388608)
+	{
+		material -= 8388608;
+		float edge = 0.5 / float(textureSize(materials, 0).y);
+		uv.y = clamp(uv.y, edge, 1.0 - edge);
+	}
+	return texture(materials, vec3(uv, material % 256));
+}
+layout(std140) uniform camera_block
+{
+	mat4 camera;
+	mat4 view;
+	mat4 projection;
+	mat4 inverseCamera;
+	vec3 camPos;
+	float time;
+};
+
+layout(std140) uniform lighting_block
+{
+	mat4 lightProjection[4];
+	vec4 lightColor;
+	vec3 lightDir;
+	float ambient;
+	float specularStrength;
+	float cascade0range;
+	float cascade1range;
+	float cascade2range;
+	float cascade3range;
+	vec4 cascadeRect[4];
+};
+
+layout(std140) uniform fog_block
+{
+	vec3 fog_color;
+	float fog_start;
+	float fog_end;
+};
+
+uniform sampler2D shadowMap;
+
+// cascades share one atlas, coord is inside the cascade and outside of it is lit
+float sample_shadow(int cascade, vec2 coord, float depth)
+{
+	if(coord.x < 0 || coord.y < 0 || coord.x > 1 || coord.y > 1){
+		return 0;
+	}
+	vec4 rect = cascadeRect[cascade];
+	return depth > texture(shadowMap, rect.xy + coord * rect.zw).r ? 1 : 0;
+}
 
 void main(){
 
@@ -53,22 +97,19 @@ void main(){
 			lightCoords = (lightCoords + 1.0f) / 2.0f;
 			float currentDepth = lightCoords.z;
 			int sampleRadius = 3;
-			vec2 pixelSize = 1.0 / vec2(textureSize(shadowMap, 0));
+			vec2 pixelSize = 1.0 / (vec2(textureSize(shadowMap, 0)) * cascadeRect[layer].zw);
 			for(int y = -sampleRadius; y <= sampleRadius; y++)
 			{
 				for(int x = -sampleRadius; x <= sampleRadius; x++)
 				{
-					float closestDepth = texture(shadowMap, vec4(lightCoords.xy + vec2(x, y) * pixelSize, layer, 1));
-					if (currentDepth > closestDepth){
-						shadow += 1.0f;     
-					}
+					shadow += sample_shadow(layer, lightCoords.xy + vec2(x, y) * pixelSize, currentDepth);
 				}    
 			}
 			shadow /= pow((sampleRadius * 2 + 1), 2);
 		}
 	}
 
-	vec4 color = texture(textures[texture_id], texCoord) * lightColor * (diffuse * (1.0f - shadow) + ambient + specular * (1.0f - shadow));
+	vec4 color = sample_material(texture_id, texCoord) * lightColor * (diffuse * (1.0f - shadow) + ambient + specular * (1.0f - shadow));
 	FragColor.xyz = color.xyz * (1 - fogmult) + fog_color * fogmult;
 	FragColor.a = 1.0f;
 }
\ No newline at end of file
@@ -12,18 +12,39 @@ out float diffuse;
 out float fogmult;
 flat out int texture_id;
 
-uniform mat4 camera;
-uniform mat4 model;
-uniform mat4 normalMatrix;
+layout(std140) uniform camera_block
+{
+	mat4 camera;
+	mat4 view;
+	mat4 projection;
+	mat4 inverseCamera;
+	vec3 camPos;
+	float time;
+};
 
-uniform vec3 lightDir;
-uniform float specularStrength;
+layout(std140) uniform lighting_block
+{
+	mat4 lightProjection[4];
+	vec4 lightColor;
+	vec3 lightDir;
+	float ambient;
+	float specularStrength;
+	float cascade0range;
+	float cascade1range;
+	float cascade2range;
+	float cascade3range;
+	vec4 cascadeRect[4];
+};
 
-uniform vec3 camPos;
-uniform mat4 view;
+layout(std140) uniform fog_block
+{
+	vec3 fog_color;
+	float fog_start;
+	float fog_end;
+};
 
-uniform float fog_start;
-uniform float fog_end;
+uniform mat4 model;
+uniform mat4 normalMatrix;
 
 void main(){
 	crntPos = vec3(model * vec4(pos, 1.0f));
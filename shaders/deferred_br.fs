@@ -4,52 +4,176 @@ out vec4 FragColor;
 
 in vec2 TexCoords;
 
-uniform sampler2D gPosition;
+uniform sampler2D gDepth;
 uniform sampler2D gNormal;
 uniform sampler2D gTexCoord;
 uniform sampler2D ssao;
 
-uniform vec4 lightColor;
-uniform float ambient;
-uniform vec3 fog_color;
-
-uniform vec3 lightDir;
-uniform float specularStrength;
-uniform vec3 camPos;
-uniform float fog_start;
-uniform float fog_end;
-
-uniform mat4 view;
-uniform mat4 lightProjection[4];
-uniform float cascade0range;
-uniform float cascade1range;
-uniform float cascade2range;
-uniform float cascade3range;
-uniform sampler2DArrayShadow shadowMap;
-
-uniform int has_ssao;
+layout(std140) uniform camera_block
+{
+	mat4 camera;
+	mat4 view;
+	mat4 projection;
+	mat4 inverseCamera;
+	vec3 camPos;
+	float time;
+};
+
+layout(std140) uniform lighting_block
+{
+	mat4 lightProjection[4];
+	vec4 lightColor;
+	vec3 lightDir;
+	float ambient;
+	float specularStrength;
+	float cascade0range;
+	float cascade1range;
+	float cascade2range;
+	float cascade3range;
+	vec4 cascadeRect[4];
+	vec4 clusterParams;
+};
+
+layout(std140) uniform postprocess_block
+{
+	vec2 screenResolution;
+	vec2 renderScale;
+	vec2 ssaoScale;
+	int vignette;
+	int kernel;
+	int wave;
+	int inverse;
+	int fxaa;
+};
+
+layout(std140) uniform fog_block
+{
+	vec3 fog_color;
+	float fog_start;
+	float fog_end;
+};
+
+uniform sampler2D shadowMap;
+
+#ifdef POINT_LIGHTS
+// same as LIGHT_CLUSTER_X, Y and Z in lighting.h
+const ivec3 clusterGrid = ivec3(16, 9, 24);
+
+// 3 texels per light: position and radius, color and inner cone, spot direction and outer cone
+uniform samplerBuffer lightData;
+// offset in lightIndices and light count of every cluster
+uniform usamplerBuffer lightClusters;
+uniform usamplerBuffer lightIndices;
+
+// diffuse and specular of the lights in the cluster of this pixel
+vec3 cluster_lights(vec3 position, vec3 normal, float depth)
+{
+	ivec2 tile = min(ivec2(TexCoords * vec2(clusterGrid.xy)), clusterGrid.xy - 1);
+	int slice = clamp(int(log(depth) * clusterParams.x - clusterParams.y), 0, clusterGrid.z - 1);
+	uvec2 cluster = texelFetch(lightClusters, (slice * clusterGrid.y + tile.y) * clusterGrid.x + tile.x).rg;
+	vec3 viewDirection = normalize(camPos - position);
+	vec3 result = vec3(0);
+	for(uint i = 0u; i < cluster.y; i++){
+		int light = int(texelFetch(lightIndices, int(cluster.x + i)).r) * 3;
+		vec4 lightPos = texelFetch(lightData, light);
+		vec3 toLight = lightPos.xyz - position;
+		float dist = length(toLight);
+		if(dist >= lightPos.w){
+			continue;
+		}
+		toLight /= dist;
+		vec4 color = texelFetch(lightData, light + 1);
+		vec4 spot = texelFetch(lightData, light + 2);
+		// smooth falloff that reaches 0 at the radius
+		float falloff = pow(clamp(1.0 - pow(dist / lightPos.w, 4), 0, 1), 2) / (dist * dist + 1.0);
+		falloff *= smoothstep(spot.w, color.w, dot(-toLight, spot.xyz));
+		float diff = max(dot(normal, toLight), 0.0f);
+		float spec = diff > 0 ? pow(max(dot(viewDirection, reflect(-toLight, normal)), 0.0f), 2) * specularStrength : 0;
+		result += color.rgb * (diff + spec) * falloff;
+	}
+	return result;
+}
+#endif
+
+vec3 decode_normal(vec2 e)
+{
+  e = e * 2.0 - 1.0;
+  vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+  float t = clamp(-n.z, 0, 1);
+  n.x += n.x >= 0 ? -t : t;
+  n.y += n.y >= 0 ? -t : t;
+  return normalize(n);
+}
+
+// world position from depth
+vec3 get_position(vec2 coord)
+{
+  vec4 pos = inverseCamera * vec4(vec3(coord, texture(gDepth, coord * renderScale).r) * 2.0 - 1.0, 1.0);
+  return pos.xyz / pos.w;
+}
+
+// cascades share one atlas, coord is inside the cascade and outside of it is lit
+float sample_shadow(int cascade, vec2 coord, float depth)
+{
+	if(coord.x < 0 || coord.y < 0 || coord.x > 1 || coord.y > 1){
+		return 0;
+	}
+	vec4 rect = cascadeRect[cascade];
+	return depth > texture(shadowMap, rect.xy + coord * rect.zw).r ? 1 : 0;
+}
+
+#ifdef SSAO_UPSAMPLE
+// ssao is smaller than the g-buffer, its 4 nearest texels are weighted by how close
+// their depth and normal are to this pixel so occlusion does not bleed over edges
+float upsample_ssao(vec2 uv, vec3 position, vec3 normal)
+{
+	vec2 size = vec2(textureSize(ssao, 0));
+	vec2 last = floor(ssaoScale * size) - 1;
+	vec2 pos = uv * ssaoScale * size - 0.5;
+	vec2 base = floor(pos);
+	vec2 f = pos - base;
+	float dist = distance(camPos, position);
+	float result = 0;
+	float total = 0;
+	for(int i = 0; i < 4; i++){
+		vec2 corner = vec2(i % 2, i / 2);
+		vec2 texel = clamp(base + corner, vec2(0), last);
+		vec2 screen = (texel + 0.5) / size / ssaoScale;
+		vec3 p = get_position(screen);
+		vec3 n = decode_normal(texture(gNormal, screen * renderScale).rg);
+		vec2 b = mix(1.0 - f, f, corner);
+		float w = b.x * b.y * (pow(max(dot(n, normal), 0), 8) / (0.001 + abs(distance(camPos, p) - dist) / dist) + 0.0001);
+		result += texelFetch(ssao, ivec2(texel), 0).r * w;
+		total += w;
+	}
+	return result / total;
+}
+#endif
 
 void main(){
-	vec4 gpos=texture(gPosition, TexCoords);
-	vec4 gnorm=texture(gNormal, TexCoords);
-	vec4 gtex=texture(gTexCoord, TexCoords);
+	// targets are only filled up to renderScale
+	vec2 coord=TexCoords*renderScale;
+	vec4 gtex=texture(gTexCoord, coord);
 	float AmbientOcclusion = 1;
-	
-	if(has_ssao==1){
-		AmbientOcclusion=texture(ssao, TexCoords).r;
-	}
 
   vec3 rgb=gtex.xyz;
-  vec3 normal=gnorm.xyz;
-  vec3 crntPos=gpos.xyz;
   float specular=0;
   float diffuse=0;
   float fogmult=0;
 
-	if(length(normal)==0){
+	// nothing but sky was drawn here
+	if(texture(gDepth, coord).r==1.0){
 		FragColor=vec4(rgb,1);
 		return;
 	}
+	vec3 normal=decode_normal(texture(gNormal, coord).rg);
+	vec3 crntPos=get_position(TexCoords);
+
+#if defined(SSAO_UPSAMPLE)
+	AmbientOcclusion=upsample_ssao(TexCoords, crntPos, normal);
+#elif defined(SSAO)
+	AmbientOcclusion=texture(ssao, coord).r;
+#endif
 
 	vec3 lightDirection = normalize(lightDir);
 	diffuse = max(dot(normal, lightDirection), 0.0f);
@@ -60,6 +184,7 @@ void main(){
 		float specAmount = pow(max(dot(viewDirection, reflectionDirection), 0.0f), 2);
 		specular = specAmount * specularStrength;
 	}
+#ifdef FOG
 	float dist = distance(vec3(crntPos.x,0,crntPos.z), vec3(camPos.x,0,camPos.z));
 
 	if(dist >= fog_start){
@@ -73,6 +198,7 @@ void main(){
 	else{
 		fogmult = 0;
 	}
+#endif
 
 	float depthValue = abs((view*vec4(crntPos,1.0f)).z);
 	int layer = -1;
@@ -102,15 +228,12 @@ void main(){
 			lightCoords = (lightCoords + 1.0f) / 2.0f;
 			float currentDepth = lightCoords.z;
 			int sampleRadius = 3;
-			vec2 pixelSize = 1.0 / vec2(textureSize(shadowMap, 0));
+			vec2 pixelSize = 1.0 / (vec2(textureSize(shadowMap, 0)) * cascadeRect[layer].zw);
 			for(int y = -sampleRadius; y <= sampleRadius; y++)
 			{
 				for(int x = -sampleRadius; x <= sampleRadius; x++)
 				{
-					float closestDepth = texture(shadowMap, vec4(lightCoords.xy + vec2(x, y) * pixelSize, layer, 1));
-					if (currentDepth > closestDepth){
-						shadow += 1.0f;     
-					}
+					shadow += sample_shadow(layer, lightCoords.xy + vec2(x, y) * pixelSize, currentDepth);
 				}    
 			}
 			shadow /= pow((sampleRadius * 2 + 1), 2);
@@ -118,6 +241,9 @@ void main(){
 	}
 
 	vec4 color = vec4(rgb,1) * lightColor * (diffuse * (1.0f - shadow) + ambient + specular * (1.0f - shadow)) * AmbientOcclusion;
+#ifdef POINT_LIGHTS
+	color.rgb += rgb * cluster_lights(crntPos, normal, depthValue) * AmbientOcclusion;
+#endif
 	FragColor.xyz = color.xyz * (1 - fogmult) + fog_color * fogmult;
 	FragColor.a = 1.0f;
 	//FragColor=vec4(AmbientOcclusion,AmbientOcclusion,AmbientOcclusion,1);
@@ -1,19 +1,37 @@
 #version 400 core
-layout (location = 0) out vec3 gPosition;
-layout (location = 1) out vec3 gNormal;
-layout (location = 2) out vec3 gTexCoord;
-layout (location = 3) out vec3 gTexCoordcopy;
+layout (location = 0) out vec2 gNormal;
+layout (location = 1) out vec3 gTexCoord;
 
 in vec2 texCoord;
 in vec3 normal;
-in vec3 crntPos;
 flat in float texture_id;
 
-uniform sampler2D textures[32];
+uniform sampler2DArray materials;
+
+// material is array * 256 + layer, the draw binds its one array to materials.
+// 8388608 is added to materials whose v is clamped inside the texture instead of repeating
+vec4 sample_material(int material, vec2 uv)
+{
+	if (material >= 8388608)
+	{
+		material -= 8388608;
+		float edge = 0.5 / float(textureSize(materials, 0).y);
+		uv.y = clamp(uv.y, edge, 1.0 - edge);
+	}
+	return texture(materials, vec3(uv, material % 256));
+}
+
+// octahedral normal, folded into [0-1] for the rg16 target
+vec2 encode_normal(vec3 n)
+{
+  n /= abs(n.x) + abs(n.y) + abs(n.z);
+  if(n.z < 0){
+    n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0 ? 1 : -1, n.y >= 0 ? 1 : -1);
+  }
+  return n.xy * 0.5 + 0.5;
+}
 
 void main(){
-  gPosition=crntPos;
-  gNormal=normal;
-  gTexCoord=vec3(texture(textures[int(texture_id)], texCoord));
-  gTexCoordcopy=gTexCoord;
+  gNormal=encode_normal(normalize(normal));
+  gTexCoord=vec3(sample_material(int(texture_id), texCoord));
 }
\ No newline at end of file
@@ -3,18 +3,28 @@ layout(location = 0) in vec3 pos;
 layout(location = 1) in vec2 tex;
 layout(location = 2) in vec3 norm;
 layout(location = 3) in float text_id;
+layout(location = 4) in vec3 chunk_offset; // per draw offset of the world buffer, zero for other objects
 
 out vec2 texCoord;
 out vec3 normal;
 out vec3 crntPos;
 flat out float texture_id;
 
-uniform mat4 camera;
+layout(std140) uniform camera_block
+{
+	mat4 camera;
+	mat4 view;
+	mat4 projection;
+	mat4 inverseCamera;
+	vec3 camPos;
+	float time;
+};
+
 uniform mat4 model;
 uniform mat4 normalMatrix;
 
 void main(){
-	crntPos = vec3(model * vec4(pos, 1.0f));
+	crntPos = vec3(model * vec4(pos, 1.0f)) + chunk_offset;
   gl_Position = camera * vec4(crntPos, 1.0f);
 	normal = normalize(norm * mat3(normalMatrix));
 	texCoord = tex;
@@ -4,18 +4,23 @@ out vec4 FragColor;
 in vec2 TexCoords;
 
 uniform sampler2D deferred;
-uniform sampler2D gNormal;
+uniform sampler2D gDepth;
 
-uniform int vignette;
-uniform int kernel;
-uniform int wave;
-uniform int inverse;
-uniform int fxaa;
-
-uniform vec2 screenResolution;
-
-float offset_x = 1.0f / screenResolution.x;  
-float offset_y = 1.0f / screenResolution.y;  
+layout(std140) uniform postprocess_block
+{
+	vec2 screenResolution;
+	vec2 renderScale;
+	vec2 ssaoScale;
+	int vignette;
+	int kernel;
+	int wave;
+	int inverse;
+	int fxaa;
+};
+
+// one rendered pixel, coords are scaled into the rendered part later
+float offset_x = 1.0f / (screenResolution.x * renderScale.x);  
+float offset_y = 1.0f / (screenResolution.y * renderScale.y);  
 
 vec2 offsets[9] = vec2[]
 (
@@ -83,44 +88,40 @@ vec3 FxaaPixelShader(vec4 uv, sampler2D tex, vec2 rcpFrame) {
 }
 
 vec4 texture_fxaa(sampler2D text, vec2 coord){
-  if(fxaa==1){
-    vec4 gnorm=texture(gNormal, TexCoords);
-    vec3 normal=gnorm.xyz;
-    if(length(normal)==0){
-      return texture(text, coord);
-    }
-    vec2 rcpFrame = 1/screenResolution;
-    return vec4(FxaaPixelShader(vec4(coord, coord - (rcpFrame * (0.5 + FXAA_SUBPIX_SHIFT))), text, rcpFrame),1.0);
-  }
-  else{
+  // scene was rendered into the lower left renderScale part of the targets
+  coord = min(coord, 1.0) * renderScale;
+#ifdef FXAA
+  if(texture(gDepth, TexCoords * renderScale).r==1.0){
     return texture(text, coord);
   }
+  vec2 rcpFrame = 1/screenResolution;
+  return vec4(FxaaPixelShader(vec4(coord, coord - (rcpFrame * (0.5 + FXAA_SUBPIX_SHIFT))), text, rcpFrame),1.0);
+#else
+  return texture(text, coord);
+#endif
 }
 
+// one effect per program variant, lighting picks at most one of them
 void main() 
 {
-  if(vignette==1){
-    vec2 position = (gl_FragCoord.xy / screenResolution.xy) - vec2(0.5);
-    float len = length(position);
-    FragColor = texture_fxaa(deferred, TexCoords);
-    FragColor=vec4(FragColor.xyz*(1-len),1.0);
-  }
-  else if(kernel==1){
-    vec3 color = vec3(0.0f);
-    for(int i = 0; i < 9; i++){
-      color += vec3(texture_fxaa(deferred, TexCoords.st + offsets[i])) * kernel_arr[i];
-    }
-    FragColor = vec4(color, 1.0f);
-  }
-  else if(wave==1){
-    vec2 wavecoord = TexCoords;
-    wavecoord.x += sin(wavecoord.y * 25.13272 + 100) / 100;
-    FragColor = texture_fxaa(deferred, wavecoord);
-  }
-  else if(inverse==1){
-    FragColor = vec4(1.0f) - texture_fxaa(deferred, TexCoords);
-  }
-  else{
-    FragColor = texture_fxaa(deferred, TexCoords);
+#if defined(VIGNETTE)
+  vec2 position = (gl_FragCoord.xy / screenResolution.xy) - vec2(0.5);
+  float len = length(position);
+  FragColor = texture_fxaa(deferred, TexCoords);
+  FragColor=vec4(FragColor.xyz*(1-len),1.0);
+#elif defined(KERNEL)
+  vec3 color = vec3(0.0f);
+  for(int i = 0; i < 9; i++){
+    color += vec3(texture_fxaa(deferred, TexCoords.st + offsets[i])) * kernel_arr[i];
   }
+  FragColor = vec4(color, 1.0f);
+#elif defined(WAVE)
+  vec2 wavecoord = TexCoords;
+  wavecoord.x += sin(wavecoord.y * 25.13272 + 100) / 100;
+  FragColor = texture_fxaa(deferred, wavecoord);
+#elif defined(INVERSE)
+  FragColor = vec4(1.0f) - texture_fxaa(deferred, TexCoords);
+#else
+  FragColor = texture_fxaa(deferred, TexCoords);
+#endif
 }  
\ No newline at end of file
@@ -1,7 +1,6 @@
 #version 400 core
-layout (location = 0) out vec3 gPosition;
-layout (location = 1) out vec3 gNormal;
-layout (location = 2) out vec3 gTexCoord;
+layout (location = 0) out vec2 gNormal;
+layout (location = 1) out vec3 gTexCoord;
 
 in vec3 texCoords;
 
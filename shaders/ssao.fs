@@ -3,35 +3,82 @@ out float FragColor;
 
 in vec2 TexCoords;
 
-uniform sampler2D gPosition;
+uniform sampler2D gDepth;
 uniform sampler2D gNormal;
 uniform sampler2D texNoise;
 
-uniform vec3 samples[64];
+layout(std140) uniform camera_block
+{
+	mat4 camera;
+	mat4 view;
+	mat4 projection;
+	mat4 inverseCamera;
+	vec3 camPos;
+	float time;
+};
 
-int kernelSize = 64;
-float radius = 0.5;
-float bias = 0.025;
+layout(std140) uniform postprocess_block
+{
+	vec2 screenResolution;
+	vec2 renderScale;
+	vec2 ssaoScale;
+	int vignette;
+	int kernel;
+	int wave;
+	int inverse;
+	int fxaa;
+};
+
+layout(std140) uniform ssao_block
+{
+	vec3 samples[64];
+	vec2 noiseScale;
+};
 
-uniform vec2 noiseScale; 
+#if defined(SAMPLES_8)
+#define SAMPLE_COUNT 8
+#elif defined(SAMPLES_16)
+#define SAMPLE_COUNT 16
+#else
+#define SAMPLE_COUNT 64
+#endif
 
-uniform mat4 projection;
-uniform mat4 view;
+vec3 decode_normal(vec2 e)
+{
+  e = e * 2.0 - 1.0;
+  vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+  float t = clamp(-n.z, 0, 1);
+  n.x += n.x >= 0 ? -t : t;
+  n.y += n.y >= 0 ? -t : t;
+  return normalize(n);
+}
+
+// world position from depth, samples out of the screen are clamped into the rendered part
+vec3 get_position(vec2 coord)
+{
+  vec4 pos = inverseCamera * vec4(vec3(coord, texture(gDepth, clamp(coord, 0.0, 1.0) * renderScale).r) * 2.0 - 1.0, 1.0);
+  return pos.xyz / pos.w;
+}
+
+float radius = 0.5;
+float bias = 0.025;
 
 void main()
 {
-  vec3 fragPos = vec3(view * vec4(texture(gPosition, TexCoords).xyz, 1.0f));
-  vec3 normal = mat3(view) * normalize(texture(gNormal, TexCoords).rgb);
-  vec3 randomVec = normalize(texture(texNoise, TexCoords * noiseScale).xyz);
+  vec3 fragPos = vec3(view * vec4(get_position(TexCoords), 1.0f));
+  vec3 normal = mat3(view) * decode_normal(texture(gNormal, TexCoords * renderScale).rg);
+  vec3 randomVec = normalize(texture(texNoise, TexCoords * ssaoScale * noiseScale).xyz);
 
   vec3 tangent = normalize(randomVec - normal * dot(randomVec, normal));
   vec3 bitangent = cross(normal, tangent);
   mat3 TBN = mat3(tangent, bitangent, normal);
 
   float occlusion = 0.0;
-  for(int i = 0; i < kernelSize; ++i)
+  // fewer samples spread over the whole kernel, noise rotates them differently on neighbour pixels
+  const int stride = 64 / SAMPLE_COUNT;
+  for(int i = 0; i < SAMPLE_COUNT; ++i)
   {
-    vec3 samplePos = TBN * samples[i];
+    vec3 samplePos = TBN * samples[i * stride];
     samplePos = fragPos + samplePos * radius; 
 
     //if (length(samplePos - fragPos) > 4) break;
@@ -40,12 +87,12 @@ void main()
     offset.xyz /= offset.w;
     offset.xyz = offset.xyz * 0.5 + 0.5;
 
-    float sampleDepth = vec3(view * vec4(texture(gPosition, offset.xy).xyz, 1.0f)).z;
+    float sampleDepth = vec3(view * vec4(get_position(offset.xy), 1.0f)).z;
 
     float rangeCheck = smoothstep(0.0, 1.0, radius / abs(fragPos.z - sampleDepth));
     occlusion += (sampleDepth >= samplePos.z + bias ? 1.0 : 0.0) * rangeCheck;           
   }
-  occlusion = 1 - (occlusion / kernelSize);
+  occlusion = 1 - (occlusion / SAMPLE_COUNT);
 
   FragColor = occlusion;
 }
\ No newline at end of file
@@ -5,16 +5,29 @@ in vec2 TexCoords;
 
 uniform sampler2D ssaoInput;
 
+layout(std140) uniform postprocess_block
+{
+  vec2 screenResolution;
+  vec2 renderScale;
+  vec2 ssaoScale;
+  int vignette;
+  int kernel;
+  int wave;
+  int inverse;
+  int fxaa;
+};
+
 void main() 
 {
   vec2 texelSize = 1.0 / vec2(textureSize(ssaoInput, 0));
+  vec2 coord = TexCoords * ssaoScale;
   float result = 0.0;
   for (int x = -2; x < 2; ++x) 
   {
     for (int y = -2; y < 2; ++y) 
     {
       vec2 offset = vec2(float(x), float(y)) * texelSize;
-      result += texture(ssaoInput, TexCoords + offset).r;
+      result += texture(ssaoInput, min(coord + offset, ssaoScale)).r;
     }
   }
   FragColor = result / (4.0 * 4.0);
@@ -5,7 +5,14 @@ in vec4 RGBA;
 
 out vec4 FragColor;
 uniform sampler2D font_textures;
+uniform int sdf;
 
 void main(){
-  FragColor = vec4(RGBA.rgb,texture(font_textures, TexCoords).r*RGBA.a);
+  float value = texture(font_textures, TexCoords).r;
+  if(sdf == 1){
+    // 0.5 is the glyph edge, fwidth keeps it about one pixel soft at any size
+    float width = fwidth(value) * 0.75;
+    value = smoothstep(0.5 - width, 0.5 + width, value);
+  }
+  FragColor = vec4(RGBA.rgb,value*RGBA.a);
 }
\ No newline at end of file
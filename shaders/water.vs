@@ -3,31 +3,37 @@ layout(location = 0) in vec3 pos;
 layout(location = 1) in vec2 tex;
 layout(location = 2) in vec3 norm;
 layout(location = 3) in float text_id;
+layout(location = 4) in vec3 chunk_offset; // per draw offset of the world buffer, zero for other objects
 
 out vec2 texCoord;
 out vec3 normal;
 out vec3 crntPos;
-out vec2 coord;
 flat out float texture_id;
 
-uniform mat4 camera;
+layout(std140) uniform camera_block
+{
+	mat4 camera;
+	mat4 view;
+	mat4 projection;
+	mat4 inverseCamera;
+	vec3 camPos;
+	float time;
+};
+
 uniform mat4 model;
 uniform mat4 normalMatrix;
 
-uniform float time;
-
 float mapValue(float value, float inMin, float inMax, float outMin, float outMax)
 {
   return outMin + (outMax - outMin) * (value - inMin) / (inMax - inMin);
 }
 
 void main(){
-	crntPos = vec3(model * vec4(pos, 1.0f));
-  float wave=mapValue(sin(time+crntPos.x+crntPos.z),-1,1,0,0.17);
+	crntPos = vec3(model * vec4(pos, 1.0f)) + chunk_offset;
+  // water is tessellated every 2 cells, half frequency keeps 6 vertices on a wave
+  float wave=mapValue(sin(time+(crntPos.x+crntPos.z)*0.5),-1,1,0,0.17);
   crntPos.y=crntPos.y+wave;
   gl_Position = camera * vec4(crntPos, 1.0f);
-  coord=gl_Position.xy/gl_Position.w;
-  coord = (coord + 1.0) * 0.5;
 	normal = normalize(norm * mat3(normalMatrix));
 	texCoord = tex;
 	texture_id = text_id;
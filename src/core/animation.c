@@ -1,205 +1,336 @@
 #include "animation.h"
 #include "timing.h"
+#include "macro.h"
+#include <stdlib.h>
 
+#define HANDLE_ID_BITS 24
+#define HANDLE_ID_MASK 0xffffff
+
+// every playing tween is one slot in these arrays, finished or cancelled ones are swap removed
 typedef struct translate
 {
-  DA *bro;
-  DA *brm;
-  DA *brostartms;
-  DA *broendms;
-  DA *brmstartms;
-  DA *brmendms;
-  DA *brotargetvec;
-  DA *brmtargetvec;
-  DA *brocurrentvec;
-  DA *brmcurrentvec;
-  DA *brop;
-  DA *broduration;
-  DA *brmduration;
+  unsigned int size;
+  unsigned int capacity;
+  void **target;          // br_object or br_object_manager
+  unsigned char *manager; // 1 if target is a br_object_manager
+  unsigned char *physic;
+  unsigned char *easing;
+  double *startms;
+  double *durationms;
+  float *progress; // eased progress of current frame
+  vec3 *vec;       // whole translation
+  vec3 *applied;   // translation applied until now
+  animation_handle *handle;
 } translate;
 
+// handles point to slots, slots move when another animation is removed
+typedef struct handle_table
+{
+  unsigned int size;
+  unsigned int capacity;
+  unsigned int *slot;
+  unsigned char *generation;
+  unsigned int *free_ids;
+  unsigned int free_count;
+} handle_table;
+
 translate tranim;
+handle_table handles;
 
 void init_animations(void)
 {
-  tranim.bro = create_DA_HIGH_MEMORY(sizeof(br_object *), 0);
-  tranim.brm = create_DA_HIGH_MEMORY(sizeof(br_object_manager *), 0);
-  tranim.brostartms = create_DA_HIGH_MEMORY(sizeof(double), 0);
-  tranim.broendms = create_DA_HIGH_MEMORY(sizeof(double), 0);
-  tranim.brmstartms = create_DA_HIGH_MEMORY(sizeof(double), 0);
-  tranim.brmendms = create_DA_HIGH_MEMORY(sizeof(double), 0);
-  tranim.brotargetvec = create_DA_HIGH_MEMORY(sizeof(vec3), 0);
-  tranim.brmtargetvec = create_DA_HIGH_MEMORY(sizeof(vec3), 0);
-  tranim.brocurrentvec = create_DA_HIGH_MEMORY(sizeof(vec3), 0);
-  tranim.brmcurrentvec = create_DA_HIGH_MEMORY(sizeof(vec3), 0);
-  tranim.brop = create_DA_HIGH_MEMORY(sizeof(unsigned char), 0);
-  tranim.broduration = create_DA_HIGH_MEMORY(sizeof(double), 0);
-  tranim.brmduration = create_DA_HIGH_MEMORY(sizeof(double), 0);
+  tranim.size = 0;
+  tranim.capacity = 0;
+  tranim.target = 0;
+  tranim.manager = 0;
+  tranim.physic = 0;
+  tranim.easing = 0;
+  tranim.startms = 0;
+  tranim.durationms = 0;
+  tranim.progress = 0;
+  tranim.vec = 0;
+  tranim.applied = 0;
+  tranim.handle = 0;
+  handles.size = 0;
+  handles.capacity = 0;
+  handles.slot = 0;
+  handles.generation = 0;
+  handles.free_ids = 0;
+  handles.free_count = 0;
+}
+
+void grow_animations(void)
+{
+  unsigned int capacity = tranim.capacity == 0 ? 256 : tranim.capacity * 2;
+  tranim.target = realloc(tranim.target, capacity * sizeof(void *));
+  tranim.manager = realloc(tranim.manager, capacity * sizeof(unsigned char));
+  tranim.physic = realloc(tranim.physic, capacity * sizeof(unsigned char));
+  tranim.easing = realloc(tranim.easing, capacity * sizeof(unsigned char));
+  tranim.startms = realloc(tranim.startms, capacity * sizeof(double));
+  tranim.durationms = realloc(tranim.durationms, capacity * sizeof(double));
+  tranim.progress = realloc(tranim.progress, capacity * sizeof(float));
+  tranim.vec = realloc(tranim.vec, capacity * sizeof(vec3));
+  tranim.applied = realloc(tranim.applied, capacity * sizeof(vec3));
+  tranim.handle = realloc(tranim.handle, capacity * sizeof(animation_handle));
+  tranim.capacity = capacity;
 }
 
-void add_animation_translate_br_object(br_object *obj, vec3 v, unsigned char effect_physic, double durationms)
+void grow_handles(void)
+{
+  unsigned int capacity = handles.capacity == 0 ? 256 : handles.capacity * 2;
+  handles.slot = realloc(handles.slot, capacity * sizeof(unsigned int));
+  handles.generation = realloc(handles.generation, capacity * sizeof(unsigned char));
+  handles.free_ids = realloc(handles.free_ids, capacity * sizeof(unsigned int));
+  handles.capacity = capacity;
+}
+
+// returns UINT_MAX if handle is not playing anymore
+unsigned int get_slot_animation(animation_handle handle)
+{
+  unsigned int id = (handle & HANDLE_ID_MASK);
+  if (id == 0 || id > handles.size)
+  {
+    return UINT_MAX;
+  }
+  id--;
+  if (handles.generation[id] != (unsigned char)(handle >> HANDLE_ID_BITS))
+  {
+    return UINT_MAX;
+  }
+  return handles.slot[id];
+}
+
+void set_target_handle(unsigned int slot, animation_handle handle)
+{
+  if (tranim.manager[slot])
+  {
+    ((br_object_manager *)tranim.target[slot])->animation = handle;
+  }
+  else
+  {
+    ((br_object *)tranim.target[slot])->animation = handle;
+  }
+}
+
+void remove_slot_animation(unsigned int slot)
+{
+  set_target_handle(slot, 0);
+  unsigned int id = (tranim.handle[slot] & HANDLE_ID_MASK) - 1;
+  handles.generation[id]++;
+  handles.free_ids[handles.free_count] = id;
+  handles.free_count++;
+
+  unsigned int last = tranim.size - 1;
+  if (slot != last)
+  {
+    tranim.target[slot] = tranim.target[last];
+    tranim.manager[slot] = tranim.manager[last];
+    tranim.physic[slot] = tranim.physic[last];
+    tranim.easing[slot] = tranim.easing[last];
+    tranim.startms[slot] = tranim.startms[last];
+    tranim.durationms[slot] = tranim.durationms[last];
+    tranim.progress[slot] = tranim.progress[last];
+    glm_vec3_copy(tranim.vec[last], tranim.vec[slot]);
+    glm_vec3_copy(tranim.applied[last], tranim.applied[slot]);
+    tranim.handle[slot] = tranim.handle[last];
+    handles.slot[(tranim.handle[slot] & HANDLE_ID_MASK) - 1] = slot;
+  }
+  tranim.size--;
+}
+
+animation_handle add_animation(void *target, unsigned char manager, vec3 v, unsigned char effect_physic, double durationms,
+                               unsigned char easing)
+{
+  if (tranim.size == tranim.capacity)
+  {
+    grow_animations();
+  }
+  unsigned int id = 0;
+  if (handles.free_count > 0)
+  {
+    handles.free_count--;
+    id = handles.free_ids[handles.free_count];
+  }
+  else
+  {
+    if (handles.size == handles.capacity)
+    {
+      grow_handles();
+    }
+    id = handles.size;
+    handles.generation[id] = 0;
+    handles.size++;
+  }
+  unsigned int slot = tranim.size;
+  tranim.size++;
+  animation_handle handle = ((animation_handle)handles.generation[id] << HANDLE_ID_BITS) | (id + 1);
+  handles.slot[id] = slot;
+  tranim.target[slot] = target;
+  tranim.manager[slot] = manager;
+  tranim.physic[slot] = effect_physic;
+  tranim.easing[slot] = easing;
+  tranim.startms[slot] = get_timems();
+  tranim.durationms[slot] = durationms;
+  tranim.progress[slot] = 0;
+  glm_vec3_copy(v, tranim.vec[slot]);
+  glm_vec3_zero(tranim.applied[slot]);
+  tranim.handle[slot] = handle;
+  set_target_handle(slot, handle);
+  return handle;
+}
+
+animation_handle add_animation_translate_br_object_eased(br_object *obj, vec3 v, unsigned char effect_physic, double durationms,
+                                                         unsigned char easing)
 {
   remove_animation_translate_br_object(obj);
-  double current = get_timems();
-  double end = current + durationms;
-  vec3 currentv = {0, 0, 0};
-  pushback_DA(tranim.bro, &obj);
-  pushback_DA(tranim.brostartms, &current);
-  pushback_DA(tranim.broendms, &end);
-  pushback_DA(tranim.brotargetvec, v);
-  pushback_DA(tranim.brocurrentvec, currentv);
-  pushback_DA(tranim.brop, &effect_physic);
-  pushback_DA(tranim.broduration, &durationms);
+  return add_animation(obj, 0, v, effect_physic, durationms, easing);
 }
 
-void add_animation_translate_br_manager(br_object_manager *manager, vec3 v, double durationms)
+animation_handle add_animation_translate_br_manager_eased(br_object_manager *manager, vec3 v, double durationms, unsigned char easing)
 {
   remove_animation_translate_br_manager(manager);
-  double current = get_timems();
-  double end = current + durationms;
-  vec3 currentv = {0, 0, 0};
-  pushback_DA(tranim.brm, &manager);
-  pushback_DA(tranim.brmstartms, &current);
-  pushback_DA(tranim.brmendms, &end);
-  pushback_DA(tranim.brmtargetvec, v);
-  pushback_DA(tranim.brmcurrentvec, currentv);
-  pushback_DA(tranim.brmduration, &durationms);
+  return add_animation(manager, 1, v, 0, durationms, easing);
+}
+
+animation_handle add_animation_translate_br_object(br_object *obj, vec3 v, unsigned char effect_physic, double durationms)
+{
+  return add_animation_translate_br_object_eased(obj, v, effect_physic, durationms, EASE_LINEAR);
+}
+
+animation_handle add_animation_translate_br_manager(br_object_manager *manager, vec3 v, double durationms)
+{
+  return add_animation_translate_br_manager_eased(manager, v, durationms, EASE_LINEAR);
+}
+
+void cancel_animation(animation_handle handle)
+{
+  unsigned int slot = get_slot_animation(handle);
+  if (slot != UINT_MAX)
+  {
+    remove_slot_animation(slot);
+  }
+}
+
+unsigned char is_animation_playing(animation_handle handle)
+{
+  return get_slot_animation(handle) != UINT_MAX;
 }
 
 void remove_animation_translate_br_object(br_object *obj)
 {
-  unsigned int index = get_index_DA(tranim.bro, &obj);
-  remove_DA(tranim.bro, index);
-  remove_DA(tranim.brostartms, index);
-  remove_DA(tranim.broendms, index);
-  remove_DA(tranim.brotargetvec, index);
-  remove_DA(tranim.brocurrentvec, index);
-  remove_DA(tranim.brop, index);
-  remove_DA(tranim.broduration, index);
+  cancel_animation(obj->animation);
 }
 
 void remove_animation_translate_br_manager(br_object_manager *manager)
 {
-  unsigned int index = get_index_DA(tranim.brm, &manager);
-  remove_DA(tranim.brm, index);
-  remove_DA(tranim.brmstartms, index);
-  remove_DA(tranim.brmendms, index);
-  remove_DA(tranim.brmtargetvec, index);
-  remove_DA(tranim.brmcurrentvec, index);
-  remove_DA(tranim.brmduration, index);
+  cancel_animation(manager->animation);
+}
+
+float ease_animation(unsigned char easing, float t)
+{
+  switch (easing)
+  {
+  case EASE_IN_QUAD:
+    return t * t;
+  case EASE_OUT_QUAD:
+    return t * (2 - t);
+  case EASE_IN_OUT_QUAD:
+    return t < 0.5f ? 2 * t * t : -1 + (4 - 2 * t) * t;
+  case EASE_IN_CUBIC:
+    return t * t * t;
+  case EASE_OUT_CUBIC:
+    t -= 1;
+    return t * t * t + 1;
+  case EASE_IN_OUT_CUBIC:
+    return t < 0.5f ? 4 * t * t * t : (t - 1) * (2 * t - 2) * (2 * t - 2) + 1;
+  case EASE_OUT_BACK:
+    t -= 1;
+    return 1 + t * t * (2.70158f * t + 1.70158f);
+  default:
+    return t;
+  }
 }
 
 void play_animations(void)
 {
   double current = get_timems();
+  unsigned int size = tranim.size;
+
+  // progress of every tween
+  for (unsigned int i = 0; i < size; i++)
+  {
+    double t = 1;
+    if (tranim.durationms[i] > 0)
+    {
+      t = (current - tranim.startms[i]) / tranim.durationms[i];
+    }
+    tranim.progress[i] = t >= 1 ? 1 : (float)max(t, 0);
+  }
+  for (unsigned int i = 0; i < size; i++)
+  {
+    if (tranim.easing[i] != EASE_LINEAR && tranim.progress[i] < 1)
+    {
+      tranim.progress[i] = ease_animation(tranim.easing[i], tranim.progress[i]);
+    }
+  }
+
+  // move targets by the difference from last frame
   vec3 v;
-  unsigned int index = 0;
-start:
-  br_object **obj = get_data_DA(tranim.bro);
-  double *startms = get_data_DA(tranim.brostartms);
-  double *endms = get_data_DA(tranim.broendms);
-  vec3 *vec = get_data_DA(tranim.brotargetvec);
-  vec3 *veccurrent = get_data_DA(tranim.brocurrentvec);
-  unsigned char *phy = get_data_DA(tranim.brop);
-  double *duration = get_data_DA(tranim.broduration);
-  for (unsigned int i = index; i < get_size_DA(tranim.bro); i++)
+  for (unsigned int i = 0; i < size; i++)
   {
-    if (current >= endms[i])
+    glm_vec3_scale(tranim.vec[i], tranim.progress[i], v);
+    glm_vec3_sub(v, tranim.applied[i], v);
+    glm_vec3_add(tranim.applied[i], v, tranim.applied[i]);
+    if (tranim.manager[i])
     {
-      glm_vec3_scale(veccurrent[i], -1, veccurrent[i]);
-      translate_br_object(obj[i], veccurrent[i], phy[i]);
-      translate_br_object(obj[i], vec[i], phy[i]);
-
-      remove_DA(tranim.bro, i);
-      remove_DA(tranim.brostartms, i);
-      remove_DA(tranim.broendms, i);
-      remove_DA(tranim.brotargetvec, i);
-      remove_DA(tranim.brocurrentvec, i);
-      remove_DA(tranim.brop, i);
-      remove_DA(tranim.broduration, i);
-      index = i;
-      goto start;
+      translate_br_object_all((br_object_manager *)tranim.target[i], v);
+    }
+    else
+    {
+      translate_br_object((br_object *)tranim.target[i], v, tranim.physic[i]);
     }
-    glm_vec3_scale(vec[i], (float)((current - startms[i]) / duration[i]), v);
-    glm_vec3_scale(veccurrent[i], -1, veccurrent[i]);
-    translate_br_object(obj[i], veccurrent[i], phy[i]);
-    glm_vec3_scale(veccurrent[i], -1, veccurrent[i]);
-    glm_vec3_copy(v, veccurrent[i]);
-    translate_br_object(obj[i], v, phy[i]);
   }
-  index = 0;
-start2:
-  br_object_manager **mng = get_data_DA(tranim.brm);
-  startms = get_data_DA(tranim.brmstartms);
-  endms = get_data_DA(tranim.brmendms);
-  vec = get_data_DA(tranim.brmtargetvec);
-  veccurrent = get_data_DA(tranim.brmcurrentvec);
-  duration = get_data_DA(tranim.brmduration);
-  for (unsigned int i = index; i < get_size_DA(tranim.brm); i++)
+
+  // backwards so the swapped in slot is already checked
+  for (unsigned int i = size; i-- > 0;)
   {
-    if (current >= endms[i])
+    if (tranim.durationms[i] <= 0 || current - tranim.startms[i] >= tranim.durationms[i])
     {
-      glm_vec3_scale(veccurrent[i], -1, veccurrent[i]);
-      translate_br_object_all(mng[i], veccurrent[i]);
-      translate_br_object_all(mng[i], vec[i]);
-
-      remove_DA(tranim.brm, i);
-      remove_DA(tranim.brmstartms, i);
-      remove_DA(tranim.brmendms, i);
-      remove_DA(tranim.brmtargetvec, i);
-      remove_DA(tranim.brmcurrentvec, i);
-      remove_DA(tranim.brmduration, i);
-      index = i;
-      goto start2;
+      remove_slot_animation(i);
     }
-    glm_vec3_scale(vec[i], (float)((current - startms[i]) / duration[i]), v);
-    glm_vec3_scale(veccurrent[i], -1, veccurrent[i]);
-    translate_br_object_all(mng[i], veccurrent[i]);
-    glm_vec3_scale(veccurrent[i], -1, veccurrent[i]);
-    glm_vec3_copy(v, veccurrent[i]);
-    translate_br_object_all(mng[i], v);
   }
 }
 
+// targets may already be deleted here so their handles are not touched
 void delete_animations(void)
 {
-  delete_DA(tranim.bro);
-  delete_DA(tranim.brm);
-  delete_DA(tranim.brostartms);
-  delete_DA(tranim.broendms);
-  delete_DA(tranim.brmstartms);
-  delete_DA(tranim.brmendms);
-  delete_DA(tranim.brotargetvec);
-  delete_DA(tranim.brmtargetvec);
-  delete_DA(tranim.brocurrentvec);
-  delete_DA(tranim.brmcurrentvec);
-  delete_DA(tranim.brop);
-  delete_DA(tranim.broduration);
-  delete_DA(tranim.brmduration);
+  free(tranim.target);
+  free(tranim.manager);
+  free(tranim.physic);
+  free(tranim.easing);
+  free(tranim.startms);
+  free(tranim.durationms);
+  free(tranim.progress);
+  free(tranim.vec);
+  free(tranim.applied);
+  free(tranim.handle);
+  free(handles.slot);
+  free(handles.generation);
+  free(handles.free_ids);
+  init_animations();
 }
 
 unsigned char has_animation_br_object(br_object *obj)
 {
-  unsigned int index = get_index_DA(tranim.bro, &obj);
-  if (index == UINT_MAX)
-  {
-    return 0;
-  }
-  else
-  {
-    return 1;
-  }
+  return is_animation_playing(obj->animation);
 }
 
 unsigned char has_animation_br_manager(br_object_manager *manager)
 {
-  unsigned int index = get_index_DA(tranim.brm, &manager);
-  if (index == UINT_MAX)
-  {
-    return 0;
-  }
-  else
-  {
-    return 1;
-  }
+  return is_animation_playing(manager->animation);
+}
+
+unsigned int get_animation_count(void)
+{
+  return tranim.size;
 }
\ No newline at end of file
@@ -1,11 +1,34 @@
 #pragma once
 #include "br_object.h"
 
+// easing curves
+#define EASE_LINEAR 0
+#define EASE_IN_QUAD 1
+#define EASE_OUT_QUAD 2
+#define EASE_IN_OUT_QUAD 3
+#define EASE_IN_CUBIC 4
+#define EASE_OUT_CUBIC 5
+#define EASE_IN_OUT_CUBIC 6
+#define EASE_OUT_BACK 7
+
+// 0 is never a valid handle
+typedef unsigned int animation_handle;
+
 void init_animations(void);
 
-void add_animation_translate_br_object(br_object *obj, vec3 v, unsigned char effect_physic, double durationms);
+animation_handle add_animation_translate_br_object(br_object *obj, vec3 v, unsigned char effect_physic, double durationms);
+
+animation_handle add_animation_translate_br_manager(br_object_manager *manager, vec3 v, double durationms);
+
+animation_handle add_animation_translate_br_object_eased(br_object *obj, vec3 v, unsigned char effect_physic, double durationms,
+                                                         unsigned char easing);
 
-void add_animation_translate_br_manager(br_object_manager *manager, vec3 v, double durationms);
+animation_handle add_animation_translate_br_manager_eased(br_object_manager *manager, vec3 v, double durationms, unsigned char easing);
+
+// stops the animation where it is
+void cancel_animation(animation_handle handle);
+
+unsigned char is_animation_playing(animation_handle handle);
 
 void remove_animation_translate_br_object(br_object *obj);
 
@@ -17,4 +40,6 @@ void delete_animations(void);
 
 unsigned char has_animation_br_object(br_object *obj);
 
-unsigned char has_animation_br_manager(br_object_manager *manager);
\ No newline at end of file
+unsigned char has_animation_br_manager(br_object_manager *manager);
+
+unsigned int get_animation_count(void);
\ No newline at end of file
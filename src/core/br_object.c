@@ -1,35 +1,47 @@
 #include "br_object.h"
+#include "gl_state.h"
 #include "macro.h"
 
+void set_attributes_br_object_manager(GLuint VBO)
+{
+	bind_buffer(GL_ARRAY_BUFFER, VBO);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(GLfloat), 0);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 9 * sizeof(GLfloat), (void *)(3 * sizeof(GLfloat)));
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(GLfloat), (void *)(5 * sizeof(GLfloat)));
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, 9 * sizeof(GLfloat), (void *)(8 * sizeof(GLfloat)));
+	glEnableVertexAttribArray(3);
+}
+
 void prepare_render_br_object_manager(br_object_manager *manager)
 {
-	glDeleteVertexArrays(1, &(manager->VAO));
-	glDeleteBuffers(1, &(manager->VBO));
-	glDeleteBuffers(1, &(manager->EBO));
-	glBindVertexArray(0);
+	delete_vertex_arrays(1, &(manager->VAO));
+	delete_buffers(1, &(manager->VBO));
+	delete_buffers(1, &(manager->EBO));
+	delete_stream_buffer(manager->stream);
+	manager->VBO = 0;
+	manager->stream = 0;
+	bind_vertex_array(0);
 	if (get_size_DA(manager->objects) > 0)
 	{
 		glGenVertexArrays(1, &(manager->VAO));
 		glGenBuffers(1, &(manager->VBO));
 		glGenBuffers(1, &(manager->EBO));
-		glBindVertexArray(manager->VAO);
-		glBindBuffer(GL_ARRAY_BUFFER, manager->VBO);
+		bind_vertex_array(manager->VAO);
+		bind_buffer(GL_ARRAY_BUFFER, manager->VBO);
 		glBufferData(GL_ARRAY_BUFFER, get_size_DA(manager->vertices) * sizeof(GLfloat), get_data_DA(manager->vertices), GL_STATIC_DRAW);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(GLfloat), 0);
-		glEnableVertexAttribArray(0);
-		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 9 * sizeof(GLfloat), (void *)(3 * sizeof(GLfloat)));
-		glEnableVertexAttribArray(1);
-		glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(GLfloat), (void *)(5 * sizeof(GLfloat)));
-		glEnableVertexAttribArray(2);
-		glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, 9 * sizeof(GLfloat), (void *)(8 * sizeof(GLfloat)));
-		glEnableVertexAttribArray(3);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, manager->EBO);
+		set_attributes_br_object_manager(manager->VBO);
+		bind_buffer(GL_ELEMENT_ARRAY_BUFFER, manager->EBO);
 		glBufferData(GL_ELEMENT_ARRAY_BUFFER, get_size_DA(manager->indices) * sizeof(GLuint), get_data_DA(manager->indices), GL_STATIC_DRAW);
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-		glBindVertexArray(0);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+		bind_buffer(GL_ARRAY_BUFFER, 0);
+		bind_vertex_array(0);
+		bind_buffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 	}
 	manager->subdata = 0;
+	manager->dirty_start = UINT_MAX;
+	manager->dirty_end = 0;
 }
 
 br_object_manager *create_br_object_manager(void)
@@ -43,6 +55,9 @@ br_object_manager *create_br_object_manager(void)
 	x->vertices = create_DA_HIGH_MEMORY(sizeof(GLfloat), 0);
 	x->indices = create_DA_HIGH_MEMORY(sizeof(GLuint), 0);
 	x->subdata = 0;
+	x->stream = 0;
+	x->dirty_start = UINT_MAX;
+	x->dirty_end = 0;
 	glm_mat4_copy(GLM_MAT4_IDENTITY, x->model);
 	glm_mat4_copy(GLM_MAT4_IDENTITY, x->normal);
 	glm_mat4_copy(GLM_MAT4_IDENTITY, x->translation);
@@ -52,6 +67,7 @@ br_object_manager *create_br_object_manager(void)
 	x->uniforms = create_DA(sizeof(GLint), 0);
 	x->object_number = 0;
 	x->indice_number = 0;
+	x->animation = 0;
 	return x;
 }
 
@@ -71,9 +87,10 @@ void delete_br_object_manager(br_object_manager *manager)
 	delete_DA(manager->indices);
 	delete_DA(manager->programs);
 	delete_DA(manager->uniforms);
-	glDeleteVertexArrays(1, &(manager->VAO));
-	glDeleteBuffers(1, &(manager->VBO));
-	glDeleteBuffers(1, &(manager->EBO));
+	delete_vertex_arrays(1, &(manager->VAO));
+	delete_buffers(1, &(manager->VBO));
+	delete_buffers(1, &(manager->EBO));
+	delete_stream_buffer(manager->stream);
 	free32(manager);
 }
 
@@ -101,6 +118,7 @@ br_object *create_br_object(br_object_manager *manager, GLfloat *vertices, unsig
 	glm_mat4_copy(GLM_MAT4_IDENTITY, x->model);
 	glm_mat4_copy(GLM_MAT4_IDENTITY, x->normal);
 	x->manager = manager;
+	x->animation = 0;
 	x->vertex_number = vertex_number;
 	x->indice_number = indice_number;
 	pushback_DA(x->manager->objects, &x);
@@ -246,6 +264,8 @@ void apply_model_matrix(br_object *obj)
 	}
 	glm_mat4_copy(GLM_MAT4_IDENTITY, obj->model);
 	glm_mat4_copy(GLM_MAT4_IDENTITY, obj->normal);
+	obj->manager->dirty_start = min(obj->manager->dirty_start, obj->vertex_start * 9);
+	obj->manager->dirty_end = max(obj->manager->dirty_end, (obj->vertex_start + obj->vertex_number) * 9);
 	obj->manager->subdata = 1;
 }
 
@@ -301,7 +321,7 @@ void translate_br_object_all(br_object_manager *manager, vec3 v)
 	glm_vec3_add(v, manager->translation[3], manager->translation[3]);
 }
 
-void use_br_object_manager(br_object_manager *manager, GLuint program)
+void draw_br_object_manager(br_object_manager *manager, GLuint program, mat4 model, mat4 normal)
 {
 	if (manager->object_number > 0)
 	{
@@ -314,27 +334,63 @@ void use_br_object_manager(br_object_manager *manager, GLuint program)
 			pushback_DA(manager->uniforms, &uniform);
 		}
 		GLint *uniforms = get_data_DA(manager->uniforms);
-		glm_mat4_mulN((mat4 *[]){&manager->translation, &manager->rotation, &manager->scale}, 3, manager->model);
-		glm_mat4_inv(manager->model, manager->normal);
-		glm_mat4_transpose(manager->normal);
 		unsigned int index = get_index_DA(manager->programs, &program);
-		glUniformMatrix4fv(uniforms[index * 2], 1, GL_FALSE, manager->model[0]);
-		glUniformMatrix4fv(uniforms[index * 2 + 1], 1, GL_FALSE, manager->normal[0]);
+		glUniformMatrix4fv(uniforms[index * 2], 1, GL_FALSE, model[0]);
+		glUniformMatrix4fv(uniforms[index * 2 + 1], 1, GL_FALSE, normal[0]);
 
-		if (manager->subdata == 1)
+		if (manager->subdata == 1 && manager->vertices != 0)
 		{
-			glBindBuffer(GL_ARRAY_BUFFER, manager->VBO);
-			glBufferSubData(GL_ARRAY_BUFFER, 0, get_size_DA(manager->vertices) * sizeof(GLfloat), get_data_DA(manager->vertices));
-			glBindBuffer(GL_ARRAY_BUFFER, 0);
+			if (manager->stream == 0)
+			{
+				// first change after prepare, vertices are streamed from now on
+				manager->stream = create_stream_buffer(get_size_DA(manager->vertices) * sizeof(GLfloat), get_data_DA(manager->vertices));
+				bind_vertex_array(manager->VAO);
+				set_attributes_br_object_manager(manager->stream->buffer);
+				bind_vertex_array(0);
+				bind_buffer(GL_ARRAY_BUFFER, 0);
+				delete_buffers(1, &(manager->VBO));
+				manager->VBO = 0;
+			}
+			else if (manager->dirty_start < manager->dirty_end)
+			{
+				mark_stream_buffer(manager->stream, manager->dirty_start * sizeof(GLfloat), (manager->dirty_end - manager->dirty_start) * sizeof(GLfloat));
+			}
 			manager->subdata = 0;
+			manager->dirty_start = UINT_MAX;
+			manager->dirty_end = 0;
 		}
 
-		glBindVertexArray(manager->VAO);
-		glDrawElements(GL_TRIANGLES, manager->indice_number, GL_UNSIGNED_INT, 0);
-		glBindVertexArray(0);
+		// every region holds a whole copy so base vertex selects the region
+		GLint base_vertex = 0;
+		if (manager->stream != 0)
+		{
+			base_vertex = (GLint)(update_stream_buffer(manager->stream, get_data_DA(manager->vertices)) / (9 * sizeof(GLfloat)));
+		}
+		bind_vertex_array(manager->VAO);
+		glDrawElementsBaseVertex(GL_TRIANGLES, manager->indice_number, GL_UNSIGNED_INT, 0, base_vertex);
+		if (manager->stream != 0)
+		{
+			fence_stream_buffer(manager->stream);
+		}
 	}
 }
 
+void use_br_object_manager(br_object_manager *manager, GLuint program)
+{
+	glm_mat4_mulN((mat4 *[]){&manager->translation, &manager->rotation, &manager->scale}, 3, manager->model);
+	glm_mat4_inv(manager->model, manager->normal);
+	glm_mat4_transpose(manager->normal);
+	draw_br_object_manager(manager, program, manager->model, manager->normal);
+}
+
+void use_br_object_manager_model(br_object_manager *manager, GLuint program, mat4 model)
+{
+	mat4 normal;
+	glm_mat4_inv(model, normal);
+	glm_mat4_transpose(normal);
+	draw_br_object_manager(manager, program, model, normal);
+}
+
 void delete_cpu_memory_br_object_manager(br_object_manager *manager)
 {
 	br_object **objects = get_data_DA(manager->objects);
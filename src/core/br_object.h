@@ -2,6 +2,7 @@
 #include "../../third_party/opengl/include/glad/glad.h"
 #include "dynamic.h"
 #include "physics.h"
+#include "stream_buffer.h"
 
 typedef struct br_object_manager
 {
@@ -10,6 +11,9 @@ typedef struct br_object_manager
 	DA *vertices; // 3 vertex coord, 2 texture coord, 3 normal coord, 1 texture id
 	DA *indices;
 	unsigned char subdata;
+	stream_buffer *stream;	// created when vertices change after prepare_render_br_object_manager
+	unsigned int dirty_start; // changed range of vertices in floats
+	unsigned int dirty_end;
 	mat4 translation;
 	mat4 rotation;
 	mat4 scale;
@@ -19,6 +23,7 @@ typedef struct br_object_manager
 	DA *uniforms;
 	unsigned int object_number;
 	unsigned int indice_number;
+	unsigned int animation; // handle of the playing animation, 0 if there is none
 } br_object_manager;
 
 typedef struct br_object // batch rendering object
@@ -31,6 +36,7 @@ typedef struct br_object // batch rendering object
 	mat4 model;
 	mat4 normal;
 	physic *phy;
+	unsigned int animation;
 } br_object;
 
 br_object_manager *create_br_object_manager(void);
@@ -60,6 +66,9 @@ void prepare_render_br_object_manager(br_object_manager *manager);
 
 void use_br_object_manager(br_object_manager *manager, GLuint program);
 
+// draws with model instead of the transform of manager, manager matrices are not touched
+void use_br_object_manager_model(br_object_manager *manager, GLuint program, mat4 model);
+
 void delete_cpu_memory_br_object_manager(br_object_manager *manager);
 
 void set_position_br_object_all(br_object_manager *manager, vec3 v);
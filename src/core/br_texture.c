@@ -1,139 +1,227 @@
+#include <stdio.h>
+#include <string.h>
 #include "../../third_party/stb/stb_image.h"
 #include "br_texture.h"
+#include "gl_state.h"
 
 br_texture_manager *create_br_texture_manager(void)
 {
 	br_texture_manager *x = malloc(sizeof(br_texture_manager));
 	x->textures = create_DA(sizeof(br_texture *), 0);
-	for (int i = 0; i < 32; i++)
+	x->arrays = create_DA(sizeof(br_texture_array), 0);
+	x->layer_hint = 1;
+	return x;
+}
+
+void reserve_br_texture_layers(br_texture_manager *manager, unsigned int layers)
+{
+	manager->layer_hint = layers == 0 ? 1 : (layers > BR_TEXTURE_ARRAY_LAYERS ? BR_TEXTURE_ARRAY_LAYERS : layers);
+}
+
+unsigned char is_mipmapped_br_texture(GLint min_filter)
+{
+	return min_filter == GL_NEAREST_MIPMAP_NEAREST ||
+				 min_filter == GL_LINEAR_MIPMAP_NEAREST ||
+				 min_filter == GL_NEAREST_MIPMAP_LINEAR ||
+				 min_filter == GL_LINEAR_MIPMAP_LINEAR;
+}
+
+// texture has to be bound to GL_TEXTURE_2D_ARRAY
+void allocate_br_texture_array(br_texture_array *array)
+{
+	int levels = 1;
+	if (is_mipmapped_br_texture(array->min_filter))
 	{
-		x->indices[i] = 0;
+		while ((array->width >> levels) > 0 || (array->height >> levels) > 0)
+		{
+			levels++;
+		}
 	}
-	x->programs = create_DA(sizeof(GLuint), 0);
-	x->uniforms = create_DA(sizeof(GLint), 0);
-	return x;
+	for (int i = 0; i < levels; i++)
+	{
+		int width = array->width >> i;
+		int height = array->height >> i;
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, i, GL_RGBA8, width > 0 ? width : 1, height > 0 ? height : 1, array->layer_capacity, 0,
+								 GL_RGBA, GL_UNSIGNED_BYTE, 0);
+	}
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levels - 1);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, array->min_filter);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, array->mag_filter);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, array->wraps);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, array->wrapt);
 }
 
-br_texture *create_br_texture(br_texture_manager *manager, const char *path, GLenum texType,
-															GLint min_filter, GLint mag_filter, int index, int wraps, int wrapt)
+// doubles the layers, level 0 of used layers is copied through a framebuffer and mipmaps are generated again on next use
+void grow_br_texture_array(br_texture_array *array)
 {
-	if (get_size_DA(manager->textures) >= 32)
+	GLuint old = array->id;
+	glGenTextures(1, &(array->id));
+	bind_texture(GL_TEXTURE_2D_ARRAY, array->id);
+	array->layer_capacity = array->layer_capacity * 2 > BR_TEXTURE_ARRAY_LAYERS ? BR_TEXTURE_ARRAY_LAYERS : array->layer_capacity * 2;
+	allocate_br_texture_array(array);
+
+	GLuint fbo = 0;
+	glGenFramebuffers(1, &fbo);
+	bind_framebuffer(GL_READ_FRAMEBUFFER, fbo);
+	glReadBuffer(GL_COLOR_ATTACHMENT0);
+	for (unsigned int i = 0; i < array->layer_number; i++)
 	{
-		return 0;
+		glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, old, 0, i);
+		glCopyTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, i, 0, 0, array->width, array->height);
 	}
-	glBindTexture(texType, 0);
-	br_texture *tex = calloc(1, sizeof(br_texture));
-	int widthImg, heightImg, numColCh;
-	stbi_set_flip_vertically_on_load(1);
-	unsigned char *bytes = stbi_load(path, &widthImg, &heightImg, &numColCh, 0);
-	if (!bytes)
+	bind_framebuffer(GL_READ_FRAMEBUFFER, 0);
+	delete_framebuffers(1, &fbo);
+	delete_textures(1, &old);
+}
+
+br_texture *create_br_texture_memory(br_texture_manager *manager, unsigned char *data, int width, int height,
+																		 GLint min_filter, GLint mag_filter, int wraps, int wrapt)
+{
+	// find the array for these sampler parameters
+	unsigned int index = 0;
+	for (; index < get_size_DA(manager->arrays); index++)
 	{
-		return 0;
+		br_texture_array *a = &(((br_texture_array *)get_data_DA(manager->arrays))[index]);
+		if (a->min_filter == min_filter && a->mag_filter == mag_filter && a->wraps == wraps && a->wrapt == wrapt)
+		{
+			break;
+		}
 	}
-	GLenum format = GL_RGB;
-	if (numColCh == 1)
+	active_texture(GL_TEXTURE0);
+	if (index == get_size_DA(manager->arrays))
 	{
-		format = GL_RED;
+		br_texture_array new_array;
+		br_texture_array *a = &new_array;
+		a->width = width;
+		a->height = height;
+		a->min_filter = min_filter;
+		a->mag_filter = mag_filter;
+		a->wraps = wraps;
+		a->wrapt = wrapt;
+		a->layer_number = 0;
+		a->layer_capacity = manager->layer_hint;
+		a->free_layers = create_DA(sizeof(unsigned int), 0);
+		a->mipmaps_dirty = 0;
+		glGenTextures(1, &(a->id));
+		bind_texture(GL_TEXTURE_2D_ARRAY, a->id);
+		allocate_br_texture_array(a);
+		pushback_DA(manager->arrays, a);
 	}
-	else if (numColCh == 3)
+	br_texture_array *array = &(((br_texture_array *)get_data_DA(manager->arrays))[index]);
+	bind_texture(GL_TEXTURE_2D_ARRAY, array->id);
+
+	unsigned int layer = 0;
+	if (get_size_DA(array->free_layers) > 0)
 	{
-		format = GL_RGB;
+		layer = ((unsigned int *)get_data_DA(array->free_layers))[get_size_DA(array->free_layers) - 1];
+		remove_DA(array->free_layers, get_size_DA(array->free_layers) - 1);
 	}
-	else if (numColCh == 4)
+	else
 	{
-		format = GL_RGBA;
+		if (array->layer_number == BR_TEXTURE_ARRAY_LAYERS)
+		{
+			fprintf(stderr, "texture array %u is full, %d textures with the same sampler parameters at most\n", index,
+							BR_TEXTURE_ARRAY_LAYERS);
+			bind_texture(GL_TEXTURE_2D_ARRAY, 0);
+			return 0;
+		}
+		if (array->layer_number == array->layer_capacity)
+		{
+			grow_br_texture_array(array);
+		}
+		layer = array->layer_number;
+		array->layer_number++;
 	}
-	glGenTextures(1, &(tex->id));
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(texType, tex->id);
-	glTexParameteri(texType, GL_TEXTURE_MIN_FILTER, min_filter);
-	glTexParameteri(texType, GL_TEXTURE_MAG_FILTER, mag_filter);
-	glTexParameteri(texType, GL_TEXTURE_WRAP_S, wraps);
-	glTexParameteri(texType, GL_TEXTURE_WRAP_T, wrapt);
-	glTexImage2D(texType, 0, GL_RGBA, widthImg, heightImg, 0, format, GL_UNSIGNED_BYTE, bytes);
-	if (min_filter == GL_NEAREST_MIPMAP_NEAREST ||
-			min_filter == GL_LINEAR_MIPMAP_NEAREST ||
-			min_filter == GL_NEAREST_MIPMAP_LINEAR ||
-			min_filter == GL_LINEAR_MIPMAP_LINEAR)
+	if (width == array->width && height == array->height)
 	{
-		glGenerateMipmap(texType);
+		glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE, data);
 	}
-	stbi_image_free(bytes);
-	glBindTexture(texType, 0);
-	tex->type = texType;
+	else
+	{
+		// nearest resize to the array size, so a draw never needs a second array for a texture of another size
+		unsigned char *resized = malloc((size_t)array->width * array->height * 4);
+		for (int y = 0; y < array->height; y++)
+		{
+			int sy = y * height / array->height;
+			for (int x = 0; x < array->width; x++)
+			{
+				int sx = x * width / array->width;
+				memcpy(&(resized[(y * array->width + x) * 4]), &(data[(sy * width + sx) * 4]), 4);
+			}
+		}
+		glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, array->width, array->height, 1, GL_RGBA, GL_UNSIGNED_BYTE, resized);
+		free(resized);
+	}
+	// generating them for the whole array after every layer made loading n textures cost n times the mipmaps
+	if (is_mipmapped_br_texture(min_filter))
+	{
+		array->mipmaps_dirty = 1;
+	}
+	bind_texture(GL_TEXTURE_2D_ARRAY, 0);
+
+	br_texture *tex = calloc(1, sizeof(br_texture));
+	tex->array = index;
+	tex->layer = layer;
+	tex->material = (GLfloat)(index * BR_TEXTURE_ARRAY_LAYERS + layer);
 	tex->manager = manager;
 	pushback_DA(manager->textures, &tex);
-	manager->indices[get_index_DA(manager->textures, &tex)] = index;
 	return tex;
 }
 
-br_texture *create_br_texture_memory(br_texture_manager *manager, unsigned char *data, int width, int height, GLenum texType,
-																		 GLint min_filter, GLint mag_filter, int index, int wraps, int wrapt)
+br_texture *create_br_texture(br_texture_manager *manager, const char *path, GLint min_filter, GLint mag_filter, int wraps, int wrapt)
 {
-	if (get_size_DA(manager->textures) >= 32)
+	int widthImg, heightImg, numColCh;
+	stbi_set_flip_vertically_on_load(1);
+	unsigned char *bytes = stbi_load(path, &widthImg, &heightImg, &numColCh, 4);
+	if (!bytes)
 	{
+		fprintf(stderr, "texture %s can not be loaded\n", path);
 		return 0;
 	}
-	glBindTexture(texType, 0);
-	br_texture *tex = calloc(1, sizeof(br_texture));
-	glGenTextures(1, &(tex->id));
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(texType, tex->id);
-	glTexParameteri(texType, GL_TEXTURE_MIN_FILTER, min_filter);
-	glTexParameteri(texType, GL_TEXTURE_MAG_FILTER, mag_filter);
-	glTexParameteri(texType, GL_TEXTURE_WRAP_S, wraps);
-	glTexParameteri(texType, GL_TEXTURE_WRAP_T, wrapt);
-	glTexImage2D(texType, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-	glGenerateMipmap(texType);
-	glBindTexture(texType, 0);
-	tex->type = texType;
-	tex->manager = manager;
-	pushback_DA(manager->textures, &tex);
-	manager->indices[get_index_DA(manager->textures, &tex)] = index;
+	br_texture *tex = create_br_texture_memory(manager, bytes, widthImg, heightImg, min_filter, mag_filter, wraps, wrapt);
+	stbi_image_free(bytes);
 	return tex;
 }
 
 void delete_br_texture(br_texture *texture)
 {
-	unsigned int index = get_index_DA(texture->manager->textures, &texture);
-	for (int i = index; i < 31; i++)
-	{
-		texture->manager->indices[i] = texture->manager->indices[i + 1];
-	}
-	remove_DA(texture->manager->textures, index);
-	glDeleteTextures(1, &(texture->id));
+	// layer is reused by the next texture of the same array
+	br_texture_array *array = &(((br_texture_array *)get_data_DA(texture->manager->arrays))[texture->array]);
+	pushback_DA(array->free_layers, &(texture->layer));
+	remove_DA(texture->manager->textures, get_index_DA(texture->manager->textures, &texture));
 	free(texture);
 }
 
 void delete_br_texture_manager(br_texture_manager *manager)
 {
 	br_texture **textures = get_data_DA(manager->textures);
-	while (get_size_DA(manager->textures) > 0)
+	for (unsigned int i = 0; i < get_size_DA(manager->textures); i++)
+	{
+		free(textures[i]);
+	}
+	br_texture_array *arrays = get_data_DA(manager->arrays);
+	for (unsigned int i = 0; i < get_size_DA(manager->arrays); i++)
 	{
-		textures = get_data_DA(manager->textures);
-		delete_br_texture(textures[0]);
+		delete_textures(1, &(arrays[i].id));
+		delete_DA(arrays[i].free_layers);
 	}
+	delete_DA(manager->arrays);
 	delete_DA(manager->textures);
-	delete_DA(manager->uniforms);
-	delete_DA(manager->programs);
 	free(manager);
 }
 
-void use_br_texture_manager(br_texture_manager *manager, GLuint program)
+void use_br_texture_manager(br_texture_manager *manager, unsigned int array)
 {
-	br_texture **textures = get_data_DA(manager->textures);
-	for (unsigned int i = 0; i < get_size_DA(manager->textures); i++)
+	if (array >= get_size_DA(manager->arrays))
 	{
-		glActiveTexture(GL_TEXTURE0 + manager->indices[i]);
-		glBindTexture(textures[i]->type, textures[i]->id);
+		return;
 	}
-	if (get_index_DA(manager->programs, &program) == UINT_MAX)
+	br_texture_array *a = &(((br_texture_array *)get_data_DA(manager->arrays))[array]);
+	active_texture(GL_TEXTURE0);
+	bind_texture(GL_TEXTURE_2D_ARRAY, a->id);
+	if (a->mipmaps_dirty)
 	{
-		pushback_DA(manager->programs, &program);
-		GLint uniform = glGetUniformLocation(program, "textures");
-		pushback_DA(manager->uniforms, &uniform);
+		glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+		a->mipmaps_dirty = 0;
 	}
-	GLint *uniforms = get_data_DA(manager->uniforms);
-	unsigned int index = get_index_DA(manager->programs, &program);
-	glUniform1iv(uniforms[index], 32, manager->indices);
 }
\ No newline at end of file
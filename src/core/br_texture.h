@@ -2,33 +2,57 @@
 #include "../../third_party/opengl/include/glad/glad.h"
 #include "dynamic.h"
 
+#define BR_TEXTURE_ARRAY_LAYERS 256
+
+// added to a material in vertex data, shaders clamp v inside the texture instead of repeating it
+#define BR_MATERIAL_CLAMP_T 8388608
+
+// textures with the same sampler parameters are layers of one GL_TEXTURE_2D_ARRAY, the first texture sets its size
+// and later ones are resized to it. a draw binds one array to unit 0 and shaders read it from uniform sampler2DArray materials,
+// so indexing stays dynamically uniform
+typedef struct br_texture_array
+{
+	GLuint id;
+	int width, height;
+	GLint min_filter, mag_filter, wraps, wrapt;
+	unsigned int layer_number;
+	unsigned int layer_capacity;
+	DA *free_layers;
+	unsigned char mipmaps_dirty; // layers changed since mipmaps were generated, they are generated on next use
+} br_texture_array;
+
 typedef struct br_texture_manager
 {
 	DA *textures;
-	int indices[32];
-	DA *programs; // i will save uniforms here. i wont find their locations everytime i render for performance
-	DA *uniforms;
+	DA *arrays; // br_texture_array, one for each sampler parameters used
+	unsigned int layer_hint; // layers a new array is allocated with, see reserve_br_texture_layers
 } br_texture_manager;
 
 typedef struct br_texture
 {
-	GLuint id;
-	GLenum type;
+	unsigned int array;
+	unsigned int layer;
+	GLfloat material; // array * BR_TEXTURE_ARRAY_LAYERS + layer, write this into vertex data as texture index
 	br_texture_manager *manager;
 } br_texture;
 
 br_texture_manager *create_br_texture_manager(void);
 
-// texture slot 31, 30, 29, 28, 27 are reserved for shadowmap and gbuffer, use [0-26]
-br_texture *create_br_texture(br_texture_manager *manager, const char *path, GLenum texType,
-															GLint min_filter, GLint mag_filter, int index, int wraps, int wrapt);
+// arrays created after this start with room for layers textures instead of growing one by one,
+// use it before loading a known number of textures
+void reserve_br_texture_layers(br_texture_manager *manager, unsigned int layers);
+
+// returns 0 and prints why if image cant be loaded or its array has no layer left
+br_texture *create_br_texture(br_texture_manager *manager, const char *path, GLint min_filter, GLint mag_filter, int wraps, int wrapt);
 
-// texture slot 31, 30, 29, 28, 27 are reserved for shadowmap and gbuffer, use [0-26]
-br_texture *create_br_texture_memory(br_texture_manager *manager, unsigned char *data, int width, int height, GLenum texType,
-																		 GLint min_filter, GLint mag_filter, int index, int wraps, int wrapt);
+// data is rgba
+br_texture *create_br_texture_memory(br_texture_manager *manager, unsigned char *data, int width, int height,
+																		 GLint min_filter, GLint mag_filter, int wraps, int wrapt);
 
 void delete_br_texture(br_texture *texture);
 
 void delete_br_texture_manager(br_texture_manager *manager);
 
-void use_br_texture_manager(br_texture_manager *manager, GLuint program);
\ No newline at end of file
+// binds array of manager to unit 0, every material a draw reads has to be in it.
+// arrays are numbered in the order their sampler parameters were first used. mipmaps are generated here if the array changed
+void use_br_texture_manager(br_texture_manager *manager, unsigned int array);
\ No newline at end of file
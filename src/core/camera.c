@@ -1,4 +1,5 @@
 #include "camera.h"
+#include "gl_state.h"
 #include "macro.h"
 
 camera *create_camera(int width, int height, vec3 position, float FOVdeg, float nearPlane, float farPlane, float speed,
@@ -26,15 +27,16 @@ camera *create_camera(int width, int height, vec3 position, float FOVdeg, float
 	glm_vec3_rotate(cam->orientation, glm_rad(angle), angle_axis);
 	glm_mat4_identity(cam->view);
 	glm_mat4_identity(cam->projection);
-	cam->programs = create_DA(sizeof(GLuint), 0);
-	cam->uniforms = create_DA(sizeof(GLint), 0);
+	glGenBuffers(1, &(cam->ubo));
+	bind_buffer(GL_UNIFORM_BUFFER, cam->ubo);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(camera_block), 0, GL_DYNAMIC_DRAW);
+	bind_buffer(GL_UNIFORM_BUFFER, 0);
 	return cam;
 }
 
 void delete_camera(camera *cam)
 {
-	delete_DA(cam->programs);
-	delete_DA(cam->uniforms);
+	delete_buffers(1, &(cam->ubo));
 	free32(cam);
 }
 
@@ -141,25 +143,18 @@ void calculate_camera(camera *cam, float near_plane, float far_plane)
 	glm_mat4_mul(cam->projection, cam->view, cam->result);
 }
 
-void use_camera(camera *cam, GLuint program)
+void update_camera_buffer(camera *cam)
 {
 	calculate_camera(cam, cam->nearPlane, cam->farPlane);
-	if (get_index_DA(cam->programs, &program) == UINT_MAX)
-	{
-		pushback_DA(cam->programs, &program);
-		GLint uniform = glGetUniformLocation(program, "camera");
-		pushback_DA(cam->uniforms, &uniform);
-		uniform = glGetUniformLocation(program, "camPos");
-		pushback_DA(cam->uniforms, &uniform);
-		uniform = glGetUniformLocation(program, "view");
-		pushback_DA(cam->uniforms, &uniform);
-		uniform = glGetUniformLocation(program, "projection");
-		pushback_DA(cam->uniforms, &uniform);
-	}
-	GLint *uniforms = get_data_DA(cam->uniforms);
-	unsigned int index = get_index_DA(cam->programs, &program);
-	glUniformMatrix4fv(uniforms[index * 4], 1, GL_FALSE, cam->result[0]);
-	glUniform3f(uniforms[index * 4 + 1], cam->position[0], cam->position[1], cam->position[2]);
-	glUniformMatrix4fv(uniforms[index * 4 + 2], 1, GL_FALSE, cam->view[0]);
-	glUniformMatrix4fv(uniforms[index * 4 + 3], 1, GL_FALSE, cam->projection[0]);
+	camera_block block;
+	glm_mat4_copy(cam->result, block.camera);
+	glm_mat4_copy(cam->view, block.view);
+	glm_mat4_copy(cam->projection, block.projection);
+	glm_mat4_inv(cam->result, block.inverseCamera);
+	glm_vec3_copy(cam->position, block.camPos);
+	block.time = (float)glfwGetTime();
+	bind_buffer(GL_UNIFORM_BUFFER, cam->ubo);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(camera_block), &block);
+	bind_buffer(GL_UNIFORM_BUFFER, 0);
+	bind_buffer_base(GL_UNIFORM_BUFFER, CAMERA_BLOCK_BINDING, cam->ubo);
 }
\ No newline at end of file
@@ -3,6 +3,18 @@
 #include "../../third_party/opengl/include/glad/glad.h"
 #include "../../third_party/glfw/include/GLFW/glfw3.h"
 #include "dynamic.h"
+#include "shaders.h"
+
+// std140 layout of camera_block in shaders
+typedef struct camera_block
+{
+	mat4 camera;
+	mat4 view;
+	mat4 projection;
+	mat4 inverseCamera; // deferred passes rebuild positions from depth with it
+	vec3 camPos;
+	float time;
+} camera_block;
 
 typedef struct camera
 {
@@ -20,8 +32,7 @@ typedef struct camera
 	float farPlane;
 	mat4 view;
 	mat4 projection;
-	DA *programs; // i will save uniforms here. i wont find their locations everytime i render for performance
-	DA *uniforms;
+	GLuint ubo; // camera_block, written once per frame
 } camera;
 
 camera *create_camera(int width, int height, vec3 position, float FOVdeg, float nearPlane, float farPlane, float speed,
@@ -35,4 +46,5 @@ void run_input_free_camera(camera *cam, GLFWwindow *window);
 
 void calculate_camera(camera *cam, float near_plane, float far_plane);
 
-void use_camera(camera *cam, GLuint program);
\ No newline at end of file
+// writes camera_block and binds it, every program reads the camera from there
+void update_camera_buffer(camera *cam);
\ No newline at end of file
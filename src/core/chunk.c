@@ -59,6 +59,13 @@ chunk_op *create_chunk_op(unsigned int chunk_size, unsigned int chunk_range, pla
   c->chunknumberinrow = (int)ceilf((float)c->dimensionx / c->chunk_size);
   c->chunknumberincolumn = (int)ceilf((float)c->dimensionz / c->chunk_size);
   c->renderedchunkcount = (c->chunk_range * 2 + 1) * (c->chunk_range * 2 + 1);
+  c->buffer = create_world_buffer(1 << 20, 1 << 21);
+  c->visible = create_DA_HIGH_MEMORY(sizeof(chunk_draw), 0);
+  c->terrain_changed = 1;
+  for (int i = 0; i < 4; i++)
+  {
+    c->cascade_visible[i] = create_DA_HIGH_MEMORY(sizeof(chunk_draw), 0);
+  }
   for (int i = 0; i < c->chunknumberinrow; i++)
   {
     for (int i2 = 0; i2 < c->chunknumberincolumn; i2++)
@@ -132,7 +139,7 @@ chunk_op *create_chunk_op(unsigned int chunk_size, unsigned int chunk_range, pla
     pushback_DA(c->allbatch, &batch);
     if (i == c->centerchunkid && gsu_can_exist)
     {
-      br_scene gsu = load_object_br(batch->obj_manager, get_world_texture_manager(), gsu_model, 7, 0, 3, 10, 0.1f, 0.5f);
+      br_scene gsu = load_object_br(batch->obj_manager, get_world_texture_manager(), gsu_model, 0, 3, 10, 0.1f, 0.5f);
       float scalex = gsu_x / (gsu.box.mMax.x - gsu.box.mMin.x),
             scaley = gsu_h / (gsu.box.mMax.y - gsu.box.mMin.y),
             scalez = gsu_z / (gsu.box.mMax.z - gsu.box.mMin.z);
@@ -147,12 +154,12 @@ chunk_op *create_chunk_op(unsigned int chunk_size, unsigned int chunk_range, pla
         scale_br_object(gsu.meshes[i2], (vec3){scalex, scaley, scalez}, 0);
         translate_br_object(gsu.meshes[i2], (vec3){y[c->centerchunkid].minxy[0] - gsu.box.mMin.x, gsu_y + 0.5f - gsu.box.mMin.y, y[c->centerchunkid].minxy[1] - gsu.box.mMin.z}, 0);
       }
-      prepare_render_br_object_manager(batch->obj_manager);
       free(gsu.textures);
       free(gsu.meshes);
     }
     worldtrianglecount += batch->obj_manager->indice_number / 3;
     worldtrianglecount += batch->w->obj->indice_number / 3;
+    add_world_batch(batch, c->buffer);
     delete_cpu_memory_br_object_manager(batch->obj_manager);
     delete_cpu_memory_br_object_manager(batch->w->obj);
   }
@@ -186,6 +193,12 @@ void delete_chunk_op(chunk_op *c)
   free(c->previous_ids);
   free(c->current_ids);
   delete_DA(c->delete_ids);
+  delete_world_buffer(c->buffer);
+  delete_DA(c->visible);
+  for (int i = 0; i < 4; i++)
+  {
+    delete_DA(c->cascade_visible[i]);
+  }
   free(c);
   delete_world_texture_manager();
   delete_water_texture_manager();
@@ -205,20 +218,25 @@ unsigned char inarray(int x, int *array, int size)
 
 void update_chunk_op(chunk_op *c, unsigned char animation)
 {
-  currenttrianglecount = 0;
+  c->terrain_changed = 0;
   // remove deleted chunks after remove animation
   world_batch **z = get_data_DA(c->allbatch);
-remove:
   int *delids = get_data_DA(c->delete_ids);
-  for (unsigned int i = 0; i < get_size_DA(c->delete_ids); i++)
+  for (unsigned int i = get_size_DA(c->delete_ids); i-- > 0;)
   {
     if (has_animation_br_manager(z[delids[i]]->obj_manager) == 0)
     {
       remove_DA(c->batch, get_index_DA(c->batch, &(z[delids[i]])));
       remove_DA(c->delete_ids, i);
-      goto remove;
+      c->terrain_changed = 1;
     }
   }
+  // moving chunks invalidate cached shadows
+  world_batch **b = get_data_DA(c->batch);
+  for (unsigned int i = 0; i < get_size_DA(c->batch) && c->terrain_changed == 0; i++)
+  {
+    c->terrain_changed = has_animation_br_manager(b[i]->obj_manager);
+  }
 
   // dont calculate if it is in same chunk
   float *pos = c->p->fp_camera->position;
@@ -283,6 +301,7 @@ remove:
       if (inarray(index, c->previous_ids, c->renderedchunkcount) == 0)
       {
         pushback_DA(c->batch, &(z[index]));
+        c->terrain_changed = 1;
         if (animation)
         {
           glm_mat4_copy(GLM_MAT4_IDENTITY, z[index]->obj_manager->model);
@@ -308,6 +327,7 @@ remove:
     else
     {
       pushback_DA(c->batch, &(z[index]));
+      c->terrain_changed = 1;
     }
   }
 
@@ -344,41 +364,109 @@ remove:
   c->previous_chunkid = current_id;
 }
 
-void use_chunk_op(chunk_op *c, GLuint program, camera *cam, unsigned char land0_water1)
+void snapshot_chunk_op(chunk_op *c, DA *draws)
 {
-  calculate_camera(cam, cam->nearPlane, cam->farPlane);
   world_batch **x = get_data_DA(c->batch);
+  clear_DA(draws);
+  for (unsigned int i = 0; i < get_size_DA(c->batch); i++)
+  {
+    chunk_draw d;
+    d.batch = x[i];
+    glm_vec3_copy(x[i]->obj_manager->translation[3], d.land_offset);
+    glm_vec3_zero(d.water_offset);
+    if (x[i]->w != 0)
+    {
+      glm_vec3_copy(x[i]->w->obj->translation[3], d.water_offset);
+    }
+    pushback_DA(draws, &d);
+  }
+}
+
+void update_visibility_chunk_op(chunk_op *c, DA *draws, camera *cam, lighting *l)
+{
+  // counted again by the draws of this frame
+  currenttrianglecount = 0;
+  chunk_draw *x = get_data_DA(draws);
   chunk_info *y = get_data_DA(c->chunkinfo);
   vec3 box2[2];
   vec4 planes[6] = {0};
+  vec4 cascade_planes[4][6] = {0};
   glm_frustum_planes(cam->result, planes);
+  for (int i = 0; i < 4; i++)
+  {
+    glm_frustum_planes(l->lightProjection[i], cascade_planes[i]);
+    clear_DA(c->cascade_visible[i]);
+  }
+  clear_DA(c->visible);
   vec3 center;
-  for (unsigned int i = 0; i < get_size_DA(c->batch); i++)
+  for (unsigned int i = 0; i < get_size_DA(draws); i++)
   {
-    box2[0][0] = y[x[i]->chunk_id].minxy[0];
-    box2[0][1] = y[x[i]->chunk_id].minz;
-    box2[0][2] = y[x[i]->chunk_id].minxy[1];
-    box2[1][0] = y[x[i]->chunk_id].maxxy[0];
-    box2[1][1] = y[x[i]->chunk_id].maxz;
-    box2[1][2] = y[x[i]->chunk_id].maxxy[1];
+    chunk_info *info = &y[x[i].batch->chunk_id];
+    box2[0][0] = info->minxy[0];
+    box2[0][1] = info->minz;
+    box2[0][2] = info->minxy[1];
+    box2[1][0] = info->maxxy[0];
+    box2[1][1] = info->maxz;
+    box2[1][2] = info->maxxy[1];
     glm_aabb_center(box2, center);
     if (glm_aabb_frustum(box2, planes) ||
         glm_vec3_distance((vec3){cam->position[0], 0, cam->position[2]}, (vec3){center[0], 0, center[2]}) <= 64.0f)
     {
-      if (land0_water1 == 0)
-      {
-        use_world_batch_land(x[i], program);
-        currenttrianglecount += x[i]->obj_manager->indice_number / 3;
-      }
-      else
+      pushback_DA(c->visible, &(x[i]));
+    }
+    // light projections are already stretched towards the light with zMult so casters outside the view are kept
+    for (int i2 = 0; i2 < 4; i2++)
+    {
+      if (glm_aabb_frustum(box2, cascade_planes[i2]))
       {
-        use_world_batch_water(x[i], program);
-        currenttrianglecount += x[i]->w->obj->indice_number / 3;
+        pushback_DA(c->cascade_visible[i2], &(x[i]));
       }
     }
   }
 }
 
+void draw_chunk_list(chunk_op *c, GLuint program, DA *list, unsigned char land0_water1)
+{
+  chunk_draw *x = get_data_DA(list);
+  clear_world_buffer(c->buffer);
+  for (unsigned int i = 0; i < get_size_DA(list); i++)
+  {
+    if (land0_water1 == 1)
+    {
+      push_world_batch_water(x[i].batch, c->buffer, x[i].water_offset);
+      currenttrianglecount += x[i].batch->water_draw.indice_number / 3;
+    }
+    else
+    {
+      push_world_batch_land(x[i].batch, c->buffer, x[i].land_offset);
+      currenttrianglecount += x[i].batch->land_draw.indice_number / 3;
+    }
+  }
+  // one texture bind and one draw for the whole pass
+  if (land0_water1 == 1)
+  {
+    if (get_water_texture_manager() != 0)
+    {
+      use_br_texture_manager(get_water_texture_manager(), 0);
+    }
+  }
+  else
+  {
+    use_br_texture_manager(get_world_texture_manager(), 0);
+  }
+  use_world_buffer(c->buffer, program);
+}
+
+void use_chunk_op(chunk_op *c, GLuint program, unsigned char land0_water1)
+{
+  draw_chunk_list(c, program, c->visible, land0_water1);
+}
+
+void use_chunk_op_cascade(chunk_op *c, GLuint program, int cascade)
+{
+  draw_chunk_list(c, program, c->cascade_visible[cascade], 0);
+}
+
 int get_world_triangle_count(void)
 {
   return worldtrianglecount;
@@ -2,7 +2,10 @@
 #include "player.h"
 #include "dynamic.h"
 #include "camera.h"
+#include "lighting.h"
 #include "load_object.h"
+#include "world_buffer.h"
+#include "world_batch.h"
 
 typedef struct chunk_op
 {
@@ -22,8 +25,20 @@ typedef struct chunk_op
   int *previous_ids;
   int *current_ids;
   DA *delete_ids;
+  world_buffer *buffer;
+  DA *visible;           // chunk_draws in camera frustum
+  DA *cascade_visible[4]; // shadow casters of every cascade
+  unsigned char terrain_changed; // chunks were added, removed or animated in last update_chunk_op
 } chunk_op;
 
+// a loaded chunk with the translations it had when it was snapshotted, animations move the originals
+typedef struct chunk_draw
+{
+  world_batch *batch;
+  vec3 land_offset;
+  vec3 water_offset;
+} chunk_draw;
+
 typedef struct chunk_info
 {
   vec2 minxy, maxxy;
@@ -38,7 +53,18 @@ void delete_chunk_op(chunk_op *c);
 
 void update_chunk_op(chunk_op *c, unsigned char animation);
 
-void use_chunk_op(chunk_op *c, GLuint program, camera *cam, unsigned char land0_water1);
+// fills draws (DA of chunk_draw) with the loaded chunks. only update_chunk_op and animations change what is copied,
+// so draws can be rendered on another thread while they run
+void snapshot_chunk_op(chunk_op *c, DA *draws);
+
+// builds the visibility lists from a snapshot once per frame, call it after update_lighting
+void update_visibility_chunk_op(chunk_op *c, DA *draws, camera *cam, lighting *l);
+
+// draws the list built by update_visibility_chunk_op, 0 is land of visible chunks, 1 is water of visible chunks
+void use_chunk_op(chunk_op *c, GLuint program, unsigned char land0_water1);
+
+// draws land of the shadow casters of one cascade
+void use_chunk_op_cascade(chunk_op *c, GLuint program, int cascade);
 
 void set_gsu_model(struct aiScene *model);
 
@@ -27,6 +27,7 @@ extern "C"
 #include "timing.h"
 #include "animation.h"
 #include "random.h"
+#include "glyph_atlas.h"
 #include "font.h"
 #include "skybox.h"
 #include "jolt_physics.h"
@@ -37,6 +38,12 @@ extern "C"
 #include "threading.h"
 #include "water.h"
 #include "macro.h"
+#include "gl_extensions.h"
+#include "world_buffer.h"
+#include "stream_buffer.h"
+#include "gl_state.h"
+#include "gpu_timing.h"
+#include "frame_graph.h"
 #ifdef __cplusplus
 }
 #endif
\ No newline at end of file
@@ -1,174 +1,179 @@
 #include "font.h"
-#include "../../third_party/freetype/include/ft2build.h"
+#include "gl_state.h"
 #include <stdarg.h>
-#include FT_FREETYPE_H
-#ifdef _MSC_VER
-#include <Windows.h>
-#endif
+#include <string.h>
 #include "macro.h"
 
-text_manager *create_text_manager(const char *font_file, int height, int screenwidth, int screenheight,
-                                  int realsw, int realsh, GLint min_filter, GLint mag_filter)
+text_manager *create_text_manager(glyph_atlas *atlas, int height, int screenwidth, int screenheight, int realsw, int realsh)
 {
-  FT_Library ft;
-  if (FT_Init_FreeType(&ft))
-  {
-#ifdef _MSC_VER
-    MessageBox(0, "FT_Init_FreeType Error", "Error", 0);
-#endif
-  }
-  FT_Face face;
-  if (FT_New_Face(ft, font_file, 0, &face))
-  {
-#ifdef _MSC_VER
-    MessageBox(0, "FT_New_Face Error", "Error", 0);
-#endif
-  }
-  if (FT_Set_Pixel_Sizes(face, 0, height))
-  {
-#ifdef _MSC_VER
-    MessageBox(0, "FT_Set_Pixel_Sizes Error", "Error", 0);
-#endif
-  }
-
   text_manager *f = 0;
   malloc32(f, sizeof(text_manager));
-  f->twidth = 0, f->theight = 0;
-  for (unsigned char c = 32; c < 127; c++)
-  {
-    if (FT_Load_Char(face, c, FT_LOAD_BITMAP_METRICS_ONLY))
-    {
-#ifdef _MSC_VER
-      MessageBox(0, "FT_Load_Char Error", "Error", 0);
-#endif
-    }
-
-    f->sizex[c - 32] = face->glyph->bitmap.width;
-    f->sizey[c - 32] = face->glyph->bitmap.rows;
-    f->bearingx[c - 32] = face->glyph->bitmap_left;
-    f->bearingy[c - 32] = face->glyph->bitmap_top;
-    f->advancex[c - 32] = face->glyph->advance.x;
-    f->twidth += face->glyph->bitmap.width;
-    f->theight = max(f->theight, face->glyph->bitmap.rows);
-  }
-
-  f->twidth += 95; // extra 1 pixel between textures
-
-  glGenTextures(1, &f->font_textures);
-  glBindTexture(GL_TEXTURE_2D, f->font_textures);
-  glPixelStorei(GL_PACK_ALIGNMENT, 1);
-  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, f->twidth, f->theight, 0, GL_RED, GL_UNSIGNED_BYTE, 0);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, min_filter);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, mag_filter);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-  if (min_filter == GL_NEAREST_MIPMAP_NEAREST ||
-      min_filter == GL_LINEAR_MIPMAP_NEAREST ||
-      min_filter == GL_NEAREST_MIPMAP_LINEAR ||
-      min_filter == GL_LINEAR_MIPMAP_LINEAR)
-  {
-    glGenerateMipmap(GL_TEXTURE_2D);
-  }
-
-  int x = 0;
-
-  for (unsigned char c = 32; c < 127; c++)
-  {
-    if (FT_Load_Char(face, c, FT_LOAD_RENDER))
-    {
-#ifdef _MSC_VER
-      MessageBox(0, "FT_Load_Char Error", "Error", 0);
-#endif
-    }
-    if (face->glyph->bitmap.buffer != 0)
-    {
-      glTexSubImage2D(GL_TEXTURE_2D, 0, x, 0, face->glyph->bitmap.width, face->glyph->bitmap.rows,
-                      GL_RED, GL_UNSIGNED_BYTE, face->glyph->bitmap.buffer);
-    }
-    f->xoffset[c - 32] = (float)x / (float)f->twidth;
-    x += face->glyph->bitmap.width + 1;
-  }
-
-  FT_Done_Face(face);
-  FT_Done_FreeType(ft);
+  f->atlas = atlas;
+  f->size = height;
+  f->line_height = get_glyph_line_height(atlas, height);
+  f->generation = atlas->generation;
   f->screenwidth = screenwidth;
   f->screenheight = screenheight;
   f->realsw = realsw;
   f->realsh = realsh;
+  f->framebuffer = 0;
   glm_ortho(0.0f, (float)screenwidth, 0.0f, (float)screenheight, -100.0f, 100.0f, f->projection);
   f->VAO = 0;
-  f->VBO = 0;
   f->EBO = 0;
   f->vertices = create_DA_HIGH_MEMORY(sizeof(GLfloat), 0);
-  f->indices = create_DA_HIGH_MEMORY(sizeof(GLuint), 0);
+  f->fields = create_DA(sizeof(text_field), 0);
+  f->buffer = 0;
+  f->buffer_quads = 0;
+  f->dirty_start = UINT_MAX;
+  f->dirty_end = 0;
   f->programs = create_DA(sizeof(GLuint), 0);
   f->uniforms = create_DA(sizeof(GLint), 0);
-  f->newdata = 0;
   return f;
 }
 
 void delete_text_manager(text_manager *f)
 {
-  glDeleteTextures(1, &(f->font_textures));
+  clear_text_manager(f);
   delete_DA(f->vertices);
-  delete_DA(f->indices);
+  delete_DA(f->fields);
   delete_DA(f->programs);
   delete_DA(f->uniforms);
-  glDeleteVertexArrays(1, &(f->VAO));
-  glDeleteBuffers(1, &(f->VBO));
-  glDeleteBuffers(1, &(f->EBO));
+  delete_vertex_arrays(1, &(f->VAO));
+  delete_buffers(1, &(f->EBO));
+  delete_stream_buffer(f->buffer);
   free32(f);
 }
 
-void add_text(text_manager *f, float startx, float starty, float z, int scale, vec4 rgba, const char *text)
+void mark_text_manager(text_manager *f, unsigned int first_quad, unsigned int quad_number)
 {
+  f->dirty_start = min(f->dirty_start, first_quad * 36);
+  f->dirty_end = max(f->dirty_end, (first_quad + quad_number) * 36);
+}
+
+// writes glyph quads of text into vertices and returns how many were written, new lines have no quad.
+// glyphs without a place in the atlas get an empty quad
+unsigned int layout_text(text_manager *f, GLfloat *vertices, unsigned int max_quads, float startx, float starty,
+                         float z, int scale, const float *rgba, const char *text)
+{
+  glyph_atlas *a = f->atlas;
+  float size = get_glyph_scale(a, f->size) * scale;
   startx = (float)((int)startx);
   starty = (float)((int)starty);
-  f->newdata = 1;
-  GLuint *indices = malloc(sizeof(GLuint) * 6 * strlen(text));
-  unsigned int vertex_start = get_size_DA(f->vertices) / 9;
-  for (unsigned int i = 0; i < strlen(text); i++)
-  {
-    indices[i * 6] = 2 + vertex_start + 4 * i;
-    indices[i * 6 + 1] = 1 + vertex_start + 4 * i;
-    indices[i * 6 + 2] = vertex_start + 4 * i;
-    indices[i * 6 + 3] = vertex_start + 4 * i;
-    indices[i * 6 + 4] = 3 + vertex_start + 4 * i;
-    indices[i * 6 + 5] = 2 + vertex_start + 4 * i;
-  }
   float old_startx = startx;
-  for (unsigned int i = 0; i < strlen(text); i++)
+  unsigned int quads = 0;
+  const char *c = text;
+  while (*c != 0 && quads < max_quads)
   {
-    if (text[i] == '\n')
+    unsigned int codepoint = decode_utf8(&c);
+    if (codepoint == '\n')
     {
-      starty -= (f->theight + 3) * scale;
+      starty -= f->line_height * scale;
       startx = old_startx;
       continue;
     }
-    char ascii = text[i];
-    if (ascii < 32 || ascii > 126)
+    if (codepoint < 32)
+    {
+      codepoint = 32;
+    }
+    glyph *g = get_glyph(a, codepoint, f->size);
+    GLfloat *quad = vertices + quads * 36;
+    quads++;
+    if (g->shelf == UINT_MAX)
     {
-      ascii = 32;
+      memset(quad, 0, sizeof(GLfloat) * 36);
+      startx += g->advancex * size;
+      continue;
     }
-    ascii = ascii - 32;
-    float xpos = startx + f->bearingx[ascii] * scale;
-    float ypos = starty - (f->sizey[ascii] - f->bearingy[ascii]) * scale;
-    float w = f->sizex[ascii] * (float)scale;
-    float h = f->sizey[ascii] * (float)scale;
-    startx += (f->advancex[ascii] >> 6) * scale;
-    GLfloat vertices[] = {
-        xpos, ypos + h, z, f->xoffset[ascii], 0, rgba[0], rgba[1], rgba[2], rgba[3],                                      // 0
-        xpos, ypos, z, f->xoffset[ascii], (float)f->sizey[ascii] / (float)f->theight, rgba[0], rgba[1], rgba[2], rgba[3], // 1
-        xpos + w, ypos, z, f->xoffset[ascii] + (float)f->sizex[ascii] / (float)f->twidth,
-        (float)f->sizey[ascii] / (float)f->theight, rgba[0], rgba[1], rgba[2], rgba[3],                                              // 2
-        xpos + w, ypos + h, z, f->xoffset[ascii] + (float)f->sizex[ascii] / (float)f->twidth, 0, rgba[0], rgba[1], rgba[2], rgba[3], // 3
+    float xpos = startx + g->bearingx * size;
+    float ypos = starty - (g->height - g->bearingy) * size;
+    float w = g->width * size;
+    float h = g->height * size;
+    float u0 = (float)g->x / a->width;
+    float u1 = (float)(g->x + g->width) / a->width;
+    float v0 = (float)g->y / a->height;
+    float v1 = (float)(g->y + g->height) / a->height;
+    startx += g->advancex * size;
+    GLfloat vertex[] = {
+        xpos, ypos + h, z, u0, v0, rgba[0], rgba[1], rgba[2], rgba[3],     // 0
+        xpos, ypos, z, u0, v1, rgba[0], rgba[1], rgba[2], rgba[3],         // 1
+        xpos + w, ypos, z, u1, v1, rgba[0], rgba[1], rgba[2], rgba[3],     // 2
+        xpos + w, ypos + h, z, u1, v0, rgba[0], rgba[1], rgba[2], rgba[3], // 3
     };
-    pushback_many_DA(f->vertices, vertices, 36);
+    memcpy(quad, vertex, sizeof(vertex));
   }
-  pushback_many_DA(f->indices, indices, 6 * (unsigned int)strlen(text));
-  free(indices);
+  return quads;
+}
+
+unsigned int count_text_quads(const char *text)
+{
+  unsigned int quads = 0;
+  const char *c = text;
+  while (*c != 0)
+  {
+    quads += decode_utf8(&c) != '\n';
+  }
+  return quads;
+}
+
+// writes the quads of a field from its text, empty quads after the text
+void layout_text_field(text_manager *f, text_field *x)
+{
+  GLfloat *vertices = (GLfloat *)get_data_DA(f->vertices) + x->first_quad * 36;
+  unsigned int quads = layout_text(f, vertices, x->capacity, x->startx, x->starty, x->z, x->scale, x->rgba, x->text);
+  memset(vertices + quads * 36, 0, sizeof(GLfloat) * 36 * (x->capacity - quads));
+  mark_text_manager(f, x->first_quad, x->capacity);
+}
+
+// static text is a field that is never set again, so it can be laid out again when the atlas evicts its glyphs
+void add_text(text_manager *f, float startx, float starty, float z, int scale, vec4 rgba, const char *text)
+{
+  unsigned int quads = count_text_quads(text);
+  if (quads == 0)
+  {
+    return;
+  }
+  set_text_field(f, add_text_field(f, startx, starty, z, scale, rgba, quads), text);
+}
+
+unsigned int add_text_field(text_manager *f, float startx, float starty, float z, int scale, vec4 rgba, unsigned int capacity)
+{
+  text_field field;
+  field.startx = startx;
+  field.starty = starty;
+  field.z = z;
+  field.scale = scale;
+  memcpy(field.rgba, rgba, sizeof(field.rgba)); // fields are not aligned like vec4
+  field.first_quad = get_size_DA(f->vertices) / 36;
+  field.capacity = capacity;
+  field.text = calloc(1, 1);
+  pushback_DA(f->fields, &field);
+  // empty quads until the field gets a text
+  GLfloat empty[36] = {0};
+  for (unsigned int i = 0; i < capacity; i++)
+  {
+    pushback_many_DA(f->vertices, empty, 36);
+  }
+  mark_text_manager(f, field.first_quad, capacity);
+  return get_size_DA(f->fields) - 1;
+}
+
+void set_text_field(text_manager *f, unsigned int field, const char *text)
+{
+  text_field *x = (text_field *)get_data_DA(f->fields) + field;
+  if (strcmp(x->text, text) == 0)
+  {
+    return;
+  }
+  size_t length = strlen(text);
+  x->text = realloc(x->text, length + 1);
+  memcpy(x->text, text, length + 1);
+  stamp_glyph_atlas(f->atlas);
+  layout_text_field(f, x);
+}
+
+float get_text_line_height(text_manager *f, int scale)
+{
+  return f->line_height * scale;
 }
 
 char static_text[1024];
@@ -182,6 +187,15 @@ void add_text_variadic(text_manager *f, float startx, float starty, float z, int
   add_text(f, startx, starty, z, scale, rgba, static_text);
 }
 
+void set_text_field_variadic(text_manager *f, unsigned int field, const char *text, ...)
+{
+  va_list args;
+  va_start(args, text);
+  vsnprintf(static_text, 1024 * sizeof(char), text, args);
+  va_end(args);
+  set_text_field(f, field, static_text);
+}
+
 void get_text_size_variadic(text_manager *f, int scale, float *width, float *height, const char *text, ...)
 {
   va_list args;
@@ -195,28 +209,30 @@ void get_text_size(text_manager *f, int scale, const char *text, float *width, f
 {
   *width = 0;
   *height = 0;
+  float size = get_glyph_scale(f->atlas, f->size) * scale;
   float startx = 0;
   float starty = 0;
   float old_startx = startx;
-  for (unsigned int i = 0; i < strlen(text); i++)
+  const char *c = text;
+  while (*c != 0)
   {
-    if (text[i] == '\n')
+    unsigned int codepoint = decode_utf8(&c);
+    if (codepoint == '\n')
     {
-      starty -= (f->theight + 3) * scale;
+      starty -= f->line_height * scale;
       startx = old_startx;
       continue;
     }
-    char ascii = text[i];
-    if (ascii < 32 || ascii > 126)
+    if (codepoint < 32)
     {
-      ascii = 32;
+      codepoint = 32;
     }
-    ascii = ascii - 32;
-    float xpos = startx + f->bearingx[ascii] * scale;
-    float ypos = starty - (f->sizey[ascii] - f->bearingy[ascii]) * scale;
-    float w = f->sizex[ascii] * (float)scale;
-    float h = f->sizey[ascii] * (float)scale;
-    startx += (f->advancex[ascii] >> 6) * scale;
+    glyph *g = get_glyph(f->atlas, codepoint, f->size);
+    float xpos = startx + g->bearingx * size;
+    float ypos = starty - (g->height - g->bearingy) * size;
+    float w = g->width * size;
+    float h = g->height * size;
+    startx += g->advancex * size;
     *width = max(*width, xpos + w);
     *height = max(*height, ypos + h);
   }
@@ -224,68 +240,108 @@ void get_text_size(text_manager *f, int scale, const char *text, float *width, f
 
 void use_text_manager(text_manager *f, GLuint program)
 {
-  if ((f->VAO == 0 || f->newdata == 1) && get_size_DA(f->indices) > 0)
+  unsigned int quads = get_size_DA(f->vertices) / 36;
+  if (quads == 0)
   {
-    f->newdata = 0;
-    glDeleteVertexArrays(1, &(f->VAO));
-    glDeleteBuffers(1, &(f->VBO));
-    glDeleteBuffers(1, &(f->EBO));
-    glBindVertexArray(0);
+    return;
+  }
+  if (f->generation != f->atlas->generation)
+  {
+    // glyphs of some texts were evicted, one stamp keeps all of them while they are placed again
+    f->generation = f->atlas->generation;
+    stamp_glyph_atlas(f->atlas);
+    text_field *fields = get_data_DA(f->fields);
+    for (unsigned int i = 0; i < get_size_DA(f->fields); i++)
+    {
+      layout_text_field(f, fields + i);
+    }
+  }
+  if (quads > f->buffer_quads)
+  {
+    // buffer and indices grow to twice of what is needed, everything is uploaded again
+    f->buffer_quads = max(256, quads * 2);
+    delete_stream_buffer(f->buffer);
+    f->buffer = create_stream_buffer(f->buffer_quads * 36 * sizeof(GLfloat), 0);
+    f->dirty_start = 0;
+    f->dirty_end = quads * 36;
+    GLuint *indices = malloc(sizeof(GLuint) * 6 * f->buffer_quads);
+    for (unsigned int i = 0; i < f->buffer_quads; i++)
+    {
+      indices[i * 6] = 2 + 4 * i;
+      indices[i * 6 + 1] = 1 + 4 * i;
+      indices[i * 6 + 2] = 4 * i;
+      indices[i * 6 + 3] = 4 * i;
+      indices[i * 6 + 4] = 3 + 4 * i;
+      indices[i * 6 + 5] = 2 + 4 * i;
+    }
+    delete_vertex_arrays(1, &(f->VAO));
+    delete_buffers(1, &(f->EBO));
+    bind_vertex_array(0);
     glGenVertexArrays(1, &(f->VAO));
-    glGenBuffers(1, &(f->VBO));
     glGenBuffers(1, &(f->EBO));
-    glBindVertexArray(f->VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, f->VBO);
-    glBufferData(GL_ARRAY_BUFFER, get_size_DA(f->vertices) * sizeof(GLfloat), get_data_DA(f->vertices), GL_STATIC_DRAW);
+    bind_vertex_array(f->VAO);
+    bind_buffer(GL_ARRAY_BUFFER, f->buffer->buffer);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(GLfloat), 0);
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 9 * sizeof(GLfloat), (void *)(3 * sizeof(GLfloat)));
     glEnableVertexAttribArray(1);
     glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, 9 * sizeof(GLfloat), (void *)(5 * sizeof(GLfloat)));
     glEnableVertexAttribArray(2);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, f->EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, get_size_DA(f->indices) * sizeof(GLuint), get_data_DA(f->indices), GL_STATIC_DRAW);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    bind_buffer(GL_ELEMENT_ARRAY_BUFFER, f->EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * 6 * f->buffer_quads, indices, GL_STATIC_DRAW);
+    bind_buffer(GL_ARRAY_BUFFER, 0);
+    bind_vertex_array(0);
+    bind_buffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    free(indices);
   }
-  if (f->VAO != 0)
+  if (f->dirty_start < f->dirty_end)
   {
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    glViewport(0, 0, f->realsw, f->realsh);
-    glClear(GL_DEPTH_BUFFER_BIT);
-    glActiveTexture(GL_TEXTURE31);
-    glBindTexture(GL_TEXTURE_2D, f->font_textures);
-    if (get_index_DA(f->programs, &program) == UINT_MAX)
-    {
-      pushback_DA(f->programs, &program);
-      GLint uniform = glGetUniformLocation(program, "projection");
-      pushback_DA(f->uniforms, &uniform);
-      uniform = glGetUniformLocation(program, "font_textures");
-      pushback_DA(f->uniforms, &uniform);
-    }
-    GLint *uniforms = get_data_DA(f->uniforms);
-    unsigned int index = get_index_DA(f->programs, &program);
-    glUniformMatrix4fv(uniforms[index * 2], 1, GL_FALSE, f->projection[0]);
-    glUniform1i(uniforms[index * 2 + 1], 31);
+    mark_stream_buffer(f->buffer, f->dirty_start * sizeof(GLfloat), (f->dirty_end - f->dirty_start) * sizeof(GLfloat));
+    f->dirty_start = UINT_MAX;
+    f->dirty_end = 0;
+  }
+  // every region holds a whole copy so base vertex selects the region
+  GLint base_vertex = (GLint)(update_stream_buffer(f->buffer, get_data_DA(f->vertices)) / (9 * sizeof(GLfloat)));
 
-    glBindVertexArray(f->VAO);
-    glDrawElements(GL_TRIANGLES, get_size_DA(f->indices), GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
-    glDisable(GL_BLEND);
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  bind_framebuffer(GL_FRAMEBUFFER, f->framebuffer);
+  set_viewport(0, 0, f->realsw, f->realsh);
+  glClear(GL_DEPTH_BUFFER_BIT);
+  active_texture(GL_TEXTURE31);
+  bind_texture(GL_TEXTURE_2D, f->atlas->texture);
+  if (get_index_DA(f->programs, &program) == UINT_MAX)
+  {
+    pushback_DA(f->programs, &program);
+    GLint uniform = glGetUniformLocation(program, "projection");
+    pushback_DA(f->uniforms, &uniform);
+    uniform = glGetUniformLocation(program, "font_textures");
+    pushback_DA(f->uniforms, &uniform);
+    uniform = glGetUniformLocation(program, "sdf");
+    pushback_DA(f->uniforms, &uniform);
   }
+  GLint *uniforms = get_data_DA(f->uniforms);
+  unsigned int index = get_index_DA(f->programs, &program);
+  glUniformMatrix4fv(uniforms[index * 3], 1, GL_FALSE, f->projection[0]);
+  glUniform1i(uniforms[index * 3 + 1], 31);
+  glUniform1i(uniforms[index * 3 + 2], f->atlas->sdf);
+
+  bind_vertex_array(f->VAO);
+  glDrawElementsBaseVertex(GL_TRIANGLES, quads * 6, GL_UNSIGNED_INT, 0, base_vertex);
+  fence_stream_buffer(f->buffer);
+  glDisable(GL_BLEND);
 }
 
+// drops every text and field, buffers are kept for the next texts
 void clear_text_manager(text_manager *f)
 {
+  text_field *fields = get_data_DA(f->fields);
+  for (unsigned int i = 0; i < get_size_DA(f->fields); i++)
+  {
+    free(fields[i].text);
+  }
+  clear_DA(f->fields);
   clear_DA(f->vertices);
-  clear_DA(f->indices);
-  glDeleteVertexArrays(1, &(f->VAO));
-  glDeleteBuffers(1, &(f->VBO));
-  glDeleteBuffers(1, &(f->EBO));
-  f->VAO = 0;
-  f->VBO = 0;
-  f->EBO = 0;
-}
\ No newline at end of file
+  f->dirty_start = UINT_MAX;
+  f->dirty_end = 0;
+}
@@ -1,32 +1,46 @@
 #pragma once
 #include "../../third_party/opengl/include/glad/glad.h"
 #include "dynamic.h"
+#include "stream_buffer.h"
+#include "glyph_atlas.h"
 #include "../../third_party/cglm/include/cglm/cglm.h"
 
-// chars start from 32
+// text that changes keeps its place in the vertices, only its own glyph quads are rewritten
+typedef struct text_field
+{
+  float startx, starty, z;
+  int scale;
+  float rgba[4];
+  unsigned int first_quad;
+  unsigned int capacity; // glyphs, longer text is cut and unused quads are empty
+  char *text;            // utf-8, setting the same text again does nothing
+} text_field;
+
+// text is utf-8 and retained until clear_text_manager, every glyph is a quad of 4 vertices
+// and 6 indices with the same pattern so indices are only made when the buffer grows.
+// glyphs come from an atlas that can be shared with managers of other sizes
 typedef struct text_manager
 {
-  GLuint font_textures;
-  GLuint VAO, VBO, EBO;
-  DA *vertices; // 3 vertex coord, 2 texture coord, 3 rgb
-  DA *indices;
-  int sizex[95];
-  int sizey[95];
-  int bearingx[95];
-  int bearingy[95];
-  int advancex[95];
-  float xoffset[95];
+  glyph_atlas *atlas;
+  int size;                // pixel height
+  float line_height;       // at scale 1
+  unsigned int generation; // atlas generation the quads were laid out with
+  GLuint VAO, EBO;
+  DA *vertices; // 3 vertex coord, 2 texture coord, 4 rgba
+  DA *fields;
+  stream_buffer *buffer;
+  unsigned int buffer_quads;
+  unsigned int dirty_start, dirty_end; // changed floats of vertices
   mat4 projection;
   DA *programs; // i will save uniforms here. i wont find their locations everytime i render for performance
   DA *uniforms;
-  unsigned char newdata;
   int screenwidth, screenheight;
   int realsw, realsh;
-  unsigned int twidth, theight;
+  GLuint framebuffer; // text is drawn here, 0 is the window
 } text_manager;
 
-text_manager *create_text_manager(const char *font_file, int height, int screenwidth, int screenheight,
-                                  int realsw, int realsh, GLint min_filter, GLint mag_filter);
+// atlas has to outlive the manager
+text_manager *create_text_manager(glyph_atlas *atlas, int height, int screenwidth, int screenheight, int realsw, int realsh);
 
 void delete_text_manager(text_manager *f);
 
@@ -34,6 +48,16 @@ void add_text(text_manager *f, float startx, float starty, float z, int scale, v
 
 void add_text_variadic(text_manager *f, float startx, float starty, float z, int scale, vec4 rgba, const char *text, ...);
 
+// reserves capacity glyphs at startx, starty and returns the field for set_text_field
+unsigned int add_text_field(text_manager *f, float startx, float starty, float z, int scale, vec4 rgba, unsigned int capacity);
+
+void set_text_field(text_manager *f, unsigned int field, const char *text);
+
+void set_text_field_variadic(text_manager *f, unsigned int field, const char *text, ...);
+
+// distance between lines of a multi line text
+float get_text_line_height(text_manager *f, int scale);
+
 void get_text_size(text_manager *f, int scale, const char *text, float *width, float *height);
 
 void get_text_size_variadic(text_manager *f, int scale, float *width, float *height, const char *text, ...);
@@ -0,0 +1,523 @@
+#include "frame_graph.h"
+#include "gl_state.h"
+#include "gpu_timing.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+frame_graph *create_frame_graph(void)
+{
+	frame_graph *g = malloc(sizeof(frame_graph));
+	g->resources = create_DA(sizeof(fg_resource), 0);
+	g->passes = create_DA(sizeof(fg_pass), 0);
+	g->order = create_DA(sizeof(unsigned int), 0);
+	g->textures = create_DA(sizeof(fg_texture), 0);
+	g->framebuffers = create_DA(sizeof(fg_framebuffer), 0);
+	g->peak_bytes = 0;
+	g->unaliased_bytes = 0;
+	g->pool_bytes = 0;
+	return g;
+}
+
+void delete_frame_graph(frame_graph *g)
+{
+	fg_texture *textures = get_data_DA(g->textures);
+	for (unsigned int i = 0; i < get_size_DA(g->textures); i++)
+	{
+		delete_textures(1, &(textures[i].texture));
+	}
+	fg_framebuffer *framebuffers = get_data_DA(g->framebuffers);
+	for (unsigned int i = 0; i < get_size_DA(g->framebuffers); i++)
+	{
+		delete_framebuffers(1, &(framebuffers[i].framebuffer));
+	}
+	delete_DA(g->resources);
+	delete_DA(g->passes);
+	delete_DA(g->order);
+	delete_DA(g->textures);
+	delete_DA(g->framebuffers);
+	free(g);
+}
+
+void reset_frame_graph(frame_graph *g)
+{
+	clear_DA(g->resources);
+	clear_DA(g->passes);
+	clear_DA(g->order);
+}
+
+unsigned int create_frame_graph_texture(frame_graph *g, const char *name, GLenum internal_format, int width, int height,
+																				GLint filter, GLint wrap)
+{
+	fg_resource r;
+	r.name = name;
+	r.internal_format = internal_format;
+	r.width = width;
+	r.height = height;
+	r.filter = filter;
+	r.wrap = wrap;
+	r.imported = 0;
+	r.texture = 0;
+	r.first_pass = -1;
+	r.last_pass = -1;
+	pushback_DA(g->resources, &r);
+	return get_size_DA(g->resources) - 1;
+}
+
+unsigned int import_frame_graph_texture(frame_graph *g, const char *name, GLuint texture)
+{
+	unsigned int resource = create_frame_graph_texture(g, name, 0, 0, 0, 0, 0);
+	fg_resource *r = (fg_resource *)get_data_DA(g->resources) + resource;
+	r->imported = 1;
+	r->texture = texture;
+	return resource;
+}
+
+unsigned int add_frame_graph_pass(frame_graph *g, const char *name, frame_graph_execute execute, void *data, unsigned char side_effect)
+{
+	fg_pass p;
+	p.name = name;
+	p.execute = execute;
+	p.data = data;
+	p.read_count = 0;
+	p.write_count = 0;
+	p.side_effect = side_effect;
+	p.culled = 0;
+	p.framebuffer = 0;
+	pushback_DA(g->passes, &p);
+	return get_size_DA(g->passes) - 1;
+}
+
+void read_frame_graph_pass(frame_graph *g, unsigned int pass, unsigned int resource)
+{
+	fg_pass *p = (fg_pass *)get_data_DA(g->passes) + pass;
+	if (p->read_count < FRAME_GRAPH_PASS_RESOURCES)
+	{
+		p->reads[p->read_count++] = resource;
+	}
+}
+
+void write_frame_graph_pass(frame_graph *g, unsigned int pass, unsigned int resource)
+{
+	fg_pass *p = (fg_pass *)get_data_DA(g->passes) + pass;
+	if (p->write_count < FRAME_GRAPH_PASS_RESOURCES)
+	{
+		p->writes[p->write_count++] = resource;
+	}
+}
+
+unsigned char is_depth_format(GLenum internal_format)
+{
+	return internal_format == GL_DEPTH_COMPONENT16 || internal_format == GL_DEPTH_COMPONENT24 ||
+				 internal_format == GL_DEPTH_COMPONENT32F || internal_format == GL_DEPTH_COMPONENT32;
+}
+
+// format and type for glTexImage2D and an estimate of bytes per pixel, rgb8 is padded to 4 by most drivers
+void get_format_info(GLenum internal_format, GLenum *format, GLenum *type, unsigned int *bytes)
+{
+	switch (internal_format)
+	{
+	case GL_R8:
+		*format = GL_RED, *type = GL_UNSIGNED_BYTE, *bytes = 1;
+		break;
+	case GL_RG16:
+		*format = GL_RG, *type = GL_UNSIGNED_SHORT, *bytes = 4;
+		break;
+	case GL_RGB8:
+		*format = GL_RGB, *type = GL_UNSIGNED_BYTE, *bytes = 4;
+		break;
+	case GL_RGBA16F:
+		*format = GL_RGBA, *type = GL_FLOAT, *bytes = 8;
+		break;
+	default:
+		if (is_depth_format(internal_format))
+		{
+			*format = GL_DEPTH_COMPONENT, *type = GL_FLOAT, *bytes = 4;
+		}
+		else
+		{
+			*format = GL_RGBA, *type = GL_UNSIGNED_BYTE, *bytes = 4;
+		}
+		break;
+	}
+}
+
+unsigned char pass_uses(fg_pass *p, unsigned int resource, unsigned char write)
+{
+	unsigned int count = write ? p->write_count : p->read_count;
+	unsigned int *list = write ? p->writes : p->reads;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		if (list[i] == resource)
+		{
+			return 1;
+		}
+	}
+	return 0;
+}
+
+// going backwards, a pass is needed if it has side effects or writes something a needed pass reads.
+// every earlier writer of a wanted resource is needed too since they build it together
+void cull_frame_graph(frame_graph *g)
+{
+	unsigned int pass_number = get_size_DA(g->passes);
+	unsigned int resource_number = get_size_DA(g->resources);
+	fg_pass *passes = get_data_DA(g->passes);
+	unsigned char *wanted = calloc(resource_number + 1, 1);
+	for (int i = (int)pass_number - 1; i >= 0; i--)
+	{
+		fg_pass *p = passes + i;
+		unsigned char needed = p->side_effect;
+		for (unsigned int j = 0; j < p->write_count && !needed; j++)
+		{
+			needed = wanted[p->writes[j]];
+		}
+		p->culled = !needed;
+		for (unsigned int j = 0; j < p->read_count && needed; j++)
+		{
+			wanted[p->reads[j]] = 1;
+		}
+	}
+	free(wanted);
+}
+
+// pass b has to run after pass a: b reads what a writes, both write the same resource, or both have side effects.
+// in the last two cases declaration order decides
+unsigned char depends_on(fg_pass *a, unsigned int ai, fg_pass *b, unsigned int bi)
+{
+	if (ai < bi && a->side_effect && b->side_effect)
+	{
+		return 1;
+	}
+	for (unsigned int i = 0; i < a->write_count; i++)
+	{
+		unsigned int r = a->writes[i];
+		if (pass_uses(b, r, 1))
+		{
+			if (ai < bi)
+			{
+				return 1;
+			}
+		}
+		else if (pass_uses(b, r, 0))
+		{
+			return 1;
+		}
+	}
+	return 0;
+}
+
+// kahn with the lowest declared pass first when more than one is ready
+void sort_frame_graph(frame_graph *g)
+{
+	unsigned int pass_number = get_size_DA(g->passes);
+	fg_pass *passes = get_data_DA(g->passes);
+	unsigned int *incoming = calloc(pass_number + 1, sizeof(unsigned int));
+	unsigned char *done = calloc(pass_number + 1, 1);
+	for (unsigned int i = 0; i < pass_number; i++)
+	{
+		for (unsigned int j = 0; j < pass_number; j++)
+		{
+			if (i != j && !passes[i].culled && !passes[j].culled && depends_on(passes + i, i, passes + j, j))
+			{
+				incoming[j]++;
+			}
+		}
+	}
+	unsigned int live = 0;
+	for (unsigned int i = 0; i < pass_number; i++)
+	{
+		live += !passes[i].culled;
+	}
+	while (get_size_DA(g->order) < live)
+	{
+		unsigned int next = UINT_MAX;
+		for (unsigned int i = 0; i < pass_number && next == UINT_MAX; i++)
+		{
+			if (!passes[i].culled && !done[i] && incoming[i] == 0)
+			{
+				next = i;
+			}
+		}
+		if (next == UINT_MAX)
+		{
+			// a pass reads what it writes through another pass, rest runs as declared
+			fprintf(stderr, "frame graph has a cycle, passes run in declaration order\n");
+			for (unsigned int i = 0; i < pass_number; i++)
+			{
+				if (!passes[i].culled && !done[i])
+				{
+					done[i] = 1;
+					pushback_DA(g->order, &i);
+				}
+			}
+			break;
+		}
+		done[next] = 1;
+		pushback_DA(g->order, &next);
+		for (unsigned int j = 0; j < pass_number; j++)
+		{
+			if (!passes[j].culled && !done[j] && depends_on(passes + next, next, passes + j, j))
+			{
+				incoming[j]--;
+			}
+		}
+	}
+	free(incoming);
+	free(done);
+}
+
+fg_texture *acquire_texture(frame_graph *g, fg_resource *r)
+{
+	fg_texture *textures = get_data_DA(g->textures);
+	for (unsigned int i = 0; i < get_size_DA(g->textures); i++)
+	{
+		fg_texture *t = textures + i;
+		if (!t->in_use && t->internal_format == r->internal_format && t->width == r->width && t->height == r->height &&
+				t->filter == r->filter && t->wrap == r->wrap)
+		{
+			return t;
+		}
+	}
+	fg_texture t;
+	GLenum format, type;
+	unsigned int bytes;
+	get_format_info(r->internal_format, &format, &type, &bytes);
+	t.internal_format = r->internal_format;
+	t.width = r->width;
+	t.height = r->height;
+	t.filter = r->filter;
+	t.wrap = r->wrap;
+	t.bytes = (size_t)r->width * r->height * bytes;
+	t.in_use = 0;
+	t.used = 0;
+	glGenTextures(1, &t.texture);
+	bind_texture(GL_TEXTURE_2D, t.texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, r->internal_format, r->width, r->height, 0, format, type, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, r->filter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, r->filter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, r->wrap);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, r->wrap);
+	if (r->wrap == GL_CLAMP_TO_BORDER)
+	{
+		float border[] = {1.0f, 1.0f, 1.0f, 1.0f};
+		glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, border);
+	}
+	pushback_DA(g->textures, &t);
+	g->pool_bytes += t.bytes;
+	return (fg_texture *)get_data_DA(g->textures) + get_size_DA(g->textures) - 1;
+}
+
+fg_texture *find_texture(frame_graph *g, GLuint texture)
+{
+	fg_texture *textures = get_data_DA(g->textures);
+	for (unsigned int i = 0; i < get_size_DA(g->textures); i++)
+	{
+		if (textures[i].texture == texture)
+		{
+			return textures + i;
+		}
+	}
+	return 0;
+}
+
+// walks passes in order, a texture is taken at the first pass of a resource and given back after its last one
+void allocate_frame_graph(frame_graph *g)
+{
+	fg_resource *resources = get_data_DA(g->resources);
+	unsigned int resource_number = get_size_DA(g->resources);
+	fg_pass *passes = get_data_DA(g->passes);
+	unsigned int *order = get_data_DA(g->order);
+	unsigned int order_number = get_size_DA(g->order);
+	for (unsigned int i = 0; i < order_number; i++)
+	{
+		fg_pass *p = passes + order[i];
+		for (unsigned int j = 0; j < p->read_count + p->write_count; j++)
+		{
+			fg_resource *r = resources + (j < p->read_count ? p->reads[j] : p->writes[j - p->read_count]);
+			if (r->first_pass == -1)
+			{
+				r->first_pass = i;
+			}
+			r->last_pass = i;
+		}
+	}
+
+	fg_texture *textures = get_data_DA(g->textures);
+	for (unsigned int i = 0; i < get_size_DA(g->textures); i++)
+	{
+		textures[i].in_use = 0;
+		textures[i].used = 0;
+	}
+	size_t alive = 0;
+	g->peak_bytes = 0;
+	g->unaliased_bytes = 0;
+	for (unsigned int i = 0; i < order_number; i++)
+	{
+		for (unsigned int j = 0; j < resource_number; j++)
+		{
+			fg_resource *r = resources + j;
+			if (!r->imported && r->first_pass == (int)i)
+			{
+				fg_texture *t = acquire_texture(g, r);
+				t->in_use = 1;
+				t->used = 1;
+				r->texture = t->texture;
+				alive += t->bytes;
+				g->unaliased_bytes += t->bytes;
+			}
+		}
+		g->peak_bytes = alive > g->peak_bytes ? alive : g->peak_bytes;
+		for (unsigned int j = 0; j < resource_number; j++)
+		{
+			fg_resource *r = resources + j;
+			if (!r->imported && r->last_pass == (int)i)
+			{
+				fg_texture *t = find_texture(g, r->texture);
+				t->in_use = 0;
+				alive -= t->bytes;
+			}
+		}
+	}
+}
+
+// pool textures this frame did not need are deleted with the framebuffers they are attached to
+void trim_frame_graph(frame_graph *g)
+{
+	fg_texture *textures = get_data_DA(g->textures);
+	for (unsigned int i = get_size_DA(g->textures); i-- > 0;)
+	{
+		if (textures[i].used)
+		{
+			continue;
+		}
+		fg_framebuffer *framebuffers = get_data_DA(g->framebuffers);
+		for (unsigned int j = get_size_DA(g->framebuffers); j-- > 0;)
+		{
+			for (unsigned int k = 0; k < framebuffers[j].attachment_count; k++)
+			{
+				if (framebuffers[j].attachments[k] == textures[i].texture)
+				{
+					delete_framebuffers(1, &(framebuffers[j].framebuffer));
+					remove_DA(g->framebuffers, j);
+					break;
+				}
+			}
+		}
+		g->pool_bytes -= textures[i].bytes;
+		delete_textures(1, &(textures[i].texture));
+		remove_DA(g->textures, i);
+	}
+}
+
+GLuint get_pass_framebuffer(frame_graph *g, fg_pass *p)
+{
+	fg_resource *resources = get_data_DA(g->resources);
+	GLuint attachments[FRAME_GRAPH_PASS_RESOURCES];
+	unsigned int attachment_count = 0;
+	for (unsigned int i = 0; i < p->write_count; i++)
+	{
+		if (!resources[p->writes[i]].imported)
+		{
+			attachments[attachment_count++] = resources[p->writes[i]].texture;
+		}
+	}
+	if (attachment_count == 0)
+	{
+		return 0;
+	}
+	fg_framebuffer *framebuffers = get_data_DA(g->framebuffers);
+	for (unsigned int i = 0; i < get_size_DA(g->framebuffers); i++)
+	{
+		if (framebuffers[i].attachment_count == attachment_count &&
+				memcmp(framebuffers[i].attachments, attachments, sizeof(GLuint) * attachment_count) == 0)
+		{
+			return framebuffers[i].framebuffer;
+		}
+	}
+	fg_framebuffer f;
+	memcpy(f.attachments, attachments, sizeof(attachments));
+	f.attachment_count = attachment_count;
+	glGenFramebuffers(1, &f.framebuffer);
+	bind_framebuffer(GL_FRAMEBUFFER, f.framebuffer);
+	GLenum draw_buffers[FRAME_GRAPH_PASS_RESOURCES];
+	int color = 0;
+	for (unsigned int i = 0; i < p->write_count; i++)
+	{
+		fg_resource *r = resources + p->writes[i];
+		if (r->imported)
+		{
+			continue;
+		}
+		if (is_depth_format(r->internal_format))
+		{
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, r->texture, 0);
+		}
+		else
+		{
+			draw_buffers[color] = GL_COLOR_ATTACHMENT0 + color;
+			glFramebufferTexture2D(GL_FRAMEBUFFER, draw_buffers[color], GL_TEXTURE_2D, r->texture, 0);
+			color++;
+		}
+	}
+	if (color > 0)
+	{
+		glDrawBuffers(color, draw_buffers);
+	}
+	else
+	{
+		glDrawBuffer(GL_NONE);
+	}
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		fprintf(stderr, "frame graph pass %s has an incomplete framebuffer\n", p->name);
+	}
+	bind_framebuffer(GL_FRAMEBUFFER, 0);
+	pushback_DA(g->framebuffers, &f);
+	return f.framebuffer;
+}
+
+void compile_frame_graph(frame_graph *g)
+{
+	clear_DA(g->order);
+	cull_frame_graph(g);
+	sort_frame_graph(g);
+	allocate_frame_graph(g);
+	trim_frame_graph(g);
+	fg_pass *passes = get_data_DA(g->passes);
+	unsigned int *order = get_data_DA(g->order);
+	for (unsigned int i = 0; i < get_size_DA(g->order); i++)
+	{
+		passes[order[i]].framebuffer = get_pass_framebuffer(g, passes + order[i]);
+	}
+}
+
+void execute_frame_graph(frame_graph *g)
+{
+	fg_pass *passes = get_data_DA(g->passes);
+	unsigned int *order = get_data_DA(g->order);
+	for (unsigned int i = 0; i < get_size_DA(g->order); i++)
+	{
+		fg_pass *p = passes + order[i];
+		if (p->framebuffer != 0)
+		{
+			bind_framebuffer(GL_FRAMEBUFFER, p->framebuffer);
+		}
+		begin_gpu_pass(p->name);
+		p->execute(p->data);
+		end_gpu_pass();
+	}
+}
+
+GLuint get_frame_graph_texture(frame_graph *g, unsigned int resource)
+{
+	return ((fg_resource *)get_data_DA(g->resources))[resource].texture;
+}
+
+int get_frame_graph_text(frame_graph *g, char *text, int size)
+{
+	int length = snprintf(text, size, "Render targets: %u/%u passes, peak %.1lf MB (%.1lf MB unaliased, %.1lf MB pool)",
+												get_size_DA(g->order), get_size_DA(g->passes), g->peak_bytes / 1048576.0,
+												g->unaliased_bytes / 1048576.0, g->pool_bytes / 1048576.0);
+	return length < size ? length : size - 1;
+}
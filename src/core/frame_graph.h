@@ -0,0 +1,97 @@
+#pragma once
+#include "../../third_party/opengl/include/glad/glad.h"
+#include "dynamic.h"
+#include <stddef.h>
+
+#define FRAME_GRAPH_PASS_RESOURCES 8
+
+// render passes of a frame declared with the textures they read and write. every frame the graph is reset,
+// declared again and compiled: passes nothing needs are culled, the rest are sorted so reads come after writes,
+// and transient textures whose lifetimes dont overlap share one texture from the pool.
+// a transient texture may hold anything when its first pass starts, that pass has to clear it
+typedef void (*frame_graph_execute)(void *data);
+
+typedef struct fg_resource
+{
+	const char *name;
+	GLenum internal_format;
+	int width, height;
+	GLint filter, wrap;
+	unsigned char imported; // owned outside of the graph, never aliased or attached
+	GLuint texture;					// set by compile_frame_graph, 0 for transient textures of culled passes
+	int first_pass, last_pass; // lifetime as indices of order, -1 if unused
+} fg_resource;
+
+typedef struct fg_pass
+{
+	const char *name; // also the gpu timing pass name, has to outlive the graph
+	frame_graph_execute execute;
+	void *data;
+	unsigned int reads[FRAME_GRAPH_PASS_RESOURCES];
+	unsigned int writes[FRAME_GRAPH_PASS_RESOURCES]; // transient ones are attached in this order, depth formats to depth
+	unsigned int read_count, write_count;
+	unsigned char side_effect; // writes outside of the graph (window, output framebuffer), never culled
+	unsigned char culled;
+	GLuint framebuffer; // bound before execute, 0 if the pass writes no transient texture
+} fg_pass;
+
+// pool textures and framebuffers live across frames, ones a frame did not use are deleted
+typedef struct fg_texture
+{
+	GLuint texture;
+	GLenum internal_format;
+	int width, height;
+	GLint filter, wrap;
+	size_t bytes;
+	unsigned char in_use;
+	unsigned char used;
+} fg_texture;
+
+typedef struct fg_framebuffer
+{
+	GLuint attachments[FRAME_GRAPH_PASS_RESOURCES];
+	unsigned int attachment_count;
+	GLuint framebuffer;
+} fg_framebuffer;
+
+typedef struct frame_graph
+{
+	DA *resources;
+	DA *passes;
+	DA *order; // indices of passes that run
+	DA *textures;
+	DA *framebuffers;
+	size_t peak_bytes;			// most transient texture memory alive at one pass in the last compile
+	size_t unaliased_bytes; // what the same textures would take without sharing
+	size_t pool_bytes;
+} frame_graph;
+
+frame_graph *create_frame_graph(void);
+
+void delete_frame_graph(frame_graph *g);
+
+// drops passes and resources, pool is kept for the next declaration
+void reset_frame_graph(frame_graph *g);
+
+// wrap GL_CLAMP_TO_BORDER gets a white border. returns the resource index
+unsigned int create_frame_graph_texture(frame_graph *g, const char *name, GLenum internal_format, int width, int height,
+																				GLint filter, GLint wrap);
+
+unsigned int import_frame_graph_texture(frame_graph *g, const char *name, GLuint texture);
+
+unsigned int add_frame_graph_pass(frame_graph *g, const char *name, frame_graph_execute execute, void *data, unsigned char side_effect);
+
+void read_frame_graph_pass(frame_graph *g, unsigned int pass, unsigned int resource);
+
+// writing a resource more than once is fine, writers run in declaration order before every reader
+void write_frame_graph_pass(frame_graph *g, unsigned int pass, unsigned int resource);
+
+void compile_frame_graph(frame_graph *g);
+
+// runs passes in order, each inside a gpu timing pass of its name
+void execute_frame_graph(frame_graph *g);
+
+GLuint get_frame_graph_texture(frame_graph *g, unsigned int resource);
+
+// "Render targets: ..." line with pass counts and peak memory, returns written length
+int get_frame_graph_text(frame_graph *g, char *text, int size);
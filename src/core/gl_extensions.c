@@ -0,0 +1,69 @@
+#include "gl_extensions.h"
+#include <string.h>
+
+PFNGLMULTIDRAWELEMENTSINDIRECTPROC glad_glMultiDrawElementsIndirect = 0;
+PFNGLBUFFERSTORAGEPROC glad_glBufferStorage = 0;
+PFNGLGETPROGRAMBINARYPROC glad_glGetProgramBinary = 0;
+PFNGLPROGRAMBINARYPROC glad_glProgramBinary = 0;
+PFNGLPROGRAMPARAMETERIPROC glad_glProgramParameteri = 0;
+PFNGLMAXSHADERCOMPILERTHREADSKHRPROC glad_glMaxShaderCompilerThreadsKHR = 0;
+
+unsigned char has_multi_draw_indirect = 0;
+unsigned char has_buffer_storage = 0;
+unsigned char has_program_binary = 0;
+unsigned char has_parallel_shader_compile = 0;
+
+unsigned char has_gl_version(int major, int minor)
+{
+	GLint gl_major = 0, gl_minor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &gl_major);
+	glGetIntegerv(GL_MINOR_VERSION, &gl_minor);
+	return gl_major > major || (gl_major == major && gl_minor >= minor);
+}
+
+unsigned char has_gl_extension(const char *name)
+{
+	GLint count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+	for (GLint i = 0; i < count; i++)
+	{
+		const char *ext = (const char *)glGetStringi(GL_EXTENSIONS, i);
+		if (ext != 0 && strcmp(ext, name) == 0)
+		{
+			return 1;
+		}
+	}
+	return 0;
+}
+
+void load_gl_extensions(GLADloadproc load)
+{
+	if (has_gl_version(4, 3) || (has_gl_extension("GL_ARB_multi_draw_indirect") && has_gl_extension("GL_ARB_base_instance")))
+	{
+		glad_glMultiDrawElementsIndirect = (PFNGLMULTIDRAWELEMENTSINDIRECTPROC)load("glMultiDrawElementsIndirect");
+	}
+	has_multi_draw_indirect = glad_glMultiDrawElementsIndirect != 0;
+	if (has_gl_version(4, 4) || has_gl_extension("GL_ARB_buffer_storage"))
+	{
+		glad_glBufferStorage = (PFNGLBUFFERSTORAGEPROC)load("glBufferStorage");
+	}
+	has_buffer_storage = glad_glBufferStorage != 0;
+	if (has_gl_version(4, 1) || has_gl_extension("GL_ARB_get_program_binary"))
+	{
+		glad_glGetProgramBinary = (PFNGLGETPROGRAMBINARYPROC)load("glGetProgramBinary");
+		glad_glProgramBinary = (PFNGLPROGRAMBINARYPROC)load("glProgramBinary");
+		glad_glProgramParameteri = (PFNGLPROGRAMPARAMETERIPROC)load("glProgramParameteri");
+	}
+	// drivers may support the extension with no binary format, then nothing can be cached
+	GLint formats = 0;
+	if (glad_glGetProgramBinary != 0 && glad_glProgramBinary != 0 && glad_glProgramParameteri != 0)
+	{
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	}
+	has_program_binary = formats > 0;
+	if (has_gl_extension("GL_KHR_parallel_shader_compile"))
+	{
+		glad_glMaxShaderCompilerThreadsKHR = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)load("glMaxShaderCompilerThreadsKHR");
+	}
+	has_parallel_shader_compile = glad_glMaxShaderCompilerThreadsKHR != 0;
+}
\ No newline at end of file
@@ -0,0 +1,337 @@
+#include "gl_state.h"
+
+#define STATE_UNKNOWN 0xffffffff
+#define STATE_TEXTURE_UNITS 32
+#define STATE_TEXTURE_TARGETS 4
+#define STATE_BUFFER_TARGETS 6
+#define STATE_UNIFORM_BINDINGS 16
+
+GLuint state_program = STATE_UNKNOWN;
+GLuint state_vertex_array = STATE_UNKNOWN;
+GLuint state_buffers[STATE_BUFFER_TARGETS];
+GLuint state_uniform_bindings[STATE_UNIFORM_BINDINGS];
+GLenum state_unit = STATE_UNKNOWN;
+GLuint state_textures[STATE_TEXTURE_UNITS][STATE_TEXTURE_TARGETS];
+GLuint state_draw_framebuffer = STATE_UNKNOWN;
+GLuint state_read_framebuffer = STATE_UNKNOWN;
+GLint state_viewport[4] = {-1, -1, -1, -1};
+GLenum state_cull_face = STATE_UNKNOWN;
+GLenum state_polygon_mode = STATE_UNKNOWN;
+
+unsigned int saved_calls = 0;
+unsigned int last_saved_calls = 0;
+
+void reset_gl_state(void)
+{
+	state_program = STATE_UNKNOWN;
+	state_vertex_array = STATE_UNKNOWN;
+	for (int i = 0; i < STATE_BUFFER_TARGETS; i++)
+	{
+		state_buffers[i] = STATE_UNKNOWN;
+	}
+	for (int i = 0; i < STATE_UNIFORM_BINDINGS; i++)
+	{
+		state_uniform_bindings[i] = STATE_UNKNOWN;
+	}
+	state_unit = STATE_UNKNOWN;
+	for (int i = 0; i < STATE_TEXTURE_UNITS; i++)
+	{
+		for (int j = 0; j < STATE_TEXTURE_TARGETS; j++)
+		{
+			state_textures[i][j] = STATE_UNKNOWN;
+		}
+	}
+	state_draw_framebuffer = STATE_UNKNOWN;
+	state_read_framebuffer = STATE_UNKNOWN;
+	for (int i = 0; i < 4; i++)
+	{
+		state_viewport[i] = -1;
+	}
+	state_cull_face = STATE_UNKNOWN;
+	state_polygon_mode = STATE_UNKNOWN;
+}
+
+void next_frame_gl_state(void)
+{
+	last_saved_calls = saved_calls;
+	saved_calls = 0;
+}
+
+unsigned int get_saved_gl_calls(void)
+{
+	return last_saved_calls;
+}
+
+// returns -1 for targets that are not cached, they are always passed to gl
+int get_buffer_slot(GLenum target)
+{
+	switch (target)
+	{
+	case GL_ARRAY_BUFFER:
+		return 0;
+	case GL_ELEMENT_ARRAY_BUFFER:
+		return 1;
+	case GL_UNIFORM_BUFFER:
+		return 2;
+	case GL_COPY_READ_BUFFER:
+		return 3;
+	case GL_COPY_WRITE_BUFFER:
+		return 4;
+	case GL_DRAW_INDIRECT_BUFFER:
+		return 5;
+	default:
+		return -1;
+	}
+}
+
+int get_texture_slot(GLenum target)
+{
+	switch (target)
+	{
+	case GL_TEXTURE_2D:
+		return 0;
+	case GL_TEXTURE_2D_ARRAY:
+		return 1;
+	case GL_TEXTURE_CUBE_MAP:
+		return 2;
+	case GL_TEXTURE_BUFFER:
+		return 3;
+	default:
+		return -1;
+	}
+}
+
+void use_program(GLuint program)
+{
+	if (state_program == program)
+	{
+		saved_calls++;
+		return;
+	}
+	glUseProgram(program);
+	state_program = program;
+}
+
+void bind_vertex_array(GLuint array)
+{
+	if (state_vertex_array == array)
+	{
+		saved_calls++;
+		return;
+	}
+	glBindVertexArray(array);
+	state_vertex_array = array;
+	state_buffers[1] = STATE_UNKNOWN;
+}
+
+void bind_buffer(GLenum target, GLuint buffer)
+{
+	int slot = get_buffer_slot(target);
+	if (slot != -1 && state_buffers[slot] == buffer)
+	{
+		saved_calls++;
+		return;
+	}
+	glBindBuffer(target, buffer);
+	if (slot != -1)
+	{
+		state_buffers[slot] = buffer;
+	}
+}
+
+void bind_buffer_base(GLenum target, GLuint index, GLuint buffer)
+{
+	if (target == GL_UNIFORM_BUFFER && index < STATE_UNIFORM_BINDINGS && state_uniform_bindings[index] == buffer)
+	{
+		saved_calls++;
+		return;
+	}
+	glBindBufferBase(target, index, buffer);
+	if (target == GL_UNIFORM_BUFFER && index < STATE_UNIFORM_BINDINGS)
+	{
+		state_uniform_bindings[index] = buffer;
+	}
+	// indexed binding also binds the generic target
+	int slot = get_buffer_slot(target);
+	if (slot != -1)
+	{
+		state_buffers[slot] = buffer;
+	}
+}
+
+void active_texture(GLenum unit)
+{
+	if (state_unit == unit)
+	{
+		saved_calls++;
+		return;
+	}
+	glActiveTexture(unit);
+	state_unit = unit;
+}
+
+void bind_texture(GLenum target, GLuint texture)
+{
+	int slot = get_texture_slot(target);
+	unsigned int unit = state_unit - GL_TEXTURE0;
+	if (state_unit == STATE_UNKNOWN || unit >= STATE_TEXTURE_UNITS || slot == -1)
+	{
+		glBindTexture(target, texture);
+		return;
+	}
+	if (state_textures[unit][slot] == texture)
+	{
+		saved_calls++;
+		return;
+	}
+	glBindTexture(target, texture);
+	state_textures[unit][slot] = texture;
+}
+
+void bind_framebuffer(GLenum target, GLuint framebuffer)
+{
+	unsigned char draw = target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER;
+	unsigned char read = target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER;
+	if ((!draw || state_draw_framebuffer == framebuffer) && (!read || state_read_framebuffer == framebuffer))
+	{
+		saved_calls++;
+		return;
+	}
+	glBindFramebuffer(target, framebuffer);
+	if (draw)
+	{
+		state_draw_framebuffer = framebuffer;
+	}
+	if (read)
+	{
+		state_read_framebuffer = framebuffer;
+	}
+}
+
+void set_viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+	if (state_viewport[0] == x && state_viewport[1] == y && state_viewport[2] == width && state_viewport[3] == height)
+	{
+		saved_calls++;
+		return;
+	}
+	glViewport(x, y, width, height);
+	state_viewport[0] = x;
+	state_viewport[1] = y;
+	state_viewport[2] = width;
+	state_viewport[3] = height;
+}
+
+void set_cull_face(GLenum mode)
+{
+	if (state_cull_face == mode)
+	{
+		saved_calls++;
+		return;
+	}
+	glCullFace(mode);
+	state_cull_face = mode;
+}
+
+// core profile only has GL_FRONT_AND_BACK so one mode is cached
+void set_polygon_mode(GLenum face, GLenum mode)
+{
+	if (face == GL_FRONT_AND_BACK && state_polygon_mode == mode)
+	{
+		saved_calls++;
+		return;
+	}
+	glPolygonMode(face, mode);
+	state_polygon_mode = face == GL_FRONT_AND_BACK ? mode : STATE_UNKNOWN;
+}
+
+void delete_program(GLuint program)
+{
+	// a deleted program stays in use until another one is used, its name may come back from glCreateProgram
+	if (program != 0 && state_program == program)
+	{
+		state_program = STATE_UNKNOWN;
+	}
+	glDeleteProgram(program);
+}
+
+void delete_vertex_arrays(GLsizei n, const GLuint *arrays)
+{
+	for (GLsizei i = 0; i < n; i++)
+	{
+		if (arrays[i] != 0 && state_vertex_array == arrays[i])
+		{
+			state_vertex_array = 0;
+			state_buffers[1] = STATE_UNKNOWN;
+		}
+	}
+	glDeleteVertexArrays(n, arrays);
+}
+
+void delete_buffers(GLsizei n, const GLuint *buffers)
+{
+	for (GLsizei i = 0; i < n; i++)
+	{
+		if (buffers[i] == 0)
+		{
+			continue;
+		}
+		for (int j = 0; j < STATE_BUFFER_TARGETS; j++)
+		{
+			if (state_buffers[j] == buffers[i])
+			{
+				state_buffers[j] = 0;
+			}
+		}
+		for (int j = 0; j < STATE_UNIFORM_BINDINGS; j++)
+		{
+			if (state_uniform_bindings[j] == buffers[i])
+			{
+				state_uniform_bindings[j] = 0;
+			}
+		}
+	}
+	glDeleteBuffers(n, buffers);
+}
+
+void delete_textures(GLsizei n, const GLuint *textures)
+{
+	for (GLsizei i = 0; i < n; i++)
+	{
+		if (textures[i] == 0)
+		{
+			continue;
+		}
+		for (int j = 0; j < STATE_TEXTURE_UNITS; j++)
+		{
+			for (int k = 0; k < STATE_TEXTURE_TARGETS; k++)
+			{
+				if (state_textures[j][k] == textures[i])
+				{
+					state_textures[j][k] = 0;
+				}
+			}
+		}
+	}
+	glDeleteTextures(n, textures);
+}
+
+void delete_framebuffers(GLsizei n, const GLuint *framebuffers)
+{
+	for (GLsizei i = 0; i < n; i++)
+	{
+		if (framebuffers[i] == 0)
+		{
+			continue;
+		}
+		if (state_draw_framebuffer == framebuffers[i])
+		{
+			state_draw_framebuffer = 0;
+		}
+		if (state_read_framebuffer == framebuffers[i])
+		{
+			state_read_framebuffer = 0;
+		}
+	}
+	glDeleteFramebuffers(n, framebuffers);
+}
\ No newline at end of file
@@ -0,0 +1,45 @@
+#pragma once
+#include "../../third_party/opengl/include/glad/glad.h"
+
+// thin cache over gl binding state. modules bind through these instead of calling gl directly,
+// calls that would not change the bound state are skipped and counted.
+// the cache is for one context, call reset_gl_state after a context becomes current on a thread
+
+void reset_gl_state(void);
+
+// call once at the start of a frame, saved calls of the frame before are kept for get_saved_gl_calls
+void next_frame_gl_state(void);
+
+unsigned int get_saved_gl_calls(void);
+
+void use_program(GLuint program);
+
+// element array buffer belongs to the vertex array so its cache is dropped here
+void bind_vertex_array(GLuint array);
+
+void bind_buffer(GLenum target, GLuint buffer);
+
+void bind_buffer_base(GLenum target, GLuint index, GLuint buffer);
+
+void active_texture(GLenum unit);
+
+void bind_texture(GLenum target, GLuint texture);
+
+void bind_framebuffer(GLenum target, GLuint framebuffer);
+
+void set_viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+
+void set_cull_face(GLenum mode);
+
+void set_polygon_mode(GLenum face, GLenum mode);
+
+// deleting unbinds objects in gl, these keep the cache in sync
+void delete_program(GLuint program);
+
+void delete_vertex_arrays(GLsizei n, const GLuint *arrays);
+
+void delete_buffers(GLsizei n, const GLuint *buffers);
+
+void delete_textures(GLsizei n, const GLuint *textures);
+
+void delete_framebuffers(GLsizei n, const GLuint *framebuffers);
\ No newline at end of file
@@ -0,0 +1,307 @@
+#include "glyph_atlas.h"
+#include "gl_state.h"
+#include "../../third_party/freetype/include/ft2build.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include FT_FREETYPE_H
+
+#define GLYPH_PADDING 1
+
+glyph_atlas *create_glyph_atlas(const char *font_file, int width, int height, unsigned char sdf)
+{
+  FT_Library ft;
+  if (FT_Init_FreeType(&ft))
+  {
+    fprintf(stderr, "FT_Init_FreeType Error\n");
+    return 0;
+  }
+  FT_Face face;
+  if (FT_New_Face(ft, font_file, 0, &face))
+  {
+    fprintf(stderr, "FT_New_Face Error: %s\n", font_file);
+    FT_Done_FreeType(ft);
+    return 0;
+  }
+
+  glyph_atlas *a = malloc(sizeof(glyph_atlas));
+  a->library = ft;
+  a->face = face;
+  a->face_size = 0;
+  a->width = width;
+  a->height = height;
+  a->sdf = sdf;
+  a->glyphs = create_DA(sizeof(glyph), 0);
+  a->shelves = create_DA(sizeof(glyph_shelf), 0);
+  a->table_size = 256;
+  a->table = calloc(a->table_size, sizeof(unsigned int));
+  a->stamp = 1;
+  a->generation = 0;
+
+  // glyphs are added one by one so there are no mipmaps, sdf glyphs dont need them
+  unsigned char *empty = calloc((size_t)width * height, 1);
+  glGenTextures(1, &a->texture);
+  active_texture(GL_TEXTURE31);
+  bind_texture(GL_TEXTURE_2D, a->texture);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, width, height, 0, GL_RED, GL_UNSIGNED_BYTE, empty);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  free(empty);
+  return a;
+}
+
+void delete_glyph_atlas(glyph_atlas *a)
+{
+  if (a == 0)
+  {
+    return;
+  }
+  FT_Done_Face((FT_Face)a->face);
+  FT_Done_FreeType((FT_Library)a->library);
+  delete_textures(1, &(a->texture));
+  delete_DA(a->glyphs);
+  delete_DA(a->shelves);
+  free(a->table);
+  free(a);
+}
+
+void stamp_glyph_atlas(glyph_atlas *a)
+{
+  a->stamp++;
+}
+
+unsigned int hash_glyph(unsigned int codepoint, int size)
+{
+  return codepoint * 2654435761u ^ (unsigned int)size * 40503u;
+}
+
+void grow_glyph_table(glyph_atlas *a)
+{
+  free(a->table);
+  a->table_size *= 2;
+  a->table = calloc(a->table_size, sizeof(unsigned int));
+  glyph *glyphs = get_data_DA(a->glyphs);
+  for (unsigned int i = 0; i < get_size_DA(a->glyphs); i++)
+  {
+    unsigned int slot = hash_glyph(glyphs[i].codepoint, glyphs[i].size) & (a->table_size - 1);
+    while (a->table[slot] != 0)
+    {
+      slot = (slot + 1) & (a->table_size - 1);
+    }
+    a->table[slot] = i + 1;
+  }
+}
+
+void set_glyph_face_size(glyph_atlas *a, int size)
+{
+  if (a->face_size != size)
+  {
+    FT_Set_Pixel_Sizes((FT_Face)a->face, 0, size);
+    a->face_size = size;
+  }
+}
+
+// empties the least recently used shelf that is tall enough, returns UINT_MAX if every such shelf is in use
+unsigned int evict_glyph_shelf(glyph_atlas *a, int height)
+{
+  glyph_shelf *shelves = get_data_DA(a->shelves);
+  unsigned int oldest = UINT_MAX;
+  for (unsigned int i = 0; i < get_size_DA(a->shelves); i++)
+  {
+    if (shelves[i].height >= height && shelves[i].last_used != a->stamp &&
+        (oldest == UINT_MAX || a->stamp - shelves[i].last_used > a->stamp - shelves[oldest].last_used))
+    {
+      oldest = i;
+    }
+  }
+  if (oldest == UINT_MAX)
+  {
+    return UINT_MAX;
+  }
+  glyph *glyphs = get_data_DA(a->glyphs);
+  for (unsigned int i = 0; i < get_size_DA(a->glyphs); i++)
+  {
+    if (glyphs[i].shelf == oldest)
+    {
+      glyphs[i].shelf = UINT_MAX;
+    }
+  }
+  // old glyphs would bleed into the padding of new ones
+  unsigned char *empty = calloc((size_t)a->width * shelves[oldest].height, 1);
+  active_texture(GL_TEXTURE31);
+  bind_texture(GL_TEXTURE_2D, a->texture);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, shelves[oldest].y, a->width, shelves[oldest].height, GL_RED, GL_UNSIGNED_BYTE, empty);
+  free(empty);
+  shelves[oldest].x = 0;
+  a->generation++;
+  return oldest;
+}
+
+// finds room for width x height, shelves that are much taller than the glyph are skipped so small glyphs dont waste them
+unsigned int find_glyph_shelf(glyph_atlas *a, int width, int height)
+{
+  if (width > a->width || height > a->height)
+  {
+    return UINT_MAX;
+  }
+  glyph_shelf *shelves = get_data_DA(a->shelves);
+  unsigned int shelf_number = get_size_DA(a->shelves);
+  for (unsigned int i = 0; i < shelf_number; i++)
+  {
+    if (shelves[i].height >= height && shelves[i].height <= height + height / 4 + 2 && shelves[i].x + width <= a->width)
+    {
+      return i;
+    }
+  }
+  int bottom = shelf_number == 0 ? 0 : shelves[shelf_number - 1].y + shelves[shelf_number - 1].height;
+  if (bottom + height <= a->height)
+  {
+    glyph_shelf shelf = {bottom, height, 0, a->stamp};
+    pushback_DA(a->shelves, &shelf);
+    return shelf_number;
+  }
+  return evict_glyph_shelf(a, height);
+}
+
+// renders the glyph again and gives it a place, metrics dont change between renders
+void place_glyph(glyph_atlas *a, glyph *g)
+{
+  FT_Face face = (FT_Face)a->face;
+  set_glyph_face_size(a, a->sdf ? GLYPH_ATLAS_SDF_SIZE : g->size);
+  if (FT_Load_Char(face, g->codepoint, FT_LOAD_DEFAULT) ||
+      FT_Render_Glyph(face->glyph, a->sdf ? FT_RENDER_MODE_SDF : FT_RENDER_MODE_NORMAL))
+  {
+    g->width = 0;
+    g->height = 0;
+    return;
+  }
+  FT_Bitmap *bitmap = &face->glyph->bitmap;
+  g->width = bitmap->width;
+  g->height = bitmap->rows;
+  g->bearingx = (float)face->glyph->bitmap_left;
+  g->bearingy = (float)face->glyph->bitmap_top;
+  g->advancex = face->glyph->advance.x / 64.0f;
+  if (g->width == 0 || g->height == 0)
+  {
+    return;
+  }
+  unsigned int shelf = find_glyph_shelf(a, g->width + GLYPH_PADDING, g->height + GLYPH_PADDING);
+  if (shelf == UINT_MAX)
+  {
+    return;
+  }
+  glyph_shelf *s = (glyph_shelf *)get_data_DA(a->shelves) + shelf;
+  g->x = s->x;
+  g->y = s->y;
+  g->shelf = shelf;
+  s->x += g->width + GLYPH_PADDING;
+  s->last_used = a->stamp;
+
+  active_texture(GL_TEXTURE31);
+  bind_texture(GL_TEXTURE_2D, a->texture);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glPixelStorei(GL_UNPACK_ROW_LENGTH, bitmap->pitch);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, g->x, g->y, g->width, g->height, GL_RED, GL_UNSIGNED_BYTE, bitmap->buffer);
+  glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+}
+
+glyph *get_glyph(glyph_atlas *a, unsigned int codepoint, int size)
+{
+  if (a->sdf)
+  {
+    size = 0;
+  }
+  unsigned int slot = hash_glyph(codepoint, size) & (a->table_size - 1);
+  while (a->table[slot] != 0)
+  {
+    glyph *g = (glyph *)get_data_DA(a->glyphs) + a->table[slot] - 1;
+    if (g->codepoint == codepoint && g->size == size)
+    {
+      if (g->shelf != UINT_MAX)
+      {
+        ((glyph_shelf *)get_data_DA(a->shelves))[g->shelf].last_used = a->stamp;
+      }
+      else if (g->width != 0 && g->height != 0)
+      {
+        // evicted or the atlas was full last time
+        place_glyph(a, g);
+      }
+      return g;
+    }
+    slot = (slot + 1) & (a->table_size - 1);
+  }
+
+  glyph g;
+  g.codepoint = codepoint;
+  g.size = size;
+  g.x = 0;
+  g.y = 0;
+  g.shelf = UINT_MAX;
+  place_glyph(a, &g);
+  pushback_DA(a->glyphs, &g);
+  unsigned int glyph_number = get_size_DA(a->glyphs);
+  a->table[slot] = glyph_number;
+  if (glyph_number * 2 > a->table_size)
+  {
+    grow_glyph_table(a);
+  }
+  return (glyph *)get_data_DA(a->glyphs) + glyph_number - 1;
+}
+
+float get_glyph_scale(glyph_atlas *a, int size)
+{
+  return a->sdf ? (float)size / GLYPH_ATLAS_SDF_SIZE : 1.0f;
+}
+
+float get_glyph_line_height(glyph_atlas *a, int size)
+{
+  set_glyph_face_size(a, a->sdf ? GLYPH_ATLAS_SDF_SIZE : size);
+  return ((FT_Face)a->face)->size->metrics.height / 64.0f * get_glyph_scale(a, size);
+}
+
+unsigned int decode_utf8(const char **text)
+{
+  const unsigned char *c = (const unsigned char *)*text;
+  unsigned int codepoint;
+  int length;
+  if (c[0] < 0x80)
+  {
+    codepoint = c[0];
+    length = 1;
+  }
+  else if ((c[0] & 0xe0) == 0xc0)
+  {
+    codepoint = c[0] & 0x1f;
+    length = 2;
+  }
+  else if ((c[0] & 0xf0) == 0xe0)
+  {
+    codepoint = c[0] & 0x0f;
+    length = 3;
+  }
+  else if ((c[0] & 0xf8) == 0xf0)
+  {
+    codepoint = c[0] & 0x07;
+    length = 4;
+  }
+  else
+  {
+    *text += 1;
+    return 0xfffd;
+  }
+  for (int i = 1; i < length; i++)
+  {
+    // also stops at the terminating 0
+    if ((c[i] & 0xc0) != 0x80)
+    {
+      *text += i;
+      return 0xfffd;
+    }
+    codepoint = (codepoint << 6) | (c[i] & 0x3f);
+  }
+  *text += length;
+  return codepoint;
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include "../../third_party/opengl/include/glad/glad.h"
+#include "dynamic.h"
+
+#define GLYPH_ATLAS_SDF_SIZE 48 // sdf glyphs are rendered once at this pixel size and scaled to every size
+
+// one GL_R8 texture shared by every text manager of a font. glyphs are rendered with freetype the first time
+// they are used and packed into shelves (rows with one height). when no shelf has room the least recently used
+// shelf is emptied, then generation changes and text managers lay out their texts again
+typedef struct glyph
+{
+  unsigned int codepoint;
+  int size;                           // pixel size, 0 for sdf glyphs
+  int x, y, width, height;            // place in the atlas
+  float bearingx, bearingy, advancex; // pixels at size, sdf glyphs at GLYPH_ATLAS_SDF_SIZE
+  unsigned int shelf;                 // UINT_MAX if the glyph has no place yet
+} glyph;
+
+typedef struct glyph_shelf
+{
+  int y, height;
+  int x; // next free pixel
+  unsigned int last_used;
+} glyph_shelf;
+
+typedef struct glyph_atlas
+{
+  void *library, *face; // FT_Library, FT_Face
+  int face_size;        // current pixel size of face
+  GLuint texture;
+  int width, height;
+  unsigned char sdf;
+  DA *glyphs;
+  DA *shelves;
+  unsigned int *table; // glyph index + 1 by codepoint and size, 0 is empty
+  unsigned int table_size;
+  unsigned int stamp;      // shelves used with the current stamp are not evicted
+  unsigned int generation; // changes when glyphs are evicted
+} glyph_atlas;
+
+// returns 0 if the font cant be loaded. sdf atlases serve every size from one glyph
+glyph_atlas *create_glyph_atlas(const char *font_file, int width, int height, unsigned char sdf);
+
+void delete_glyph_atlas(glyph_atlas *a);
+
+// starts a new use, glyphs found after this are kept until the next stamp
+void stamp_glyph_atlas(glyph_atlas *a);
+
+// renders the glyph if needed. the returned glyph is valid until the next lookup,
+// its shelf is UINT_MAX when the atlas is full of glyphs used with the current stamp
+glyph *get_glyph(glyph_atlas *a, unsigned int codepoint, int size);
+
+// glyph metrics are multiplied with this to get pixels at size
+float get_glyph_scale(glyph_atlas *a, int size);
+
+float get_glyph_line_height(glyph_atlas *a, int size);
+
+// reads one utf-8 codepoint and moves text after it, broken sequences are U+FFFD
+unsigned int decode_utf8(const char **text);
@@ -0,0 +1,225 @@
+#include "gpu_timing.h"
+#include <stdio.h>
+#include <string.h>
+
+typedef struct gpu_pass
+{
+	const char *name;
+	GLuint queries[GPU_TIMING_BUFFERS];
+	unsigned char issued[GPU_TIMING_BUFFERS];
+	unsigned long long issued_frame[GPU_TIMING_BUFFERS];
+	double last_ms;
+	double average_ms;
+} gpu_pass;
+
+gpu_pass gpu_passes[GPU_TIMING_PASSES];
+int gpu_pass_count = 0;
+int gpu_current_pass = -1;
+unsigned long long gpu_frame = 0;
+unsigned char has_timer_query = 0;
+FILE *gpu_csv = 0;
+// the frame that is waited for is max_frames before the newest one, so there is one fence more
+GLsync frame_fences[GPU_THROTTLE_FRAMES + 1];
+unsigned long long fenced_frames = 0;
+
+void init_gpu_timing(void)
+{
+	// drivers may have no timer, then every pass stays at 0
+	GLint bits = 0;
+	glGetQueryiv(GL_TIME_ELAPSED, GL_QUERY_COUNTER_BITS, &bits);
+	has_timer_query = bits > 0;
+	gpu_pass_count = 0;
+	gpu_current_pass = -1;
+	gpu_frame = 0;
+}
+
+void delete_gpu_timing(void)
+{
+	for (int i = 0; i < gpu_pass_count; i++)
+	{
+		glDeleteQueries(GPU_TIMING_BUFFERS, gpu_passes[i].queries);
+	}
+	gpu_pass_count = 0;
+	stop_gpu_timing_csv();
+	for (int i = 0; i <= GPU_THROTTLE_FRAMES; i++)
+	{
+		if (frame_fences[i] != 0)
+		{
+			glDeleteSync(frame_fences[i]);
+			frame_fences[i] = 0;
+		}
+	}
+	fenced_frames = 0;
+}
+
+void read_gpu_pass(gpu_pass *p, unsigned int buffer)
+{
+	p->issued[buffer] = 0;
+	GLuint64 ns = 0;
+	glGetQueryObjectui64v(p->queries[buffer], GL_QUERY_RESULT, &ns);
+	p->last_ms = ns / 1000000.0;
+	p->average_ms = p->average_ms == 0 ? p->last_ms : p->average_ms * 0.95 + p->last_ms * 0.05;
+	if (gpu_csv != 0)
+	{
+		fprintf(gpu_csv, "%llu,%s,%.4f\n", p->issued_frame[buffer], p->name, p->last_ms);
+	}
+}
+
+void next_frame_gpu_timing(void)
+{
+	gpu_frame++;
+	unsigned int reused = gpu_frame % GPU_TIMING_BUFFERS;
+	for (int i = 0; i < gpu_pass_count; i++)
+	{
+		gpu_pass *p = &gpu_passes[i];
+		// oldest buffer first, queries finish in order so the first one that is not ready stops it
+		for (unsigned int k = 0; k < GPU_TIMING_BUFFERS; k++)
+		{
+			unsigned int buffer = (gpu_frame + k) % GPU_TIMING_BUFFERS;
+			if (!p->issued[buffer])
+			{
+				continue;
+			}
+			GLint available = 0;
+			glGetQueryObjectiv(p->queries[buffer], GL_QUERY_RESULT_AVAILABLE, &available);
+			// the reused buffer is issued again this frame, its result is waited for instead of lost
+			if (!available && buffer != reused)
+			{
+				break;
+			}
+			read_gpu_pass(p, buffer);
+		}
+	}
+}
+
+int find_gpu_pass(const char *name)
+{
+	for (int i = 0; i < gpu_pass_count; i++)
+	{
+		if (gpu_passes[i].name == name || strcmp(gpu_passes[i].name, name) == 0)
+		{
+			return i;
+		}
+	}
+	return -1;
+}
+
+void begin_gpu_pass(const char *name)
+{
+	if (!has_timer_query || gpu_current_pass != -1)
+	{
+		return;
+	}
+	int i = find_gpu_pass(name);
+	if (i == -1)
+	{
+		if (gpu_pass_count == GPU_TIMING_PASSES)
+		{
+			return;
+		}
+		i = gpu_pass_count++;
+		memset(&gpu_passes[i], 0, sizeof(gpu_pass));
+		gpu_passes[i].name = name;
+		glGenQueries(GPU_TIMING_BUFFERS, gpu_passes[i].queries);
+	}
+	unsigned int buffer = gpu_frame % GPU_TIMING_BUFFERS;
+	glBeginQuery(GL_TIME_ELAPSED, gpu_passes[i].queries[buffer]);
+	gpu_passes[i].issued[buffer] = 1;
+	gpu_passes[i].issued_frame[buffer] = gpu_frame;
+	gpu_current_pass = i;
+}
+
+void end_gpu_pass(void)
+{
+	if (gpu_current_pass == -1)
+	{
+		return;
+	}
+	glEndQuery(GL_TIME_ELAPSED);
+	gpu_current_pass = -1;
+}
+
+double get_gpu_pass_timems(const char *name)
+{
+	int i = find_gpu_pass(name);
+	return i == -1 ? 0 : gpu_passes[i].average_ms;
+}
+
+int get_gpu_timing_text(char *text, int size)
+{
+	int length = 0;
+	text[0] = 0;
+	double total = 0;
+	for (int i = 0; i < gpu_pass_count && length < size; i++)
+	{
+		length += snprintf(text + length, size - length, "GPU %s: %.2lf ms\n", gpu_passes[i].name, gpu_passes[i].average_ms);
+		total += gpu_passes[i].average_ms;
+	}
+	if (length < size)
+	{
+		length += snprintf(text + length, size - length, "GPU total: %.2lf ms", total);
+	}
+	return length < size ? length : size - 1;
+}
+
+unsigned char start_gpu_timing_csv(const char *path)
+{
+	stop_gpu_timing_csv();
+	gpu_csv = fopen(path, "w");
+	if (gpu_csv == 0)
+	{
+		return 0;
+	}
+	fprintf(gpu_csv, "frame,pass,gpu_ms\n");
+	return 1;
+}
+
+void stop_gpu_timing_csv(void)
+{
+	if (gpu_csv != 0)
+	{
+		fclose(gpu_csv);
+		gpu_csv = 0;
+	}
+}
+
+unsigned char is_gpu_timing_csv(void)
+{
+	return gpu_csv != 0;
+}
+
+void throttle_gpu_frames(unsigned int max_frames)
+{
+	unsigned int slot = fenced_frames % (GPU_THROTTLE_FRAMES + 1);
+	if (frame_fences[slot] != 0)
+	{
+		glDeleteSync(frame_fences[slot]);
+	}
+	frame_fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	fenced_frames++;
+	if (max_frames == 0)
+	{
+		return;
+	}
+	if (max_frames > GPU_THROTTLE_FRAMES)
+	{
+		max_frames = GPU_THROTTLE_FRAMES;
+	}
+	// newest frame is fenced_frames - 1, the one max_frames before it has to be done so at most max_frames stay queued
+	if (fenced_frames < max_frames + 1)
+	{
+		return;
+	}
+	slot = (fenced_frames - 1 - max_frames) % (GPU_THROTTLE_FRAMES + 1);
+	if (frame_fences[slot] == 0)
+	{
+		return;
+	}
+	GLenum result = glClientWaitSync(frame_fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+	while (result == GL_TIMEOUT_EXPIRED)
+	{
+		result = glClientWaitSync(frame_fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+	}
+	glDeleteSync(frame_fences[slot]);
+	frame_fences[slot] = 0;
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include "../../third_party/opengl/include/glad/glad.h"
+
+#define GPU_TIMING_PASSES 16
+#define GPU_TIMING_BUFFERS 4
+#define GPU_THROTTLE_FRAMES 4 // most frames throttle_gpu_frames can keep in flight
+
+// gpu time of render passes with GL_TIME_ELAPSED queries. every pass has a query per buffer,
+// results are read every frame once they are available. a buffer that comes around again is waited for,
+// with more buffers than frames drivers queue that does not happen. passes can not be nested.
+// queries belong to one context, init after the render context is current
+
+void init_gpu_timing(void);
+
+void delete_gpu_timing(void);
+
+// call once at the start of a frame before any pass
+void next_frame_gpu_timing(void);
+
+// passes are found by name, name has to outlive gpu timing (string literals)
+void begin_gpu_pass(const char *name);
+
+void end_gpu_pass(void);
+
+// rolling average, 0 for unknown passes
+double get_gpu_pass_timems(const char *name);
+
+// one "GPU name: ms" line per pass, returns written length
+int get_gpu_timing_text(char *text, int size);
+
+// writes frame,pass,gpu_ms rows for every read back result until stopped
+unsigned char start_gpu_timing_csv(const char *path);
+
+void stop_gpu_timing_csv(void);
+
+unsigned char is_gpu_timing_csv(void);
+
+// call once a frame after swapping. fences the frame, then waits until at most max_frames frames are queued on the gpu.
+// fewer frames in flight means input is older by fewer frames when it is shown. 0 does not wait
+void throttle_gpu_frames(unsigned int max_frames);
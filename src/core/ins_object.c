@@ -1,22 +1,50 @@
 #include "ins_object.h"
+#include "gl_state.h"
+#include "macro.h"
+#include <stddef.h>
+#include <string.h>
+
+// columns are the tangent, bitangent and normal of a face, same table as def_tex_light_ins.vs
+const float ins_face_basis[6][9] = {
+		{0, 0, -1, 0, 1, 0, 1, 0, 0},
+		{0, 0, 1, 0, 1, 0, -1, 0, 0},
+		{1, 0, 0, 0, 0, -1, 0, 1, 0},
+		{1, 0, 0, 0, 0, 1, 0, -1, 0},
+		{1, 0, 0, 0, 1, 0, 0, 0, 1},
+		{-1, 0, 0, 0, 1, 0, 0, 0, -1}};
+
+unsigned int get_instance_size(unsigned char format)
+{
+	if (format == INS_FORMAT_PACKED)
+	{
+		return sizeof(ins_packed);
+	}
+	if (format == INS_FORMAT_VOXEL)
+	{
+		return sizeof(ins_voxel);
+	}
+	return sizeof(ins_matrix);
+}
 
 ins_object_manager *create_ins_object_manager(GLfloat *vertices, unsigned int vertex_number, GLuint *indices,
-																							unsigned int indice_number)
+																							unsigned int indice_number, unsigned char format)
 {
 	ins_object_manager *x = malloc(sizeof(ins_object_manager));
+	x->format = format;
+	x->instance_size = get_instance_size(format);
 	x->VAO = 0;
 	x->VBO_geometry = 0;
-	x->VBO_model_matrix = 0;
-	x->VBO_normal_matrix = 0;
-	x->VBO_texture = 0;
+	x->VBO_instance = 0;
 	x->EBO = 0;
 	x->objects = create_DA_HIGH_MEMORY(sizeof(ins_object *), 0);
 	x->vertices = create_DA(sizeof(GLfloat), 0);
 	x->indices = create_DA(sizeof(GLuint), 0);
-	x->models = create_DA_HIGH_MEMORY(sizeof(mat4), 0);
-	x->normals = create_DA_HIGH_MEMORY(sizeof(mat4), 0);
-	x->textures = create_DA_HIGH_MEMORY(sizeof(GLfloat), 0);
+	x->instances = create_DA_HIGH_MEMORY(x->instance_size, 0);
 	x->subdata = 0;
+	x->instance_stream = 0;
+	x->instance_offset = 0;
+	x->dirty_start = UINT_MAX;
+	x->dirty_end = 0;
 	pushback_many_DA(x->vertices, vertices, vertex_number * 8);
 	pushback_many_DA(x->indices, indices, indice_number);
 	return x;
@@ -33,15 +61,12 @@ void delete_ins_object_manager(ins_object_manager *manager)
 	delete_DA(manager->objects);
 	delete_DA(manager->vertices);
 	delete_DA(manager->indices);
-	delete_DA(manager->models);
-	delete_DA(manager->normals);
-	delete_DA(manager->textures);
-	glDeleteVertexArrays(1, &(manager->VAO));
-	glDeleteBuffers(1, &(manager->VBO_geometry));
-	glDeleteBuffers(1, &(manager->VBO_model_matrix));
-	glDeleteBuffers(1, &(manager->VBO_normal_matrix));
-	glDeleteBuffers(1, &(manager->VBO_texture));
-	glDeleteBuffers(1, &(manager->EBO));
+	delete_DA(manager->instances);
+	delete_vertex_arrays(1, &(manager->VAO));
+	delete_buffers(1, &(manager->VBO_geometry));
+	delete_buffers(1, &(manager->VBO_instance));
+	delete_buffers(1, &(manager->EBO));
+	delete_stream_buffer(manager->instance_stream);
 	free(manager);
 }
 
@@ -101,12 +126,25 @@ ins_object *create_ins_object(ins_object_manager *manager, GLfloat texture_index
 		x->phy = 0;
 	}
 
-	mat4 ident = GLM_MAT4_IDENTITY_INIT;
-
 	pushback_DA(x->manager->objects, &x);
-	pushback_DA(x->manager->models, &ident);
-	pushback_DA(x->manager->normals, &ident);
-	pushback_DA(x->manager->textures, &(texture_index));
+	if (manager->format == INS_FORMAT_PACKED)
+	{
+		ins_packed instance = {{0, 0, 0}, {1, 1, 1}, {0, 0, 0, 32767}, texture_index};
+		pushback_DA(manager->instances, &instance);
+	}
+	else if (manager->format == INS_FORMAT_VOXEL)
+	{
+		ins_voxel instance = {0, 0, 0, INS_FACE_TOP, (GLubyte)texture_index};
+		pushback_DA(manager->instances, &instance);
+	}
+	else
+	{
+		ins_matrix instance;
+		memcpy(instance.model, GLM_MAT4_IDENTITY, sizeof(instance.model));
+		memcpy(instance.normal, GLM_MAT4_IDENTITY, sizeof(instance.normal));
+		instance.texture = texture_index;
+		pushback_DA(manager->instances, &instance);
+	}
 
 	return x;
 }
@@ -116,21 +154,70 @@ void delete_ins_object(ins_object *obj)
 	delete_physic(obj->phy);
 	unsigned int index = get_index_DA(obj->manager->objects, &obj);
 	remove_DA(obj->manager->objects, index);
-	remove_DA(obj->manager->models, index);
-	remove_DA(obj->manager->normals, index);
-	remove_DA(obj->manager->textures, index);
+	remove_DA(obj->manager->instances, index);
 	free(obj);
 }
 
+void add_ins_voxel(ins_object_manager *manager, int x, int y, int z, unsigned char face, unsigned char texture_index)
+{
+	ins_voxel instance = {(GLshort)x, (GLshort)y, (GLshort)z, face, texture_index};
+	pushback_DA(manager->instances, &instance);
+}
+
+void get_rotation_ins_packed(ins_packed *p, versor q)
+{
+	for (int i = 0; i < 4; i++)
+	{
+		q[i] = p->rotation[i] / 32767.0f;
+	}
+	glm_quat_normalize(q);
+}
+
+void get_model_ins_object(ins_object *obj, mat4 dest)
+{
+	ins_object_manager *manager = obj->manager;
+	unsigned int index = get_index_DA(manager->objects, &obj);
+	char *instance = (char *)get_data_DA(manager->instances) + (size_t)index * manager->instance_size;
+	if (manager->format == INS_FORMAT_PACKED)
+	{
+		ins_packed *p = (ins_packed *)instance;
+		versor q;
+		get_rotation_ins_packed(p, q);
+		glm_translate_make(dest, (vec3){p->position[0], p->position[1], p->position[2]});
+		glm_quat_rotate(dest, q, dest);
+		glm_scale(dest, (vec3){p->scale[0], p->scale[1], p->scale[2]});
+	}
+	else if (manager->format == INS_FORMAT_VOXEL)
+	{
+		ins_voxel *v = (ins_voxel *)instance;
+		const float *basis = ins_face_basis[v->face % 6];
+		glm_mat4_identity(dest);
+		for (int i = 0; i < 3; i++)
+		{
+			for (int i2 = 0; i2 < 3; i2++)
+			{
+				dest[i][i2] = basis[i * 3 + i2];
+			}
+		}
+		dest[3][0] = v->x;
+		dest[3][1] = v->y;
+		dest[3][2] = v->z;
+	}
+	else
+	{
+		memcpy(dest, ((ins_matrix *)instance)->model, sizeof(mat4));
+	}
+}
+
 void update_ins_physic(ins_object *obj)
 {
-	mat4 *model_mats = get_data_DA(obj->manager->models);
-	unsigned int index = get_index_DA(obj->manager->objects, &obj);
+	mat4 model;
+	get_model_ins_object(obj, model);
 
 	vec4 result;
-	glm_mat4_mulv(model_mats[index], (vec4){obj->phy->first_minaabb[0], obj->phy->first_minaabb[1], obj->phy->first_minaabb[2], 1}, result);
+	glm_mat4_mulv(model, (vec4){obj->phy->first_minaabb[0], obj->phy->first_minaabb[1], obj->phy->first_minaabb[2], 1}, result);
 	glm_vec3_copy(result, obj->phy->minaabb);
-	glm_mat4_mulv(model_mats[index], (vec4){obj->phy->first_maxaabb[0], obj->phy->first_maxaabb[1], obj->phy->first_maxaabb[2], 1}, result);
+	glm_mat4_mulv(model, (vec4){obj->phy->first_maxaabb[0], obj->phy->first_maxaabb[1], obj->phy->first_maxaabb[2], 1}, result);
 	glm_vec3_copy(result, obj->phy->maxaabb);
 	for (int i = 0; i < 3; i++)
 	{
@@ -143,86 +230,175 @@ void update_ins_physic(ins_object *obj)
 	}
 }
 
-void scale_ins_object(ins_object *obj, vec3 v, unsigned char effect_physic)
+// applies op to the model matrix of a matrix instance and writes its normal matrix again
+void transform_ins_matrix(ins_matrix *instance, mat4 op)
 {
-	mat4 *model_mats = get_data_DA(obj->manager->models);
-	mat4 *normal_mats = get_data_DA(obj->manager->normals);
-	unsigned int index = get_index_DA(obj->manager->objects, &obj);
+	mat4 model, normal;
+	memcpy(model, instance->model, sizeof(mat4));
+	glm_mat4_mul(model, op, model);
+	glm_mat4_inv(model, normal);
+	glm_mat4_transpose(normal);
+	memcpy(instance->model, model, sizeof(mat4));
+	memcpy(instance->normal, normal, sizeof(mat4));
+}
 
-	glm_scale(model_mats[index], v);
-	glm_mat4_inv(model_mats[index], normal_mats[index]);
-	glm_mat4_transpose(normal_mats[index]);
+void changed_ins_object(ins_object *obj, unsigned int index, unsigned char effect_physic)
+{
 	if (effect_physic == 1 && obj->phy != 0)
 	{
 		update_ins_physic(obj);
 	}
+	obj->manager->dirty_start = min(obj->manager->dirty_start, index);
+	obj->manager->dirty_end = max(obj->manager->dirty_end, index + 1);
 	obj->manager->subdata = 1;
 }
 
-void rotate_ins_object(ins_object *obj, float angle, vec3 axis, unsigned char effect_physic)
+void scale_ins_object(ins_object *obj, vec3 v, unsigned char effect_physic)
 {
-	mat4 *model_mats = get_data_DA(obj->manager->models);
-	mat4 *normal_mats = get_data_DA(obj->manager->normals);
-	unsigned int index = get_index_DA(obj->manager->objects, &obj);
+	ins_object_manager *manager = obj->manager;
+	unsigned int index = get_index_DA(manager->objects, &obj);
+	char *instance = (char *)get_data_DA(manager->instances) + (size_t)index * manager->instance_size;
+	if (manager->format == INS_FORMAT_PACKED)
+	{
+		ins_packed *p = (ins_packed *)instance;
+		for (int i = 0; i < 3; i++)
+		{
+			p->scale[i] *= v[i];
+		}
+	}
+	else if (manager->format == INS_FORMAT_MATRIX)
+	{
+		mat4 op;
+		glm_scale_make(op, v);
+		transform_ins_matrix((ins_matrix *)instance, op);
+	}
+	changed_ins_object(obj, index, effect_physic);
+}
 
-	glm_rotate(model_mats[index], glm_rad(angle), axis);
-	glm_mat4_inv(model_mats[index], normal_mats[index]);
-	glm_mat4_transpose(normal_mats[index]);
-	if (effect_physic == 1 && obj->phy != 0)
+void rotate_ins_object(ins_object *obj, float angle, vec3 axis, unsigned char effect_physic)
+{
+	ins_object_manager *manager = obj->manager;
+	unsigned int index = get_index_DA(manager->objects, &obj);
+	char *instance = (char *)get_data_DA(manager->instances) + (size_t)index * manager->instance_size;
+	if (manager->format == INS_FORMAT_PACKED)
 	{
-		update_ins_physic(obj);
+		ins_packed *p = (ins_packed *)instance;
+		versor q, r;
+		get_rotation_ins_packed(p, q);
+		glm_quatv(r, glm_rad(angle), axis);
+		glm_quat_mul(q, r, q);
+		glm_quat_normalize(q);
+		for (int i = 0; i < 4; i++)
+		{
+			p->rotation[i] = (GLshort)roundf(q[i] * 32767.0f);
+		}
 	}
-	obj->manager->subdata = 1;
+	else if (manager->format == INS_FORMAT_MATRIX)
+	{
+		mat4 op;
+		glm_rotate_make(op, glm_rad(angle), axis);
+		transform_ins_matrix((ins_matrix *)instance, op);
+	}
+	changed_ins_object(obj, index, effect_physic);
 }
 
 void translate_ins_object(ins_object *obj, vec3 v, unsigned char effect_physic)
 {
-	mat4 *model_mats = get_data_DA(obj->manager->models);
-	mat4 *normal_mats = get_data_DA(obj->manager->normals);
-	unsigned int index = get_index_DA(obj->manager->objects, &obj);
+	ins_object_manager *manager = obj->manager;
+	unsigned int index = get_index_DA(manager->objects, &obj);
+	char *instance = (char *)get_data_DA(manager->instances) + (size_t)index * manager->instance_size;
+	if (manager->format == INS_FORMAT_PACKED)
+	{
+		// v is in object space like glm_translate, so it is scaled and rotated first
+		ins_packed *p = (ins_packed *)instance;
+		versor q;
+		get_rotation_ins_packed(p, q);
+		vec3 local = {v[0] * p->scale[0], v[1] * p->scale[1], v[2] * p->scale[2]};
+		glm_quat_rotatev(q, local, local);
+		for (int i = 0; i < 3; i++)
+		{
+			p->position[i] += local[i];
+		}
+	}
+	else if (manager->format == INS_FORMAT_VOXEL)
+	{
+		ins_voxel *x = (ins_voxel *)instance;
+		x->x += (GLshort)roundf(v[0]);
+		x->y += (GLshort)roundf(v[1]);
+		x->z += (GLshort)roundf(v[2]);
+	}
+	else
+	{
+		mat4 op;
+		glm_translate_make(op, v);
+		transform_ins_matrix((ins_matrix *)instance, op);
+	}
+	changed_ins_object(obj, index, effect_physic);
+}
 
-	glm_translate(model_mats[index], v);
-	glm_mat4_inv(model_mats[index], normal_mats[index]);
-	glm_mat4_transpose(normal_mats[index]);
-	if (effect_physic == 1 && obj->phy != 0)
+// points the instanced attributes of the bound vertex array at offset of buffer
+void set_instance_attributes_ins_object_manager(ins_object_manager *manager, GLuint buffer, GLintptr offset)
+{
+	bind_buffer(GL_ARRAY_BUFFER, buffer);
+	GLsizei stride = manager->instance_size;
+	if (manager->format == INS_FORMAT_PACKED)
 	{
-		update_ins_physic(obj);
+		glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, stride, (void *)(offset + offsetof(ins_packed, position)));
+		glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, stride, (void *)(offset + offsetof(ins_packed, scale)));
+		glVertexAttribPointer(5, 4, GL_SHORT, GL_TRUE, stride, (void *)(offset + offsetof(ins_packed, rotation)));
+		glVertexAttribPointer(6, 1, GL_FLOAT, GL_FALSE, stride, (void *)(offset + offsetof(ins_packed, texture)));
 	}
-	obj->manager->subdata = 1;
+	else if (manager->format == INS_FORMAT_VOXEL)
+	{
+		glVertexAttribIPointer(3, 3, GL_SHORT, stride, (void *)(offset + offsetof(ins_voxel, x)));
+		glVertexAttribIPointer(4, 2, GL_UNSIGNED_BYTE, stride, (void *)(offset + offsetof(ins_voxel, face)));
+	}
+	else
+	{
+		for (unsigned int i = 0; i < 4; ++i)
+		{
+			glVertexAttribPointer(3 + i, 4, GL_FLOAT, GL_FALSE, stride, (void *)(offset + offsetof(ins_matrix, model) + sizeof(float) * i * 4));
+			glVertexAttribPointer(7 + i, 4, GL_FLOAT, GL_FALSE, stride, (void *)(offset + offsetof(ins_matrix, normal) + sizeof(float) * i * 4));
+		}
+		glVertexAttribPointer(11, 1, GL_FLOAT, GL_FALSE, stride, (void *)(offset + offsetof(ins_matrix, texture)));
+	}
+	bind_buffer(GL_ARRAY_BUFFER, 0);
 }
 
 void prepare_render_ins_object_manager(ins_object_manager *manager)
 {
 	// clear
-	glDeleteVertexArrays(1, &(manager->VAO));
-	glDeleteBuffers(1, &(manager->VBO_geometry));
-	glDeleteBuffers(1, &(manager->VBO_model_matrix));
-	glDeleteBuffers(1, &(manager->VBO_normal_matrix));
-	glDeleteBuffers(1, &(manager->VBO_texture));
-	glDeleteBuffers(1, &(manager->EBO));
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindVertexArray(0);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	delete_vertex_arrays(1, &(manager->VAO));
+	delete_buffers(1, &(manager->VBO_geometry));
+	delete_buffers(1, &(manager->VBO_instance));
+	delete_buffers(1, &(manager->EBO));
+	delete_stream_buffer(manager->instance_stream);
+	manager->VBO_instance = 0;
+	manager->instance_stream = 0;
+	manager->subdata = 0;
+	manager->dirty_start = UINT_MAX;
+	manager->dirty_end = 0;
+	bind_buffer(GL_ARRAY_BUFFER, 0);
+	bind_vertex_array(0);
+	bind_buffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 
-	if (get_size_DA(manager->objects) > 0)
+	if (get_size_DA(manager->instances) > 0)
 	{
 		// generate buffers
 		glGenVertexArrays(1, &(manager->VAO));
 		glGenBuffers(1, &(manager->VBO_geometry));
-		glGenBuffers(1, &(manager->VBO_model_matrix));
-		glGenBuffers(1, &(manager->VBO_normal_matrix));
-		glGenBuffers(1, &(manager->VBO_texture));
+		glGenBuffers(1, &(manager->VBO_instance));
 		glGenBuffers(1, &(manager->EBO));
 
 		// start assigning data
-		glBindVertexArray(manager->VAO);
+		bind_vertex_array(manager->VAO);
 
 		// assigning index buffer
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, manager->EBO);
+		bind_buffer(GL_ELEMENT_ARRAY_BUFFER, manager->EBO);
 		glBufferData(GL_ELEMENT_ARRAY_BUFFER, get_size_DA(manager->indices) * sizeof(GLuint), get_data_DA(manager->indices), GL_STATIC_DRAW);
 
 		// assigning vertex buffer
-		glBindBuffer(GL_ARRAY_BUFFER, manager->VBO_geometry);
+		bind_buffer(GL_ARRAY_BUFFER, manager->VBO_geometry);
 		glBufferData(GL_ARRAY_BUFFER, get_size_DA(manager->vertices) * sizeof(GLfloat), get_data_DA(manager->vertices), GL_STATIC_DRAW);
 		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), 0);
 		glEnableVertexAttribArray(0);
@@ -231,58 +407,70 @@ void prepare_render_ins_object_manager(ins_object_manager *manager)
 		glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (void *)(5 * sizeof(GLfloat)));
 		glEnableVertexAttribArray(2);
 
-		// assigning model matrix
-		glBindBuffer(GL_ARRAY_BUFFER, manager->VBO_model_matrix);
-		glBufferData(GL_ARRAY_BUFFER, get_size_DA(manager->models) * sizeof(mat4), get_data_DA(manager->models), GL_STATIC_DRAW);
-		for (unsigned int i = 0; i < 4; ++i)
+		// assigning instances, every format has its own attributes after location 2
+		bind_buffer(GL_ARRAY_BUFFER, manager->VBO_instance);
+		glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)get_size_DA(manager->instances) * manager->instance_size, get_data_DA(manager->instances), GL_STATIC_DRAW);
+		unsigned int attribute_number = 9;
+		if (manager->format == INS_FORMAT_PACKED)
 		{
-			glEnableVertexAttribArray(3 + i);
-			glVertexAttribPointer(3 + i, 4, GL_FLOAT, GL_FALSE, sizeof(mat4), (void *)(sizeof(float) * i * 4));
-			glVertexAttribDivisor(3 + i, 1); // This attribute is instanced
+			attribute_number = 4;
 		}
-
-		// assigning normal matrix
-		glBindBuffer(GL_ARRAY_BUFFER, manager->VBO_normal_matrix);
-		glBufferData(GL_ARRAY_BUFFER, get_size_DA(manager->normals) * sizeof(mat4), get_data_DA(manager->normals), GL_STATIC_DRAW);
-		for (unsigned int i = 0; i < 4; ++i)
+		else if (manager->format == INS_FORMAT_VOXEL)
 		{
-			glEnableVertexAttribArray(7 + i);
-			glVertexAttribPointer(7 + i, 4, GL_FLOAT, GL_FALSE, sizeof(mat4), (void *)(sizeof(float) * i * 4));
-			glVertexAttribDivisor(7 + i, 1); // This attribute is instanced
+			attribute_number = 2;
 		}
-
-		// assigning texture index
-		glBindBuffer(GL_ARRAY_BUFFER, manager->VBO_texture);
-		glBufferData(GL_ARRAY_BUFFER, get_size_DA(manager->textures) * sizeof(GLfloat), get_data_DA(manager->textures), GL_STATIC_DRAW);
-		glEnableVertexAttribArray(11);
-		glVertexAttribPointer(11, 1, GL_FLOAT, GL_FALSE, sizeof(GLfloat), 0);
-		glVertexAttribDivisor(11, 1); // This attribute is instanced
+		for (unsigned int i = 0; i < attribute_number; i++)
+		{
+			glEnableVertexAttribArray(3 + i);
+			glVertexAttribDivisor(3 + i, 1); // This attribute is instanced
+		}
+		set_instance_attributes_ins_object_manager(manager, manager->VBO_instance, 0);
 
 		// end assigning data
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-		glBindVertexArray(0);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+		bind_buffer(GL_ARRAY_BUFFER, 0);
+		bind_vertex_array(0);
+		bind_buffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 	}
 }
 
 void use_ins_object_manager(ins_object_manager *manager)
 {
-	if (get_size_DA(manager->objects) > 0)
+	unsigned int instance_number = get_size_DA(manager->instances);
+	if (instance_number > 0)
 	{
 		if (manager->subdata == 1)
 		{
-			glBindBuffer(GL_ARRAY_BUFFER, manager->VBO_model_matrix);
-			glBufferSubData(GL_ARRAY_BUFFER, 0, get_size_DA(manager->models) * sizeof(mat4), get_data_DA(manager->models));
-			glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-			glBindBuffer(GL_ARRAY_BUFFER, manager->VBO_normal_matrix);
-			glBufferSubData(GL_ARRAY_BUFFER, 0, get_size_DA(manager->normals) * sizeof(mat4), get_data_DA(manager->normals));
-			glBindBuffer(GL_ARRAY_BUFFER, 0);
-
+			if (manager->instance_stream == 0)
+			{
+				// first change after prepare, instances are streamed from now on
+				manager->instance_stream = create_stream_buffer((GLsizeiptr)instance_number * manager->instance_size, get_data_DA(manager->instances));
+				delete_buffers(1, &(manager->VBO_instance));
+				manager->VBO_instance = 0;
+				manager->instance_offset = -1;
+			}
+			else if (manager->dirty_start < manager->dirty_end)
+			{
+				mark_stream_buffer(manager->instance_stream, (GLintptr)manager->dirty_start * manager->instance_size,
+													 (GLsizeiptr)(manager->dirty_end - manager->dirty_start) * manager->instance_size);
+			}
 			manager->subdata = 0;
+			manager->dirty_start = UINT_MAX;
+			manager->dirty_end = 0;
+		}
+		bind_vertex_array(manager->VAO);
+		if (manager->instance_stream != 0)
+		{
+			GLintptr offset = update_stream_buffer(manager->instance_stream, get_data_DA(manager->instances));
+			if (offset != manager->instance_offset)
+			{
+				set_instance_attributes_ins_object_manager(manager, manager->instance_stream->buffer, offset);
+				manager->instance_offset = offset;
+			}
+		}
+		glDrawElementsInstanced(GL_TRIANGLES, get_size_DA(manager->indices), GL_UNSIGNED_INT, 0, instance_number);
+		if (manager->instance_stream != 0)
+		{
+			fence_stream_buffer(manager->instance_stream);
 		}
-		glBindVertexArray(manager->VAO);
-		glDrawElementsInstanced(GL_TRIANGLES, get_size_DA(manager->indices), GL_UNSIGNED_INT, 0, get_size_DA(manager->objects));
-		glBindVertexArray(0);
 	}
-}
\ No newline at end of file
+}
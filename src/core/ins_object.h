@@ -2,17 +2,60 @@
 #include "../../third_party/opengl/include/glad/glad.h"
 #include "dynamic.h"
 #include "physics.h"
+#include "stream_buffer.h"
+
+// per instance data of a manager, also the variant of get_def_tex_light_ins_program and get_def_shadowmap_ins_program.
+// packed and voxel derive the normal in the shader instead of uploading a normal matrix
+#define INS_FORMAT_MATRIX 0 // ins_matrix, any transform, 132 bytes
+#define INS_FORMAT_PACKED 1 // ins_packed, translation, rotation and scale, 36 bytes
+#define INS_FORMAT_VOXEL 2	// ins_voxel, unit quad at an integer position facing one axis, 8 bytes
+
+// faces of INS_FORMAT_VOXEL, the geometry of the manager faces +z and is rotated to the face
+#define INS_FACE_RIGHT 0 // +x
+#define INS_FACE_LEFT 1	 // -x
+#define INS_FACE_TOP 2	 // +y
+#define INS_FACE_BOTTOM 3
+#define INS_FACE_BACK 4 // +z
+#define INS_FACE_FRONT 5
+
+// plain floats so there is no padding of aligned mat4 between them
+typedef struct ins_matrix
+{
+	GLfloat model[16];
+	GLfloat normal[16];
+	GLfloat texture;
+} ins_matrix;
+
+// model is translation * rotation * scale. rotating after a non uniform scale is not exact
+typedef struct ins_packed
+{
+	GLfloat position[3];
+	GLfloat scale[3];
+	GLshort rotation[4]; // normalized quaternion, x y z w
+	GLfloat texture;
+} ins_packed;
+
+typedef struct ins_voxel
+{
+	GLshort x, y, z;
+	GLubyte face;
+	GLubyte texture;
+} ins_voxel;
 
 typedef struct ins_object_manager
 {
 	DA *objects;
-	GLuint VAO, VBO_geometry, VBO_model_matrix, VBO_normal_matrix, VBO_texture, EBO;
+	unsigned char format;
+	unsigned int instance_size;
+	GLuint VAO, VBO_geometry, VBO_instance, EBO;
 	DA *vertices; // 3 vertex coord, 2 texture coord, 3 normal coord
 	DA *indices;
-	DA *models;
-	DA *normals;
-	DA *textures;
+	DA *instances; // instance_size bytes each, same order as objects
 	unsigned char subdata;
+	stream_buffer *instance_stream; // created when instances change after prepare_render_ins_object_manager
+	GLintptr instance_offset;				// region the instanced attributes point to
+	unsigned int dirty_start;				// changed range of instances
+	unsigned int dirty_end;
 } ins_object_manager;
 
 typedef struct ins_object
@@ -22,7 +65,7 @@ typedef struct ins_object
 } ins_object;
 
 ins_object_manager *create_ins_object_manager(GLfloat *vertices, unsigned int vertex_number, GLuint *indices,
-											  unsigned int indice_number);
+											  unsigned int indice_number, unsigned char format);
 
 void delete_ins_object_manager(ins_object_manager *manager);
 
@@ -31,13 +74,19 @@ ins_object *create_ins_object(ins_object_manager *manager, GLfloat texture_index
 
 void delete_ins_object(ins_object *obj);
 
+// voxel managers only, adds a fixed instance without an ins_object. dont mix it with create_ins_object in a manager
+void add_ins_voxel(ins_object_manager *manager, int x, int y, int z, unsigned char face, unsigned char texture_index);
+
 void scale_ins_object(ins_object *obj, vec3 v, unsigned char effect_physic);
 
+// voxel instances only translate by whole units, scale and rotate do nothing for them
 void rotate_ins_object(ins_object *obj, float angle, vec3 axis, unsigned char effect_physic);
 
 void translate_ins_object(ins_object *obj, vec3 v, unsigned char effect_physic);
 
+void get_model_ins_object(ins_object *obj, mat4 dest);
+
 // after deleting or creating new objects use this before rendering
 void prepare_render_ins_object_manager(ins_object_manager *manager);
 
-void use_ins_object_manager(ins_object_manager *manager);
\ No newline at end of file
+void use_ins_object_manager(ins_object_manager *manager);
@@ -1,8 +1,13 @@
 #include "lighting.h"
+#include "gl_state.h"
 #include "float.h"
 #include "random.h"
 #include "core.h"
 #include "macro.h"
+#include <string.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
 
 void calculate_lighting_projection(lighting *l, int step)
 {
@@ -25,54 +30,138 @@ void calculate_lighting_projection(lighting *l, int step)
 	glm_mat4_inv(l->cam->result, l->camresultinv);
 	glm_frustum_corners(l->camresultinv, l->frustumcorners);
 	glm_frustum_center(l->frustumcorners, l->frustumcenter);
-	glm_vec3_add(l->frustumcenter, l->lightDir, l->lookatinput1);
-	glm_lookat(l->lookatinput1, l->frustumcenter, l->up, l->lightView);
-
-	l->minX = FLT_MAX;
-	l->maxX = -FLT_MAX;
-	l->minY = FLT_MAX;
-	l->maxY = -FLT_MAX;
-	l->minZ = FLT_MAX;
-	l->maxZ = -FLT_MAX;
 
+	// bounding sphere of the slice does not change when camera turns, only moving camera moves the cascade
+	float radius = 0;
 	for (int i = 0; i < 8; i++)
 	{
-		glm_mat4_mulv(l->lightView, l->frustumcorners[i], l->tmp);
-		l->minX = min(l->minX, l->tmp[0]);
-		l->maxX = max(l->maxX, l->tmp[0]);
-		l->minY = min(l->minY, l->tmp[1]);
-		l->maxY = max(l->maxY, l->tmp[1]);
-		l->minZ = min(l->minZ, l->tmp[2]);
-		l->maxZ = max(l->maxZ, l->tmp[2]);
-	}
-	if (l->minZ < 0)
-	{
-		l->minZ *= l->zMult;
-	}
-	else
-	{
-		l->minZ /= l->zMult;
+		radius = max(radius, glm_vec3_distance(l->frustumcorners[i], l->frustumcenter));
 	}
-	if (l->maxZ < 0)
+	radius = ceilf(radius);
+	float extent = step == 0 ? radius : radius * (1.0f + SHADOW_CACHE_MARGIN);
+
+	// light view is fixed for a light direction so centers can be snapped to texels and compared
+	glm_lookat(l->lightDir, l->center, l->up, l->lightView);
+	glm_mat4_mulv(l->lightView, l->frustumcenter, l->tmp);
+	float texel = 2.0f * extent / (float)l->cascadeSize[step];
+	l->tmp[0] = floorf(l->tmp[0] / texel) * texel;
+	l->tmp[1] = floorf(l->tmp[1] / texel) * texel;
+	l->tmp[2] = floorf(l->tmp[2] / texel) * texel;
+
+	// cascade 0 is always drawn, far ones while slice is still inside the margin they were drawn with
+	float threshold = extent - radius;
+	if (step != 0 && (l->shadow_dirty & (1 << step)) == 0 && fabsf(l->tmp[0] - l->cacheCenter[step][0]) <= threshold &&
+			fabsf(l->tmp[1] - l->cacheCenter[step][1]) <= threshold && fabsf(l->tmp[2] - l->cacheCenter[step][2]) <= threshold)
 	{
-		l->maxZ /= l->zMult;
+		return;
 	}
-	else
+	l->shadow_dirty |= 1 << step;
+	glm_vec3_copy(l->tmp, l->cacheCenter[step]);
+
+	l->minX = l->tmp[0] - extent;
+	l->maxX = l->tmp[0] + extent;
+	l->minY = l->tmp[1] - extent;
+	l->maxY = l->tmp[1] + extent;
+	// stretched towards the light with zMult so casters outside the slice are kept
+	l->minZ = l->tmp[2] - extent;
+	l->maxZ = l->tmp[2] + extent * l->zMult;
+	glm_ortho(l->minX, l->maxX, l->minY, l->maxY, -l->maxZ, -l->minZ, l->orthgonalProjection);
+	glm_mat4_mul(l->orthgonalProjection, l->lightView, l->lightProjection[step]);
+}
+
+void invalidate_shadow_cache(lighting *l)
+{
+	l->shadow_invalid = 1;
+}
+
+// first cascade is at origin, smaller ones are stacked in a column on its right, what does not fit goes to a row below it
+void layout_shadow_atlas(lighting *l)
+{
+	GLuint column = 0, columny = 0, rowx = 0, row = 0;
+	l->cascadeOffset[0][0] = 0;
+	l->cascadeOffset[0][1] = 0;
+	for (int i = 1; i < 4; i++)
 	{
-		l->maxZ *= l->zMult;
+		GLuint size = l->cascadeSize[i];
+		if ((column == 0 || size <= column) && columny + size <= l->cascadeSize[0])
+		{
+			column = max(column, size);
+			l->cascadeOffset[i][0] = l->cascadeSize[0];
+			l->cascadeOffset[i][1] = columny;
+			columny += size;
+		}
+		else
+		{
+			l->cascadeOffset[i][0] = rowx;
+			l->cascadeOffset[i][1] = l->cascadeSize[0];
+			rowx += size;
+			row = max(row, size);
+		}
 	}
-	glm_ortho(l->minX, l->maxX, l->minY, l->maxY, l->minZ, l->maxZ, l->orthgonalProjection);
-	glm_mat4_mul(l->orthgonalProjection, l->lightView, l->lightProjection[step]);
+	l->shadowMapWidth = max(l->cascadeSize[0] + column, rowx);
+	l->shadowMapHeight = l->cascadeSize[0] + row;
+}
+
+GLuint create_shadow_map(lighting *l)
+{
+	GLuint map = 0;
+	glGenTextures(1, &map);
+	bind_texture(GL_TEXTURE_2D, map);
+	glTexImage2D(GL_TEXTURE_2D, 0, l->shadowDepthFormat, l->shadowMapWidth, l->shadowMapHeight, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	return map;
+}
+
+GLuint create_shadow_framebuffer(GLuint map)
+{
+	GLuint fbo = 0;
+	glGenFramebuffers(1, &fbo);
+	bind_framebuffer(GL_FRAMEBUFFER, fbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, map, 0);
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+	bind_framebuffer(GL_FRAMEBUFFER, 0);
+	return fbo;
 }
 
-lighting *create_lighting(GLFWwindow *window, camera *cam, GLuint shadowMapWidth, GLuint shadowMapHeight, float cascade0range,
+GLuint create_texture_buffer(GLenum format, GLsizeiptr size, GLuint *buffer)
+{
+	GLuint texture = 0;
+	glGenBuffers(1, buffer);
+	bind_buffer(GL_TEXTURE_BUFFER, *buffer);
+	glBufferData(GL_TEXTURE_BUFFER, size, 0, GL_STREAM_DRAW);
+	bind_buffer(GL_TEXTURE_BUFFER, 0);
+	glGenTextures(1, &texture);
+	bind_texture(GL_TEXTURE_BUFFER, texture);
+	glTexBuffer(GL_TEXTURE_BUFFER, format, *buffer);
+	return texture;
+}
+
+void light_cluster_thread(void *data);
+
+GLuint create_uniform_buffer(GLsizeiptr size)
+{
+	GLuint ubo = 0;
+	glGenBuffers(1, &ubo);
+	bind_buffer(GL_UNIFORM_BUFFER, ubo);
+	glBufferData(GL_UNIFORM_BUFFER, size, 0, GL_DYNAMIC_DRAW);
+	bind_buffer(GL_UNIFORM_BUFFER, 0);
+	return ubo;
+}
+
+lighting *create_lighting(GLFWwindow *window, camera *cam, GLuint *cascadeSizes, GLenum shadowDepthFormat, float cascade0range,
 													float cascade1range, float cascade2range, float cascade3range, float fog_start, float fog_end,
 													vec3 fog_color, unsigned char deferred, unsigned char ssao)
 {
 	lighting *l = 0;
 	malloc32(l, sizeof(lighting));
-	l->programs = create_DA(sizeof(GLuint), 0);
-	l->uniforms = create_DA(sizeof(GLint), 0);
+	l->lighting_ubo = create_uniform_buffer(sizeof(lighting_block));
+	l->fog_ubo = create_uniform_buffer(sizeof(fog_block));
+	l->postprocess_ubo = create_uniform_buffer(sizeof(postprocess_block));
+	l->ssao_ubo = create_uniform_buffer(sizeof(ssao_block));
 
 	l->cascade0range = cascade0range;
 	l->cascade1range = cascade1range;
@@ -100,89 +189,78 @@ lighting *create_lighting(GLFWwindow *window, camera *cam, GLuint shadowMapWidth
 	glm_normalize(l->lightDir);
 
 	glfwGetWindowSize(window, &(l->windowwidth), &(l->windowheight));
+	l->renderwidth = l->windowwidth;
+	l->renderheight = l->windowheight;
+	l->resolution_scale = 1;
+	l->min_resolution_scale = 0.5f;
+	l->target_frame_ms = 0;
+	l->outputfbo = 0;
+	l->outputcolor = 0;
+	l->outputdepth = 0;
+	l->ssao_divisor = ssao == SSAO_HALF ? 2 : (ssao == SSAO_QUARTER ? 4 : 1);
+	l->ssaowidth = (l->windowwidth + l->ssao_divisor - 1) / l->ssao_divisor;
+	l->ssaoheight = (l->windowheight + l->ssao_divisor - 1) / l->ssao_divisor;
+	l->ssaorenderwidth = l->ssaowidth;
+	l->ssaorenderheight = l->ssaoheight;
 
-	l->shadowMapWidth = shadowMapWidth;
-	l->shadowMapHeight = shadowMapHeight;
+	for (int i = 0; i < 4; i++)
+	{
+		l->cascadeSize[i] = i == 0 ? cascadeSizes[i] : min(cascadeSizes[i], l->cascadeSize[i - 1]);
+	}
+	l->shadowDepthFormat = shadowDepthFormat;
+	layout_shadow_atlas(l);
 
+	l->lights = create_DA(sizeof(point_light), 0);
+	l->free_lights = create_DA(sizeof(unsigned int), 0);
+	l->light_count = 0;
+	l->light_x = 0;
+	l->light_y = 0;
+	l->light_z = 0;
+	l->light_radius = 0;
+	l->light_range = 0;
+	l->light_data = 0;
+	l->visible_light_count = 0;
+	l->visible_light_capacity = 0;
+	l->cluster_data = 0;
+	l->cluster_done = 0;
+	l->cluster_quit = 0;
+	glm_vec4_zero(l->cluster_params);
+
+	l->fog = 1;
 	l->fog_start = fog_start;
 	l->fog_end = fog_end;
 	glm_vec3_copy(fog_color, l->fog_color);
 
-	glGenFramebuffers(1, &l->shadowMapFBO);
-
-	glGenTextures(1, &l->shadowMap);
-	glBindTexture(GL_TEXTURE_2D_ARRAY, l->shadowMap);
-	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT32F, l->shadowMapWidth, l->shadowMapHeight, 4, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
-	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-
-	float clampColor[] = {1.0f, 1.0f, 1.0f, 1.0f};
-	glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, clampColor);
-
-	glBindFramebuffer(GL_FRAMEBUFFER, l->shadowMapFBO);
-	glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, l->shadowMap, 0);
-
-	glDrawBuffer(GL_NONE);
-	glReadBuffer(GL_NONE);
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	l->shadowMap = create_shadow_map(l);
+	l->staticShadowMap = create_shadow_map(l);
+	l->shadowMapFBO = create_shadow_framebuffer(l->shadowMap);
+	l->staticShadowMapFBO = create_shadow_framebuffer(l->staticShadowMap);
+	for (int i = 0; i < 4; i++)
+	{
+		l->dynamicRect[i][0] = 0;
+		l->dynamicRect[i][1] = 0;
+		l->dynamicRect[i][2] = 0;
+		l->dynamicRect[i][3] = 0;
+	}
+	l->shadow_dirty = 0;
+	l->shadow_invalid = 1;
+	l->shadow_round_robin = 0;
+	l->shadow_refresh_next = 0;
+	l->shadow_draw = 0;
+	l->shadow_cascade_program = 0;
+	l->shadow_cascade_uniform = -1;
 
+	// render targets come from a frame graph every frame, see add_lighting_targets
+	l->gNormal = 0;
+	l->gTexCoord = 0;
+	l->gdepth = 0;
+	l->ssaobuffer = 0;
+	l->ssaoblurbuffer = 0;
+	l->deferredtexture = 0;
+	l->noiseTexture = 0;
+	l->ssao = ssao;
 	if (deferred == 1)
 	{
-		glGenFramebuffers(1, &l->gbufferFBO);
-		glBindFramebuffer(GL_FRAMEBUFFER, l->gbufferFBO);
-
-		glGenTextures(1, &l->gPosition);
-		glBindTexture(GL_TEXTURE_2D, l->gPosition);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB32F, l->windowwidth, l->windowheight, 0, GL_RGB, GL_FLOAT, NULL);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-		glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, clampColor);
-		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, l->gPosition, 0);
-
-		glGenTextures(1, &l->gNormal);
-		glBindTexture(GL_TEXTURE_2D, l->gNormal);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, l->windowwidth, l->windowheight, 0, GL_RGB, GL_FLOAT, NULL);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-		glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, clampColor);
-		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, l->gNormal, 0);
-
-		glGenTextures(1, &l->gTexCoord);
-		glBindTexture(GL_TEXTURE_2D, l->gTexCoord);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, l->windowwidth, l->windowheight, 0, GL_RGB, GL_FLOAT, NULL);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-		glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, clampColor);
-		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, l->gTexCoord, 0);
-
-		glGenTextures(1, &l->gTexCoordcopy);
-		glBindTexture(GL_TEXTURE_2D, l->gTexCoordcopy);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, l->windowwidth, l->windowheight, 0, GL_RGB, GL_FLOAT, NULL);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-		glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, clampColor);
-		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT3, GL_TEXTURE_2D, l->gTexCoordcopy, 0);
-
-		unsigned int attachments[4] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3};
-		glDrawBuffers(4, attachments);
-
-		glGenRenderbuffers(1, &l->gdepth);
-		glBindRenderbuffer(GL_RENDERBUFFER, l->gdepth);
-		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, l->windowwidth, l->windowheight);
-		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, l->gdepth);
-
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
 		GLfloat quadVertices[] = {
 				-1.0f, 1.0f, 0.0f, 0.0f, 1.0f,	// top right
 				-1.0f, -1.0f, 0.0f, 0.0f, 0.0f, // down right
@@ -193,48 +271,21 @@ lighting *create_lighting(GLFWwindow *window, camera *cam, GLuint shadowMapWidth
 		glGenVertexArrays(1, &(l->quadvao));
 		glGenBuffers(1, &(l->quadvbo));
 		glGenBuffers(1, &(l->quadebo));
-		glBindVertexArray(l->quadvao);
-		glBindBuffer(GL_ARRAY_BUFFER, l->quadvbo);
+		bind_vertex_array(l->quadvao);
+		bind_buffer(GL_ARRAY_BUFFER, l->quadvbo);
 		glBufferData(GL_ARRAY_BUFFER, 20 * sizeof(GLfloat), quadVertices, GL_STATIC_DRAW);
 		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(GLfloat), 0);
 		glEnableVertexAttribArray(0);
 		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(GLfloat), (void *)(3 * sizeof(GLfloat)));
 		glEnableVertexAttribArray(1);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, l->quadebo);
+		bind_buffer(GL_ELEMENT_ARRAY_BUFFER, l->quadebo);
 		glBufferData(GL_ELEMENT_ARRAY_BUFFER, 6 * sizeof(GLuint), quadindices, GL_STATIC_DRAW);
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-		glBindVertexArray(0);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+		bind_buffer(GL_ARRAY_BUFFER, 0);
+		bind_vertex_array(0);
+		bind_buffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 
 		if (ssao)
 		{
-			glGenFramebuffers(1, &l->ssaofbo);
-			glGenFramebuffers(1, &l->ssaoblurfbo);
-			glBindFramebuffer(GL_FRAMEBUFFER, l->ssaofbo);
-
-			glGenTextures(1, &l->ssaobuffer);
-			glBindTexture(GL_TEXTURE_2D, l->ssaobuffer);
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, l->windowwidth, l->windowheight, 0, GL_RED, GL_FLOAT, NULL);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-			glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, clampColor);
-			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, l->ssaobuffer, 0);
-
-			glBindFramebuffer(GL_FRAMEBUFFER, l->ssaoblurfbo);
-			glGenTextures(1, &l->ssaoblurbuffer);
-			glBindTexture(GL_TEXTURE_2D, l->ssaoblurbuffer);
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, l->windowwidth, l->windowheight, 0, GL_RED, GL_FLOAT, NULL);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-			glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, clampColor);
-			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, l->ssaoblurbuffer, 0);
-
-			glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
 			for (unsigned int i = 0; i < 64; ++i)
 			{
 				l->ssaoKernel[i][0] = random_float(0, 1) * 2 - 1;
@@ -253,32 +304,54 @@ lighting *create_lighting(GLFWwindow *window, camera *cam, GLuint shadowMapWidth
 				l->ssaoNoise[i][2] = 0;
 			}
 			glGenTextures(1, &l->noiseTexture);
-			glBindTexture(GL_TEXTURE_2D, l->noiseTexture);
+			bind_texture(GL_TEXTURE_2D, l->noiseTexture);
 			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, 4, 4, 0, GL_RGB, GL_FLOAT, &l->ssaoNoise[0]);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 
-			l->noiseScale[0] = l->windowwidth / 4.0f;
-			l->noiseScale[1] = l->windowheight / 4.0f;
+			// noise repeats every 4 ssao pixels whatever their size is
+			l->noiseScale[0] = l->ssaowidth / 4.0f;
+			l->noiseScale[1] = l->ssaoheight / 4.0f;
+
+			// kernel never changes so ssao_block is written only here
+			ssao_block block;
+			for (unsigned int i = 0; i < 64; i++)
+			{
+				glm_vec4(l->ssaoKernel[i], 0, block.samples[i]);
+			}
+			glm_vec2_copy(l->noiseScale, block.noiseScale);
+			bind_buffer(GL_UNIFORM_BUFFER, l->ssao_ubo);
+			glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(ssao_block), &block);
+			bind_buffer(GL_UNIFORM_BUFFER, 0);
 		}
 		l->has_ssao = 0;
 
-		glGenFramebuffers(1, &l->deferredfbo);
-		glBindFramebuffer(GL_FRAMEBUFFER, l->deferredfbo);
-
-		glGenTextures(1, &l->deferredtexture);
-		glBindTexture(GL_TEXTURE_2D, l->deferredtexture);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, l->windowwidth, l->windowheight, 0, GL_RGB, GL_FLOAT, NULL);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-		glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, clampColor);
-		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, l->deferredtexture, 0);
+		l->light_texture = create_texture_buffer(GL_RGBA32F, 12 * sizeof(float), &l->light_buffer);
+		l->cluster_texture = create_texture_buffer(GL_RG32UI, LIGHT_CLUSTERS * 2 * sizeof(GLuint), &l->cluster_buffer);
+		l->index_texture = create_texture_buffer(GL_R32UI, sizeof(GLuint), &l->index_buffer);
+		l->cluster_data = calloc(LIGHT_CLUSTERS * 2, sizeof(GLuint));
+		l->cluster_done = create_semaphore(0);
+		// first job runs on the thread calling update_lighting, the others wait on their own threads
+		for (int i = 0; i < LIGHT_CLUSTER_THREADS; i++)
+		{
+			light_cluster_job *job = &l->cluster_jobs[i];
+			job->l = l;
+			job->first_slice = 0;
+			job->last_slice = 0;
+			job->indices = 0;
+			job->index_count = 0;
+			job->index_capacity = 0;
+			job->thread = 0;
+			job->start = 0;
+			if (i != 0)
+			{
+				job->start = create_semaphore(0);
+				job->thread = create_thread(light_cluster_thread, job);
+			}
+		}
 
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
 		l->vignette_pp = 0;
 		l->kernel_pp = 0;
 		l->wave_pp = 0;
@@ -289,239 +362,819 @@ lighting *create_lighting(GLFWwindow *window, camera *cam, GLuint shadowMapWidth
 	return l;
 }
 
-void lighting_set_uniforms(lighting *l, GLuint program)
-{
-	if (get_index_DA(l->programs, &program) == UINT_MAX)
-	{
-		pushback_DA(l->programs, &program);
-		GLint uniform = glGetUniformLocation(program, "lightColor");
-		pushback_DA(l->uniforms, &uniform);
-		uniform = glGetUniformLocation(program, "lightDir");
-		pushback_DA(l->uniforms, &uniform);
-		uniform = glGetUniformLocation(program, "ambient");
-		pushback_DA(l->uniforms, &uniform);
-		uniform = glGetUniformLocation(program, "specularStrength");
-		pushback_DA(l->uniforms, &uniform);
-		uniform = glGetUniformLocation(program, "lightProjection");
-		pushback_DA(l->uniforms, &uniform);
-		uniform = glGetUniformLocation(program, "shadowMap");
-		pushback_DA(l->uniforms, &uniform);
-		uniform = glGetUniformLocation(program, "cascade0range");
-		pushback_DA(l->uniforms, &uniform);
-		uniform = glGetUniformLocation(program, "cascade1range");
-		pushback_DA(l->uniforms, &uniform);
-		uniform = glGetUniformLocation(program, "cascade2range");
-		pushback_DA(l->uniforms, &uniform);
-		uniform = glGetUniformLocation(program, "cascade3range");
-		pushback_DA(l->uniforms, &uniform);
-		uniform = glGetUniformLocation(program, "fog_start");
-		pushback_DA(l->uniforms, &uniform);
-		uniform = glGetUniformLocation(program, "fog_end");
-		pushback_DA(l->uniforms, &uniform);
-		uniform = glGetUniformLocation(program, "fog_color");
-		pushback_DA(l->uniforms, &uniform);
-		uniform = glGetUniformLocation(program, "gPosition");
-		pushback_DA(l->uniforms, &uniform);
-		uniform = glGetUniformLocation(program, "gNormal");
-		pushback_DA(l->uniforms, &uniform);
-		uniform = glGetUniformLocation(program, "gTexCoord");
-		pushback_DA(l->uniforms, &uniform);
-		uniform = glGetUniformLocation(program, "noiseScale");
-		pushback_DA(l->uniforms, &uniform);
-		uniform = glGetUniformLocation(program, "texNoise");
-		pushback_DA(l->uniforms, &uniform);
-		uniform = glGetUniformLocation(program, "ssaoInput");
-		pushback_DA(l->uniforms, &uniform);
-		uniform = glGetUniformLocation(program, "ssao");
-		pushback_DA(l->uniforms, &uniform);
-		uniform = glGetUniformLocation(program, "samples");
-		pushback_DA(l->uniforms, &uniform);
-		uniform = glGetUniformLocation(program, "has_ssao");
-		pushback_DA(l->uniforms, &uniform);
-		uniform = glGetUniformLocation(program, "deferred");
-		pushback_DA(l->uniforms, &uniform);
-		uniform = glGetUniformLocation(program, "screenResolution");
-		pushback_DA(l->uniforms, &uniform);
-		uniform = glGetUniformLocation(program, "vignette");
-		pushback_DA(l->uniforms, &uniform);
-		uniform = glGetUniformLocation(program, "kernel");
-		pushback_DA(l->uniforms, &uniform);
-		uniform = glGetUniformLocation(program, "wave");
-		pushback_DA(l->uniforms, &uniform);
-		uniform = glGetUniformLocation(program, "inverse");
-		pushback_DA(l->uniforms, &uniform);
-		uniform = glGetUniformLocation(program, "fxaa");
-		pushback_DA(l->uniforms, &uniform);
-		uniform = glGetUniformLocation(program, "time");
-		pushback_DA(l->uniforms, &uniform);
-		uniform = glGetUniformLocation(program, "gTexCoordcopy");
-		pushback_DA(l->uniforms, &uniform);
-	}
-	GLint *uniforms = get_data_DA(l->uniforms);
-	unsigned int index = get_index_DA(l->programs, &program);
-	glUniform4f(uniforms[index * 31], l->lightColor[0], l->lightColor[1], l->lightColor[2], l->lightColor[3]);
-	glUniform3f(uniforms[index * 31 + 1], l->lightDir[0], l->lightDir[1], l->lightDir[2]);
-	glUniform1f(uniforms[index * 31 + 2], l->ambient);
-	glUniform1f(uniforms[index * 31 + 3], l->specularStrength);
-	glUniformMatrix4fv(uniforms[index * 31 + 4], 4, GL_FALSE, l->lightProjection[0][0]);
-	glUniform1i(uniforms[index * 31 + 5], 31);
-	glUniform1f(uniforms[index * 31 + 6], l->cascade0range);
-	glUniform1f(uniforms[index * 31 + 7], l->cascade1range);
-	glUniform1f(uniforms[index * 31 + 8], l->cascade2range);
-	glUniform1f(uniforms[index * 31 + 9], l->cascade3range);
-	glUniform1f(uniforms[index * 31 + 10], l->fog_start);
-	glUniform1f(uniforms[index * 31 + 11], l->fog_end);
-	glUniform3f(uniforms[index * 31 + 12], l->fog_color[0], l->fog_color[1], l->fog_color[2]);
-	glUniform1i(uniforms[index * 31 + 13], 30);
-	glUniform1i(uniforms[index * 31 + 14], 29);
-	glUniform1i(uniforms[index * 31 + 15], 28);
-	glUniform2f(uniforms[index * 31 + 16], l->noiseScale[0], l->noiseScale[1]);
-	glUniform1i(uniforms[index * 31 + 17], 31);
-	glUniform1i(uniforms[index * 31 + 18], 31);
-	glUniform1i(uniforms[index * 31 + 19], 27);
-	glUniform3fv(uniforms[index * 31 + 20], 64, l->ssaoKernel[0]);
-	glUniform1i(uniforms[index * 31 + 21], l->has_ssao);
-	glUniform1i(uniforms[index * 31 + 22], 31);
-	glUniform2f(uniforms[index * 31 + 23], (float)l->windowwidth, (float)l->windowheight);
-	glUniform1i(uniforms[index * 31 + 24], l->vignette_pp);
-	glUniform1i(uniforms[index * 31 + 25], l->kernel_pp);
-	glUniform1i(uniforms[index * 31 + 26], l->wave_pp);
-	glUniform1i(uniforms[index * 31 + 27], l->inverse_pp);
-	glUniform1i(uniforms[index * 31 + 28], l->fxaa);
-	glUniform1f(uniforms[index * 31 + 29], (float)glfwGetTime());
-	glUniform1i(uniforms[index * 31 + 30], 31);
-	use_camera(l->cam, program);
-}
-
-void use_lighting_shadowpass(lighting *l, GLuint program)
+void update_lighting_resolution(lighting *l, double frame_ms)
+{
+	if (l->target_frame_ms > 0 && frame_ms > 0)
+	{
+		// cost follows pixel count so scale goes with square root of the ratio, small differences are ignored
+		// and only a part of the way is taken every frame so it does not oscillate
+		float ratio = (float)(l->target_frame_ms / frame_ms);
+		if (ratio < 0.95f || ratio > 1.05f)
+		{
+			float wanted = l->resolution_scale * sqrtf(ratio);
+			l->resolution_scale += (wanted - l->resolution_scale) * 0.1f;
+			l->resolution_scale = max(l->min_resolution_scale, min(1.0f, l->resolution_scale));
+		}
+	}
+	l->renderwidth = max(1, (int)(l->windowwidth * l->resolution_scale));
+	l->renderheight = max(1, (int)(l->windowheight * l->resolution_scale));
+	l->ssaorenderwidth = min(l->ssaowidth, (l->renderwidth + l->ssao_divisor - 1) / l->ssao_divisor);
+	l->ssaorenderheight = min(l->ssaoheight, (l->renderheight + l->ssao_divisor - 1) / l->ssao_divisor);
+}
+
+void calculate_light_cluster_bounds(lighting *l)
+{
+	camera *cam = l->cam;
+	// planes between tiles go through the camera, x = t * depth on a plane between columns
+	for (int i = 0; i <= LIGHT_CLUSTER_X; i++)
+	{
+		float t = (-1.0f + 2.0f * i / LIGHT_CLUSTER_X) / cam->projection[0][0];
+		float length = sqrtf(1 + t * t);
+		l->cluster_planes_x[i][0] = 1 / length;
+		l->cluster_planes_x[i][1] = t / length;
+	}
+	for (int i = 0; i <= LIGHT_CLUSTER_Y; i++)
+	{
+		float t = (-1.0f + 2.0f * i / LIGHT_CLUSTER_Y) / cam->projection[1][1];
+		float length = sqrtf(1 + t * t);
+		l->cluster_planes_y[i][0] = 1 / length;
+		l->cluster_planes_y[i][1] = t / length;
+	}
+	// exponential slices keep clusters about as deep as they are wide
+	float ratio = cam->farPlane / cam->nearPlane;
+	for (int i = 0; i <= LIGHT_CLUSTER_Z; i++)
+	{
+		l->cluster_slices[i] = cam->nearPlane * powf(ratio, (float)i / LIGHT_CLUSTER_Z);
+	}
+	l->cluster_params[0] = LIGHT_CLUSTER_Z / logf(ratio);
+	l->cluster_params[1] = LIGHT_CLUSTER_Z * logf(cam->nearPlane) / logf(ratio);
+}
+
+void gather_visible_lights(lighting *l)
+{
+	if (l->light_count > l->visible_light_capacity)
+	{
+		free32(l->light_x);
+		free32(l->light_y);
+		free32(l->light_z);
+		free32(l->light_radius);
+		free32(l->light_range);
+		free(l->light_data);
+		l->visible_light_capacity = max(l->visible_light_capacity * 2, (l->light_count + 7) & ~7u);
+		malloc32(l->light_x, l->visible_light_capacity * sizeof(float));
+		malloc32(l->light_y, l->visible_light_capacity * sizeof(float));
+		malloc32(l->light_z, l->visible_light_capacity * sizeof(float));
+		malloc32(l->light_radius, l->visible_light_capacity * sizeof(float));
+		malloc32(l->light_range, l->visible_light_capacity * 6 * sizeof(int));
+		l->light_data = malloc(l->visible_light_capacity * 12 * sizeof(float));
+	}
+	point_light *lights = get_data_DA(l->lights);
+	unsigned int count = 0;
+	for (unsigned int i = 0; i < get_size_DA(l->lights); i++)
+	{
+		if (!lights[i].active)
+		{
+			continue;
+		}
+		vec4 position = {lights[i].position[0], lights[i].position[1], lights[i].position[2], 1};
+		vec4 view;
+		glm_mat4_mulv(l->cam->view, position, view);
+		float depth = -view[2];
+		// behind the camera or past the far plane, camera looks at -z
+		if (depth + lights[i].radius <= l->cam->nearPlane || depth - lights[i].radius >= l->cam->farPlane)
+		{
+			continue;
+		}
+		l->light_x[count] = view[0];
+		l->light_y[count] = view[1];
+		l->light_z[count] = view[2];
+		l->light_radius[count] = lights[i].radius;
+		memcpy(l->light_data + count * 12, &lights[i], 12 * sizeof(float));
+		count++;
+	}
+	l->visible_light_count = count;
+	// simd lanes past the last light see a light of no radius
+	for (; count < ((l->visible_light_count + 7) & ~7u); count++)
+	{
+		l->light_x[count] = 0;
+		l->light_y[count] = 0;
+		l->light_z[count] = 0;
+		l->light_radius[count] = 0;
+	}
+}
+
+// first and last tile column, row and slice every light touches. planes between tiles are in order so the number of
+// planes a sphere is fully past is its first tile, and the number it is not fully before is one more than its last
+void calculate_light_ranges(lighting *l)
+{
+	unsigned int capacity = l->visible_light_capacity;
+	int *range = l->light_range;
+#ifdef __AVX2__
+	for (unsigned int i = 0; i < l->visible_light_count; i += 8)
+	{
+		__m256 x = _mm256_load_ps(l->light_x + i);
+		__m256 y = _mm256_load_ps(l->light_y + i);
+		__m256 z = _mm256_load_ps(l->light_z + i);
+		__m256 r = _mm256_load_ps(l->light_radius + i);
+		__m256 negative_r = _mm256_sub_ps(_mm256_setzero_ps(), r);
+		__m256 nearest = _mm256_sub_ps(_mm256_sub_ps(_mm256_setzero_ps(), z), r);
+		__m256 farthest = _mm256_add_ps(_mm256_sub_ps(_mm256_setzero_ps(), z), r);
+		// compare masks are -1 in lanes where they are true, subtracting them counts
+		__m256i x0 = _mm256_setzero_si256(), x1 = _mm256_set1_epi32(-1);
+		__m256i y0 = _mm256_setzero_si256(), y1 = _mm256_set1_epi32(-1);
+		__m256i z0 = _mm256_setzero_si256(), z1 = _mm256_set1_epi32(-1);
+		for (int j = 0; j <= LIGHT_CLUSTER_X; j++)
+		{
+			__m256 s = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(l->cluster_planes_x[j][0]), x),
+															 _mm256_mul_ps(_mm256_set1_ps(l->cluster_planes_x[j][1]), z));
+			if (j != 0)
+			{
+				x0 = _mm256_sub_epi32(x0, _mm256_castps_si256(_mm256_cmp_ps(s, r, _CMP_GT_OQ)));
+			}
+			if (j != LIGHT_CLUSTER_X)
+			{
+				x1 = _mm256_sub_epi32(x1, _mm256_castps_si256(_mm256_cmp_ps(s, negative_r, _CMP_GE_OQ)));
+			}
+		}
+		for (int j = 0; j <= LIGHT_CLUSTER_Y; j++)
+		{
+			__m256 s = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(l->cluster_planes_y[j][0]), y),
+															 _mm256_mul_ps(_mm256_set1_ps(l->cluster_planes_y[j][1]), z));
+			if (j != 0)
+			{
+				y0 = _mm256_sub_epi32(y0, _mm256_castps_si256(_mm256_cmp_ps(s, r, _CMP_GT_OQ)));
+			}
+			if (j != LIGHT_CLUSTER_Y)
+			{
+				y1 = _mm256_sub_epi32(y1, _mm256_castps_si256(_mm256_cmp_ps(s, negative_r, _CMP_GE_OQ)));
+			}
+		}
+		for (int j = 0; j <= LIGHT_CLUSTER_Z; j++)
+		{
+			__m256 slice = _mm256_set1_ps(l->cluster_slices[j]);
+			if (j != 0)
+			{
+				z0 = _mm256_sub_epi32(z0, _mm256_castps_si256(_mm256_cmp_ps(slice, nearest, _CMP_LE_OQ)));
+			}
+			if (j != LIGHT_CLUSTER_Z)
+			{
+				z1 = _mm256_sub_epi32(z1, _mm256_castps_si256(_mm256_cmp_ps(slice, farthest, _CMP_LT_OQ)));
+			}
+		}
+		_mm256_store_si256((__m256i *)(range + i), x0);
+		_mm256_store_si256((__m256i *)(range + capacity + i), x1);
+		_mm256_store_si256((__m256i *)(range + capacity * 2 + i), y0);
+		_mm256_store_si256((__m256i *)(range + capacity * 3 + i), y1);
+		_mm256_store_si256((__m256i *)(range + capacity * 4 + i), z0);
+		_mm256_store_si256((__m256i *)(range + capacity * 5 + i), z1);
+	}
+#else
+	for (unsigned int i = 0; i < l->visible_light_count; i++)
+	{
+		float x = l->light_x[i], y = l->light_y[i], z = l->light_z[i], r = l->light_radius[i];
+		int x0 = 0, x1 = -1, y0 = 0, y1 = -1, z0 = 0, z1 = -1;
+		for (int j = 0; j <= LIGHT_CLUSTER_X; j++)
+		{
+			float s = l->cluster_planes_x[j][0] * x + l->cluster_planes_x[j][1] * z;
+			x0 += j != 0 && s > r;
+			x1 += j != LIGHT_CLUSTER_X && s >= -r;
+		}
+		for (int j = 0; j <= LIGHT_CLUSTER_Y; j++)
+		{
+			float s = l->cluster_planes_y[j][0] * y + l->cluster_planes_y[j][1] * z;
+			y0 += j != 0 && s > r;
+			y1 += j != LIGHT_CLUSTER_Y && s >= -r;
+		}
+		for (int j = 0; j <= LIGHT_CLUSTER_Z; j++)
+		{
+			z0 += j != 0 && l->cluster_slices[j] <= -z - r;
+			z1 += j != LIGHT_CLUSTER_Z && l->cluster_slices[j] < -z + r;
+		}
+		range[i] = x0;
+		range[capacity + i] = x1;
+		range[capacity * 2 + i] = y0;
+		range[capacity * 3 + i] = y1;
+		range[capacity * 4 + i] = z0;
+		range[capacity * 5 + i] = z1;
+	}
+#endif
+}
+
+// pass 0 counts the lights of every cluster of the job, pass 1 writes their indices after the offsets
+void add_job_lights(light_cluster_job *job, unsigned char pass)
+{
+	lighting *l = job->l;
+	unsigned int capacity = l->visible_light_capacity;
+	int *range = l->light_range;
+	GLuint *clusters = l->cluster_data;
+	for (unsigned int i = 0; i < l->visible_light_count; i++)
+	{
+		int z0 = max(range[capacity * 4 + i], job->first_slice);
+		int z1 = min(range[capacity * 5 + i], job->last_slice - 1);
+		for (int z = z0; z <= z1; z++)
+		{
+			for (int y = range[capacity * 2 + i]; y <= range[capacity * 3 + i]; y++)
+			{
+				GLuint *cluster = clusters + ((z * LIGHT_CLUSTER_Y + y) * LIGHT_CLUSTER_X + range[i]) * 2;
+				for (int x = range[i]; x <= range[capacity + i]; x++)
+				{
+					if (pass == 1)
+					{
+						job->indices[cluster[0] + cluster[1]] = i;
+					}
+					cluster[1]++;
+					cluster += 2;
+				}
+			}
+		}
+	}
+}
+
+// every job owns the clusters of its slices, offsets are inside its own indices until update_light_clusters joins them
+void assign_light_clusters(light_cluster_job *job)
+{
+	GLuint *clusters = job->l->cluster_data;
+	int first = job->first_slice * LIGHT_CLUSTER_X * LIGHT_CLUSTER_Y;
+	int last = job->last_slice * LIGHT_CLUSTER_X * LIGHT_CLUSTER_Y;
+	for (int c = first; c < last; c++)
+	{
+		clusters[c * 2 + 1] = 0;
+	}
+	add_job_lights(job, 0);
+	unsigned int offset = 0;
+	for (int c = first; c < last; c++)
+	{
+		clusters[c * 2] = offset;
+		offset += clusters[c * 2 + 1];
+		clusters[c * 2 + 1] = 0;
+	}
+	if (offset > job->index_capacity)
+	{
+		free(job->indices);
+		job->index_capacity = max(offset, job->index_capacity * 2);
+		job->indices = malloc(job->index_capacity * sizeof(GLuint));
+	}
+	add_job_lights(job, 1);
+	job->index_count = offset;
+}
+
+void light_cluster_thread(void *data)
+{
+	light_cluster_job *job = (light_cluster_job *)data;
+	while (1)
+	{
+		wait_semaphore(job->start);
+		if (job->l->cluster_quit)
+		{
+			return;
+		}
+		assign_light_clusters(job);
+		post_semaphore(job->l->cluster_done);
+	}
+}
+
+void update_light_clusters(lighting *l)
 {
+	calculate_light_cluster_bounds(l);
+	gather_visible_lights(l);
+	if (l->visible_light_count == 0)
+	{
+		return;
+	}
+	calculate_light_ranges(l);
+
+	// waking threads costs more than a few lights
+	int jobs = l->visible_light_count >= LIGHT_CLUSTER_MIN_PARALLEL ? LIGHT_CLUSTER_THREADS : 1;
+	for (int i = 0; i < jobs; i++)
+	{
+		l->cluster_jobs[i].first_slice = LIGHT_CLUSTER_Z * i / jobs;
+		l->cluster_jobs[i].last_slice = LIGHT_CLUSTER_Z * (i + 1) / jobs;
+	}
+	for (int i = 1; i < jobs; i++)
+	{
+		post_semaphore(l->cluster_jobs[i].start);
+	}
+	assign_light_clusters(&l->cluster_jobs[0]);
+	for (int i = 1; i < jobs; i++)
+	{
+		wait_semaphore(l->cluster_done);
+	}
+
+	// indices of the jobs go into the buffer one after another
+	unsigned int index_count = 0;
+	for (int i = 0; i < jobs; i++)
+	{
+		light_cluster_job *job = &l->cluster_jobs[i];
+		for (int c = job->first_slice * LIGHT_CLUSTER_X * LIGHT_CLUSTER_Y; c < job->last_slice * LIGHT_CLUSTER_X * LIGHT_CLUSTER_Y; c++)
+		{
+			l->cluster_data[c * 2] += index_count;
+		}
+		index_count += job->index_count;
+	}
+
+	bind_buffer(GL_TEXTURE_BUFFER, l->light_buffer);
+	glBufferData(GL_TEXTURE_BUFFER, l->visible_light_count * 12 * sizeof(float), l->light_data, GL_STREAM_DRAW);
+	bind_buffer(GL_TEXTURE_BUFFER, l->cluster_buffer);
+	glBufferData(GL_TEXTURE_BUFFER, LIGHT_CLUSTERS * 2 * sizeof(GLuint), l->cluster_data, GL_STREAM_DRAW);
+	bind_buffer(GL_TEXTURE_BUFFER, l->index_buffer);
+	glBufferData(GL_TEXTURE_BUFFER, max(index_count, 1) * sizeof(GLuint), 0, GL_STREAM_DRAW);
+	GLintptr offset = 0;
+	for (int i = 0; i < jobs; i++)
+	{
+		light_cluster_job *job = &l->cluster_jobs[i];
+		if (job->index_count != 0)
+		{
+			glBufferSubData(GL_TEXTURE_BUFFER, offset, job->index_count * sizeof(GLuint), job->indices);
+		}
+		offset += job->index_count * sizeof(GLuint);
+	}
+	bind_buffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void update_lighting(lighting *l)
+{
+	l->shadow_dirty = 0;
+	if (l->shadow_invalid || !glm_vec3_eqv(l->lightDir, l->cacheLightDir))
+	{
+		l->shadow_dirty = 15;
+		l->shadow_invalid = 0;
+		glm_vec3_copy(l->lightDir, l->cacheLightDir);
+	}
+	else if (l->shadow_round_robin)
+	{
+		l->shadow_dirty = 1 << (1 + l->shadow_refresh_next);
+		l->shadow_refresh_next = (l->shadow_refresh_next + 1) % 3;
+	}
 	calculate_lighting_projection(l, 0);
 	calculate_lighting_projection(l, 1);
 	calculate_lighting_projection(l, 2);
 	calculate_lighting_projection(l, 3);
-	lighting_set_uniforms(l, program);
-	glCullFace(GL_BACK);
-	glBindFramebuffer(GL_FRAMEBUFFER, l->shadowMapFBO);
-	glViewport(0, 0, l->shadowMapWidth, l->shadowMapHeight);
-	glClear(GL_DEPTH_BUFFER_BIT);
+	update_camera_buffer(l->cam);
+	if (l->cluster_data != 0)
+	{
+		update_light_clusters(l);
+	}
+
+	lighting_block light;
+	glm_mat4_copy(l->lightProjection[0], light.lightProjection[0]);
+	glm_mat4_copy(l->lightProjection[1], light.lightProjection[1]);
+	glm_mat4_copy(l->lightProjection[2], light.lightProjection[2]);
+	glm_mat4_copy(l->lightProjection[3], light.lightProjection[3]);
+	glm_vec4_copy(l->lightColor, light.lightColor);
+	glm_vec3_copy(l->lightDir, light.lightDir);
+	light.ambient = l->ambient;
+	light.specularStrength = l->specularStrength;
+	light.cascade0range = l->cascade0range;
+	light.cascade1range = l->cascade1range;
+	light.cascade2range = l->cascade2range;
+	light.cascade3range = l->cascade3range;
+	for (int i = 0; i < 4; i++)
+	{
+		light.cascadeRect[i][0] = (float)l->cascadeOffset[i][0] / l->shadowMapWidth;
+		light.cascadeRect[i][1] = (float)l->cascadeOffset[i][1] / l->shadowMapHeight;
+		light.cascadeRect[i][2] = (float)l->cascadeSize[i] / l->shadowMapWidth;
+		light.cascadeRect[i][3] = (float)l->cascadeSize[i] / l->shadowMapHeight;
+	}
+	glm_vec4_copy(l->cluster_params, light.clusterParams);
+	bind_buffer(GL_UNIFORM_BUFFER, l->lighting_ubo);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(lighting_block), &light);
+
+	fog_block fog;
+	glm_vec3_copy(l->fog_color, fog.fog_color);
+	fog.fog_start = l->fog_start;
+	fog.fog_end = l->fog_end;
+	bind_buffer(GL_UNIFORM_BUFFER, l->fog_ubo);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(fog_block), &fog);
+
+	postprocess_block pp;
+	pp.screenResolution[0] = (float)l->windowwidth;
+	pp.screenResolution[1] = (float)l->windowheight;
+	pp.renderScale[0] = (float)l->renderwidth / l->windowwidth;
+	pp.renderScale[1] = (float)l->renderheight / l->windowheight;
+	pp.ssaoScale[0] = (float)l->ssaorenderwidth / l->ssaowidth;
+	pp.ssaoScale[1] = (float)l->ssaorenderheight / l->ssaoheight;
+	pp.vignette = l->vignette_pp;
+	pp.kernel = l->kernel_pp;
+	pp.wave = l->wave_pp;
+	pp.inverse = l->inverse_pp;
+	pp.fxaa = l->fxaa;
+	bind_buffer(GL_UNIFORM_BUFFER, l->postprocess_ubo);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(postprocess_block), &pp);
+	bind_buffer(GL_UNIFORM_BUFFER, 0);
+
+	bind_buffer_base(GL_UNIFORM_BUFFER, LIGHTING_BLOCK_BINDING, l->lighting_ubo);
+	bind_buffer_base(GL_UNIFORM_BUFFER, FOG_BLOCK_BINDING, l->fog_ubo);
+	bind_buffer_base(GL_UNIFORM_BUFFER, POSTPROCESS_BLOCK_BINDING, l->postprocess_ubo);
+	bind_buffer_base(GL_UNIFORM_BUFFER, SSAO_BLOCK_BINDING, l->ssao_ubo);
+}
+
+void set_shadow_cascade(lighting *l, GLuint program, int cascade)
+{
+	if (l->shadow_cascade_program != program)
+	{
+		l->shadow_cascade_program = program;
+		l->shadow_cascade_uniform = glGetUniformLocation(program, "cascade");
+	}
+	glUniform1i(l->shadow_cascade_uniform, cascade);
+}
+
+// atlas texels of a cascade that a sphere can cover, empty if rect[0] >= rect[2] or rect[1] >= rect[3]
+void get_shadow_rect(lighting *l, int step, vec3 center, float radius, GLint *rect)
+{
+	float minx = FLT_MAX, maxx = -FLT_MAX, miny = FLT_MAX, maxy = -FLT_MAX;
+	for (int i = 0; i < 8; i++)
+	{
+		vec4 corner = {center[0] + ((i & 1) ? radius : -radius), center[1] + ((i & 2) ? radius : -radius),
+									 center[2] + ((i & 4) ? radius : -radius), 1.0f};
+		glm_mat4_mulv(l->lightProjection[step], corner, l->tmp);
+		minx = min(minx, l->tmp[0]);
+		maxx = max(maxx, l->tmp[0]);
+		miny = min(miny, l->tmp[1]);
+		maxy = max(maxy, l->tmp[1]);
+	}
+	// one texel more on every side for linear filtering
+	int size = l->cascadeSize[step];
+	rect[0] = l->cascadeOffset[step][0] + max(0, (int)floorf((minx * 0.5f + 0.5f) * size) - 1);
+	rect[1] = l->cascadeOffset[step][1] + max(0, (int)floorf((miny * 0.5f + 0.5f) * size) - 1);
+	rect[2] = l->cascadeOffset[step][0] + min(size, (int)ceilf((maxx * 0.5f + 0.5f) * size) + 1);
+	rect[3] = l->cascadeOffset[step][1] + min(size, (int)ceilf((maxy * 0.5f + 0.5f) * size) + 1);
+}
+
+unsigned char use_lighting_shadowpass(lighting *l, GLuint program)
+{
+	if (l->shadow_dirty == 0)
+	{
+		return 0;
+	}
+	set_cull_face(GL_BACK);
+	bind_framebuffer(GL_FRAMEBUFFER, l->staticShadowMapFBO);
+	glEnable(GL_SCISSOR_TEST);
+	for (int i = 0; i < 4; i++)
+	{
+		if (l->shadow_dirty & (1 << i))
+		{
+			glScissor(l->cascadeOffset[i][0], l->cascadeOffset[i][1], l->cascadeSize[i], l->cascadeSize[i]);
+			glClear(GL_DEPTH_BUFFER_BIT);
+		}
+	}
+	glDisable(GL_SCISSOR_TEST);
+	l->shadow_draw = l->shadow_dirty;
+	return 1;
+}
+
+void use_lighting_shadowpass_dynamic(lighting *l, GLuint program, vec3 center, float radius)
+{
+	bind_framebuffer(GL_READ_FRAMEBUFFER, l->staticShadowMapFBO);
+	bind_framebuffer(GL_DRAW_FRAMEBUFFER, l->shadowMapFBO);
+	l->shadow_draw = 0;
+	for (int i = 0; i < 4; i++)
+	{
+		GLint *last = l->dynamicRect[i];
+		if (l->shadow_dirty & (1 << i))
+		{
+			GLint x0 = l->cascadeOffset[i][0], y0 = l->cascadeOffset[i][1];
+			GLint x1 = x0 + l->cascadeSize[i], y1 = y0 + l->cascadeSize[i];
+			glBlitFramebuffer(x0, y0, x1, y1, x0, y0, x1, y1, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+		}
+		else if (last[0] < last[2] && last[1] < last[3])
+		{
+			// rest of the cascade did not change, only remove dynamic objects of last frame
+			glBlitFramebuffer(last[0], last[1], last[2], last[3], last[0], last[1], last[2], last[3], GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+		}
+		get_shadow_rect(l, i, center, radius, last);
+		if (last[0] < last[2] && last[1] < last[3])
+		{
+			l->shadow_draw |= 1 << i;
+		}
+	}
+	set_cull_face(GL_BACK);
+	bind_framebuffer(GL_FRAMEBUFFER, l->shadowMapFBO);
+}
+
+unsigned char use_lighting_shadow_cascade(lighting *l, GLuint program, int cascade)
+{
+	if ((l->shadow_draw & (1 << cascade)) == 0)
+	{
+		return 0;
+	}
+	// viewport clips the cascade to its part of the atlas
+	set_viewport(l->cascadeOffset[cascade][0], l->cascadeOffset[cascade][1], l->cascadeSize[cascade], l->cascadeSize[cascade]);
+	set_shadow_cascade(l, program, cascade);
+	return 1;
 }
 
 void use_lighting_forward(lighting *l, GLuint program)
 {
-	lighting_set_uniforms(l, program);
-	glCullFace(GL_FRONT);
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-	glViewport(0, 0, l->windowwidth, l->windowheight);
+	set_cull_face(GL_FRONT);
+	bind_framebuffer(GL_FRAMEBUFFER, 0);
+	set_viewport(0, 0, l->windowwidth, l->windowheight);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	glActiveTexture(GL_TEXTURE31);
-	glBindTexture(GL_TEXTURE_2D_ARRAY, l->shadowMap);
+	active_texture(GL_TEXTURE31);
+	bind_texture(GL_TEXTURE_2D, l->shadowMap);
 }
 
 void use_lighting_gbuffer(lighting *l, GLuint program, unsigned char clear)
 {
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-	lighting_set_uniforms(l, program);
 	l->has_ssao = 0;
-	glCullFace(GL_FRONT);
-	glBindFramebuffer(GL_FRAMEBUFFER, l->gbufferFBO);
-	glViewport(0, 0, l->windowwidth, l->windowheight);
+	set_cull_face(GL_FRONT);
+	set_viewport(0, 0, l->renderwidth, l->renderheight);
 	if (clear)
 	{
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 	}
-	glActiveTexture(GL_TEXTURE31);
-	glBindTexture(GL_TEXTURE_2D, l->gTexCoordcopy);
+	glDisablei(GL_BLEND, 1);
+}
+
+void use_lighting_gbuffer_blend(lighting *l, GLuint program)
+{
+	use_lighting_gbuffer(l, program, 0);
+	// normal is replaced, only albedo is blended
+	glEnablei(GL_BLEND, 1);
+	glBlendFunci(1, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+}
+
+unsigned int get_lighting_deferred_variant(lighting *l)
+{
+	unsigned int variant = 0;
+	// has_ssao depends on whether ssao ran this frame, ask after the ssao passes
+	if (l->has_ssao)
+	{
+		variant |= DEFERRED_SSAO;
+		if (l->ssao_divisor > 1)
+		{
+			variant |= DEFERRED_SSAO_UPSAMPLE;
+		}
+	}
+	if (l->fog)
+	{
+		variant |= DEFERRED_FOG;
+	}
+	if (l->visible_light_count != 0)
+	{
+		variant |= DEFERRED_POINT_LIGHTS;
+	}
+	return variant;
+}
+
+unsigned int get_lighting_ssao_variant(lighting *l)
+{
+	if (l->ssao_divisor == 4)
+	{
+		return SSAO_SAMPLES_8;
+	}
+	return l->ssao_divisor == 2 ? SSAO_SAMPLES_16 : 0;
+}
+
+unsigned int get_lighting_postprocess_variant(lighting *l)
+{
+	// effects dont mix, first one that is on wins like before
+	unsigned int variant = 0;
+	if (l->vignette_pp)
+	{
+		variant = POSTPROCESS_VIGNETTE;
+	}
+	else if (l->kernel_pp)
+	{
+		variant = POSTPROCESS_KERNEL;
+	}
+	else if (l->wave_pp)
+	{
+		variant = POSTPROCESS_WAVE;
+	}
+	else if (l->inverse_pp)
+	{
+		variant = POSTPROCESS_INVERSE;
+	}
+	if (l->fxaa)
+	{
+		variant |= POSTPROCESS_FXAA;
+	}
+	return variant;
 }
 
 void use_lighting_deferred(lighting *l, GLuint program)
 {
-	lighting_set_uniforms(l, program);
-	glBindFramebuffer(GL_FRAMEBUFFER, l->deferredfbo);
-	glViewport(0, 0, l->windowwidth, l->windowheight);
+	set_viewport(0, 0, l->renderwidth, l->renderheight);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	glActiveTexture(GL_TEXTURE31);
-	glBindTexture(GL_TEXTURE_2D_ARRAY, l->shadowMap);
-	glActiveTexture(GL_TEXTURE30);
-	glBindTexture(GL_TEXTURE_2D, l->gPosition);
-	glActiveTexture(GL_TEXTURE29);
-	glBindTexture(GL_TEXTURE_2D, l->gNormal);
-	glActiveTexture(GL_TEXTURE28);
-	glBindTexture(GL_TEXTURE_2D, l->gTexCoord);
+	active_texture(GL_TEXTURE31);
+	bind_texture(GL_TEXTURE_2D, l->shadowMap);
+	active_texture(GL_TEXTURE30);
+	bind_texture(GL_TEXTURE_2D, l->gdepth);
+	active_texture(GL_TEXTURE29);
+	bind_texture(GL_TEXTURE_2D, l->gNormal);
+	active_texture(GL_TEXTURE28);
+	bind_texture(GL_TEXTURE_2D, l->gTexCoord);
 	if (l->has_ssao)
 	{
-		glActiveTexture(GL_TEXTURE27);
-		glBindTexture(GL_TEXTURE_2D, l->ssaoblurbuffer);
+		active_texture(GL_TEXTURE27);
+		bind_texture(GL_TEXTURE_2D, l->ssaoblurbuffer);
+	}
+	if (l->visible_light_count != 0)
+	{
+		active_texture(GL_TEXTURE26);
+		bind_texture(GL_TEXTURE_BUFFER, l->light_texture);
+		active_texture(GL_TEXTURE25);
+		bind_texture(GL_TEXTURE_BUFFER, l->cluster_texture);
+		active_texture(GL_TEXTURE24);
+		bind_texture(GL_TEXTURE_BUFFER, l->index_texture);
 	}
-	glBindVertexArray(l->quadvao);
+	bind_vertex_array(l->quadvao);
 	glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-	glBindVertexArray(0);
+}
+
+void add_lighting_targets(lighting *l, frame_graph *g)
+{
+	// window size, scene passes draw into renderwidth x renderheight of them
+	l->gnormal_target = create_frame_graph_texture(g, "gNormal", GL_RG16, l->windowwidth, l->windowheight, GL_NEAREST, GL_CLAMP_TO_EDGE);
+	l->gtexcoord_target = create_frame_graph_texture(g, "gTexCoord", GL_RGB8, l->windowwidth, l->windowheight, GL_NEAREST, GL_CLAMP_TO_EDGE);
+	l->gdepth_target = create_frame_graph_texture(g, "gDepth", GL_DEPTH_COMPONENT32F, l->windowwidth, l->windowheight, GL_NEAREST, GL_CLAMP_TO_EDGE);
+	l->ssao_target = create_frame_graph_texture(g, "ssao", GL_R8, l->ssaowidth, l->ssaoheight, GL_NEAREST, GL_CLAMP_TO_BORDER);
+	l->ssaoblur_target = create_frame_graph_texture(g, "ssao blur", GL_R8, l->ssaowidth, l->ssaoheight, GL_NEAREST, GL_CLAMP_TO_BORDER);
+	// linear because post process scales it up to the window
+	l->deferred_target = create_frame_graph_texture(g, "deferred", GL_RGB8, l->windowwidth, l->windowheight, GL_LINEAR, GL_CLAMP_TO_EDGE);
+	// static cascades are cached across frames so shadow map stays a permanent texture
+	l->shadow_target = import_frame_graph_texture(g, "shadowMap", l->shadowMap);
+}
+
+void get_lighting_targets(lighting *l, frame_graph *g)
+{
+	l->gNormal = get_frame_graph_texture(g, l->gnormal_target);
+	l->gTexCoord = get_frame_graph_texture(g, l->gtexcoord_target);
+	l->gdepth = get_frame_graph_texture(g, l->gdepth_target);
+	l->ssaobuffer = get_frame_graph_texture(g, l->ssao_target);
+	l->ssaoblurbuffer = get_frame_graph_texture(g, l->ssaoblur_target);
+	l->deferredtexture = get_frame_graph_texture(g, l->deferred_target);
+}
+
+void create_lighting_offscreen(lighting *l)
+{
+	glGenFramebuffers(1, &l->outputfbo);
+	bind_framebuffer(GL_FRAMEBUFFER, l->outputfbo);
+	glGenRenderbuffers(1, &l->outputcolor);
+	glBindRenderbuffer(GL_RENDERBUFFER, l->outputcolor);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, l->windowwidth, l->windowheight);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, l->outputcolor);
+	glGenRenderbuffers(1, &l->outputdepth);
+	glBindRenderbuffer(GL_RENDERBUFFER, l->outputdepth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, l->windowwidth, l->windowheight);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, l->outputdepth);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+	bind_framebuffer(GL_FRAMEBUFFER, 0);
 }
 
 void use_lighting_postprocess(lighting *l, GLuint program)
 {
-	lighting_set_uniforms(l, program);
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-	glViewport(0, 0, l->windowwidth, l->windowheight);
+	bind_framebuffer(GL_FRAMEBUFFER, l->outputfbo);
+	set_viewport(0, 0, l->windowwidth, l->windowheight);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	glActiveTexture(GL_TEXTURE31);
-	glBindTexture(GL_TEXTURE_2D, l->deferredtexture);
-	glActiveTexture(GL_TEXTURE29);
-	glBindTexture(GL_TEXTURE_2D, l->gNormal);
-	glBindVertexArray(l->quadvao);
+	active_texture(GL_TEXTURE31);
+	bind_texture(GL_TEXTURE_2D, l->deferredtexture);
+	active_texture(GL_TEXTURE30);
+	bind_texture(GL_TEXTURE_2D, l->gdepth);
+	bind_vertex_array(l->quadvao);
 	glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-	glBindVertexArray(0);
 }
 
 void use_lighting_ssao(lighting *l, GLuint program)
 {
-	lighting_set_uniforms(l, program);
-	glBindFramebuffer(GL_FRAMEBUFFER, l->ssaofbo);
-	glViewport(0, 0, l->windowwidth, l->windowheight);
+	set_viewport(0, 0, l->ssaorenderwidth, l->ssaorenderheight);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	glActiveTexture(GL_TEXTURE30);
-	glBindTexture(GL_TEXTURE_2D, l->gPosition);
-	glActiveTexture(GL_TEXTURE29);
-	glBindTexture(GL_TEXTURE_2D, l->gNormal);
-	glActiveTexture(GL_TEXTURE31);
-	glBindTexture(GL_TEXTURE_2D, l->noiseTexture);
-	glBindVertexArray(l->quadvao);
+	active_texture(GL_TEXTURE30);
+	bind_texture(GL_TEXTURE_2D, l->gdepth);
+	active_texture(GL_TEXTURE29);
+	bind_texture(GL_TEXTURE_2D, l->gNormal);
+	active_texture(GL_TEXTURE31);
+	bind_texture(GL_TEXTURE_2D, l->noiseTexture);
+	bind_vertex_array(l->quadvao);
 	glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-	glBindVertexArray(0);
 }
 
 void use_lighting_ssao_blur(lighting *l, GLuint program)
 {
-	lighting_set_uniforms(l, program);
-	glBindFramebuffer(GL_FRAMEBUFFER, l->ssaoblurfbo);
-	glViewport(0, 0, l->windowwidth, l->windowheight);
+	set_viewport(0, 0, l->ssaorenderwidth, l->ssaorenderheight);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	glActiveTexture(GL_TEXTURE31);
-	glBindTexture(GL_TEXTURE_2D, l->ssaobuffer);
-	glBindVertexArray(l->quadvao);
+	active_texture(GL_TEXTURE31);
+	bind_texture(GL_TEXTURE_2D, l->ssaobuffer);
+	bind_vertex_array(l->quadvao);
 	glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-	glBindVertexArray(0);
 	l->has_ssao = 1;
 }
 
+unsigned int add_lighting_light(lighting *l, point_light *light)
+{
+	light->active = 1;
+	l->light_count++;
+	unsigned int free_number = get_size_DA(l->free_lights);
+	if (free_number != 0)
+	{
+		unsigned int id = ((unsigned int *)get_data_DA(l->free_lights))[free_number - 1];
+		remove_DA(l->free_lights, free_number - 1);
+		((point_light *)get_data_DA(l->lights))[id] = *light;
+		return id;
+	}
+	pushback_DA(l->lights, light);
+	return get_size_DA(l->lights) - 1;
+}
+
+unsigned int add_lighting_point_light(lighting *l, vec3 position, vec3 color, float radius)
+{
+	point_light light;
+	glm_vec3_copy(position, light.position);
+	light.radius = radius;
+	glm_vec3_copy(color, light.color);
+	light.cos_inner = -1;
+	light.direction[0] = 0;
+	light.direction[1] = -1;
+	light.direction[2] = 0;
+	light.cos_outer = -2;
+	return add_lighting_light(l, &light);
+}
+
+unsigned int add_lighting_spot_light(lighting *l, vec3 position, vec3 direction, vec3 color, float radius, float inner_angle,
+																		 float outer_angle)
+{
+	point_light light;
+	glm_vec3_copy(position, light.position);
+	light.radius = radius;
+	glm_vec3_copy(color, light.color);
+	light.cos_inner = cosf(glm_rad(inner_angle));
+	glm_vec3_normalize_to(direction, light.direction);
+	light.cos_outer = cosf(glm_rad(outer_angle));
+	return add_lighting_light(l, &light);
+}
+
+void set_lighting_light_position(lighting *l, unsigned int id, vec3 position)
+{
+	glm_vec3_copy(position, ((point_light *)get_data_DA(l->lights))[id].position);
+}
+
+void set_lighting_light_color(lighting *l, unsigned int id, vec3 color)
+{
+	glm_vec3_copy(color, ((point_light *)get_data_DA(l->lights))[id].color);
+}
+
+void set_lighting_light_direction(lighting *l, unsigned int id, vec3 direction)
+{
+	glm_vec3_normalize_to(direction, ((point_light *)get_data_DA(l->lights))[id].direction);
+}
+
+void remove_lighting_light(lighting *l, unsigned int id)
+{
+	point_light *light = (point_light *)get_data_DA(l->lights) + id;
+	if (light->active)
+	{
+		light->active = 0;
+		l->light_count--;
+		pushback_DA(l->free_lights, &id);
+	}
+}
+
 void delete_lighting(lighting *l)
 {
-	glDeleteFramebuffers(1, &(l->shadowMapFBO));
-	glDeleteTextures(1, &(l->shadowMap));
-	glDeleteFramebuffers(1, &(l->gbufferFBO));
-	glDeleteTextures(1, &(l->gPosition));
-	glDeleteTextures(1, &(l->gNormal));
-	glDeleteTextures(1, &(l->gTexCoord));
-	glDeleteTextures(1, &(l->gTexCoordcopy));
-	glDeleteTextures(1, &(l->gdepth));
-	glDeleteVertexArrays(1, &(l->quadvao));
-	glDeleteBuffers(1, &(l->quadvbo));
-	glDeleteBuffers(1, &(l->quadebo));
-	glDeleteFramebuffers(1, &(l->ssaofbo));
-	glDeleteFramebuffers(1, &(l->ssaoblurfbo));
-	glDeleteTextures(1, &(l->ssaobuffer));
-	glDeleteTextures(1, &(l->ssaoblurbuffer));
-	glDeleteTextures(1, &(l->noiseTexture));
-	delete_DA(l->programs);
-	delete_DA(l->uniforms);
+	if (l->cluster_data != 0)
+	{
+		l->cluster_quit = 1;
+		for (int i = 1; i < LIGHT_CLUSTER_THREADS; i++)
+		{
+			post_semaphore(l->cluster_jobs[i].start);
+			join_thread(l->cluster_jobs[i].thread);
+			destroy_semaphore(l->cluster_jobs[i].start);
+		}
+		for (int i = 0; i < LIGHT_CLUSTER_THREADS; i++)
+		{
+			free(l->cluster_jobs[i].indices);
+		}
+		destroy_semaphore(l->cluster_done);
+		free(l->cluster_data);
+		delete_textures(1, &(l->light_texture));
+		delete_textures(1, &(l->cluster_texture));
+		delete_textures(1, &(l->index_texture));
+		delete_buffers(1, &(l->light_buffer));
+		delete_buffers(1, &(l->cluster_buffer));
+		delete_buffers(1, &(l->index_buffer));
+	}
+	free32(l->light_x);
+	free32(l->light_y);
+	free32(l->light_z);
+	free32(l->light_radius);
+	free32(l->light_range);
+	free(l->light_data);
+	delete_DA(l->lights);
+	delete_DA(l->free_lights);
+	delete_framebuffers(1, &(l->shadowMapFBO));
+	delete_textures(1, &(l->shadowMap));
+	delete_framebuffers(1, &(l->staticShadowMapFBO));
+	delete_textures(1, &(l->staticShadowMap));
+	delete_vertex_arrays(1, &(l->quadvao));
+	delete_buffers(1, &(l->quadvbo));
+	delete_buffers(1, &(l->quadebo));
+	delete_textures(1, &(l->noiseTexture));
+	delete_buffers(1, &(l->lighting_ubo));
+	delete_buffers(1, &(l->fog_ubo));
+	delete_buffers(1, &(l->postprocess_ubo));
+	delete_buffers(1, &(l->ssao_ubo));
+	delete_framebuffers(1, &(l->outputfbo));
+	glDeleteRenderbuffers(1, &(l->outputcolor));
+	glDeleteRenderbuffers(1, &(l->outputdepth));
 	free32(l);
 }
\ No newline at end of file
@@ -4,6 +4,93 @@
 #include "dynamic.h"
 #include "camera.h"
 #include "br_texture.h"
+#include "shaders.h"
+#include "frame_graph.h"
+#include "threading.h"
+
+// far cascades are cached until camera leaves this part of their radius
+#define SHADOW_CACHE_MARGIN 0.25f
+
+// std140 layouts of the uniform blocks in shaders
+typedef struct lighting_block
+{
+	mat4 lightProjection[4];
+	vec4 lightColor;
+	vec3 lightDir;
+	float ambient;
+	float specularStrength;
+	float cascade0range;
+	float cascade1range;
+	float cascade2range;
+	float cascade3range;
+	vec4 cascadeRect[4]; // xy offset and zw size of every cascade in the atlas, in [0-1]
+	vec4 clusterParams;	 // depth slice of a light cluster is log(view depth) * x - y
+} lighting_block;
+
+typedef struct fog_block
+{
+	vec3 fog_color;
+	float fog_start;
+	float fog_end;
+} fog_block;
+
+typedef struct postprocess_block
+{
+	vec2 screenResolution;
+	vec2 renderScale; // part of the targets scene passes rendered into
+	vec2 ssaoScale;		// same for ssao targets
+	int vignette;
+	int kernel;
+	int wave;
+	int inverse;
+	int fxaa;
+} postprocess_block;
+
+// ssao argument of create_lighting, lower levels run at a fraction of the window with fewer samples
+// and are upsampled in the deferred pass by depth and normal
+#define SSAO_OFF 0
+#define SSAO_FULL 1		 // 64 samples on every pixel
+#define SSAO_HALF 2		 // half resolution, 16 samples
+#define SSAO_QUARTER 3 // quarter resolution, 8 samples
+
+typedef struct ssao_block
+{
+	vec4 samples[64]; // vec3 arrays have a 16 byte stride in std140
+	vec2 noiseScale; // sample count is a define of the ssao program variant
+} ssao_block;
+
+// point and spot lights are assigned to clusters, screen tiles split into exponential depth slices.
+// only the deferred pass shades them and only the lights of the cluster a pixel is in
+#define LIGHT_CLUSTER_X 16
+#define LIGHT_CLUSTER_Y 9
+#define LIGHT_CLUSTER_Z 24
+#define LIGHT_CLUSTERS (LIGHT_CLUSTER_X * LIGHT_CLUSTER_Y * LIGHT_CLUSTER_Z)
+#define LIGHT_CLUSTER_THREADS 4				// depth slices are split between this many threads, the caller is one of them
+#define LIGHT_CLUSTER_MIN_PARALLEL 64 // fewer visible lights than this are assigned on the calling thread alone
+
+// first 12 floats are the 3 texels of a light in lightData of deferred_br.fs
+typedef struct point_light
+{
+	vec3 position;
+	float radius; // light fades to nothing at radius
+	vec3 color;		// intensity is in the color, it can go above 1
+	float cos_inner;
+	vec3 direction; // spot lights light inside the cone of cos_outer, fully inside cos_inner
+	float cos_outer; // -2 for point lights
+	unsigned char active;
+} point_light;
+
+struct lighting;
+
+typedef struct light_cluster_job
+{
+	struct lighting *l;
+	int first_slice, last_slice; // depth slices [first_slice, last_slice) of this job
+	GLuint *indices;						 // visible light indices of its clusters one cluster after another
+	unsigned int index_count, index_capacity;
+	Thread *thread; // 0 for the job of the calling thread
+	Semaphore *start;
+} light_cluster_job;
 
 typedef struct lighting
 {
@@ -18,8 +105,30 @@ typedef struct lighting
 	vec3 up;
 	float ambient;
 	float specularStrength;
+	// cascades are squares of their own size in one depth atlas of shadowMapWidth x shadowMapHeight
 	GLuint shadowMapFBO, shadowMapWidth, shadowMapHeight, shadowMap;
+	GLuint cascadeSize[4];
+	GLint cascadeOffset[4][2];
+	GLenum shadowDepthFormat;
+	// terrain is drawn into staticShadowMap only for cascades in shadow_dirty, shadowMap is a copy of it
+	// with dynamic objects drawn on top
+	GLuint staticShadowMapFBO, staticShadowMap;
+	vec3 cacheCenter[4]; // snapped light space center of the slice each cascade was drawn for
+	vec3 cacheLightDir;
+	unsigned char shadow_dirty; // bit for every cascade that is drawn again this frame
+	unsigned char shadow_invalid; // everything is drawn again on next update_lighting
+	unsigned char shadow_round_robin; // refresh one far cascade every frame even if it is still valid
+	int shadow_refresh_next;
+	GLint dynamicRect[4][4]; // atlas texels dynamic objects covered last frame, they are restored from static map
+	unsigned char shadow_draw; // cascades the current shadow pass draws into
+	GLuint shadow_cascade_program;
+	GLint shadow_cascade_uniform;
 	int windowwidth, windowheight;
+	// targets are allocated at window size, scene passes use renderwidth x renderheight of them
+	int renderwidth, renderheight;
+	float resolution_scale;
+	float min_resolution_scale;
+	double target_frame_ms; // 0 keeps resolution_scale as it is
 	mat4 orthgonalProjection;
 	mat4 lightView;
 	mat4 lightProjection[4];
@@ -35,43 +144,123 @@ typedef struct lighting
 	float minZ;
 	float maxZ;
 	vec4 tmp;
-	DA *programs; // i will save uniforms here. i wont find their locations everytime i render for performance
-	DA *uniforms;
+	GLuint lighting_ubo, fog_ubo, postprocess_ubo, ssao_ubo; // written in update_lighting, bound to fixed bindings
+	unsigned char fog; // deferred pass blends into fog_color between fog_start and fog_end
 	float fog_start;
 	float fog_end;
 	vec3 fog_color;
-	GLuint gbufferFBO, gPosition, gNormal, gTexCoord, gdepth, quadvbo, quadvao, quadebo, gTexCoordcopy;
-	GLuint ssaofbo, ssaobuffer, ssaoblurfbo, ssaoblurbuffer;
+	// gbuffer is octahedral normal in rg16, albedo in rgb8 and depth, positions are rebuilt from depth.
+	// targets are frame graph resources, textures are the ones the graph gave them this frame
+	unsigned int gnormal_target, gtexcoord_target, gdepth_target, ssao_target, ssaoblur_target, deferred_target, shadow_target;
+	GLuint gNormal, gTexCoord, gdepth, quadvbo, quadvao, quadebo;
+	GLuint ssaobuffer, ssaoblurbuffer;
+	unsigned char ssao; // SSAO_OFF, SSAO_FULL, SSAO_HALF or SSAO_QUARTER
+	// ssao targets are window size / ssao_divisor, ssaorenderwidth x ssaorenderheight of them is used
+	int ssao_divisor;
+	int ssaowidth, ssaoheight, ssaorenderwidth, ssaorenderheight;
 	vec3 ssaoKernel[64];
 	vec3 ssaoNoise[16];
 	GLuint noiseTexture;
 	vec2 noiseScale;
 	int has_ssao;
-	GLuint deferredfbo, deferredtexture;
+	GLuint deferredtexture;
+	GLuint outputfbo, outputcolor, outputdepth; // post process target, 0 is the window
 	int vignette_pp, kernel_pp, wave_pp, inverse_pp;
 	int fxaa;
+	DA *lights;			 // point_light, the id of a light is its index
+	DA *free_lights; // ids of removed lights, reused before lights grows
+	unsigned int light_count;
+	// lights in front of the camera this frame in view space, padded to 8 for simd
+	float *light_x, *light_y, *light_z, *light_radius;
+	// first and last cluster x, y and z every visible light touches, six arrays of visible_light_capacity
+	int *light_range;
+	float *light_data; // point_light texels of visible lights
+	unsigned int visible_light_count, visible_light_capacity;
+	float cluster_planes_x[LIGHT_CLUSTER_X + 1][2]; // x and z of view space normals of planes between tile columns
+	float cluster_planes_y[LIGHT_CLUSTER_Y + 1][2]; // y and z of the ones between tile rows
+	float cluster_slices[LIGHT_CLUSTER_Z + 1];			// view depth every slice starts at
+	vec4 cluster_params;
+	GLuint *cluster_data; // offset into indices and light count of every cluster
+	light_cluster_job cluster_jobs[LIGHT_CLUSTER_THREADS];
+	Semaphore *cluster_done;
+	unsigned char cluster_quit;
+	// texture buffers of lightData, lightClusters and lightIndices
+	GLuint light_buffer, light_texture, cluster_buffer, cluster_texture, index_buffer, index_texture;
 } lighting;
 
 void calculate_lighting_projection(lighting *l, int step);
 
-lighting *create_lighting(GLFWwindow *window, camera *cam, GLuint shadowMapWidth, GLuint shadowMapHeight, float cascade0range,
+// calculates cascade projections, assigns lights to clusters and writes every uniform block once per frame,
+// call it after camera moves and before visibility and render passes
+void update_lighting(lighting *l);
+
+// moves resolution_scale towards target_frame_ms, call it before update_lighting.
+// frame_ms should not include time the frame pacer slept or a lower fps target would lower the resolution
+void update_lighting_resolution(lighting *l, double frame_ms);
+
+// cascadeSizes should not grow from near to far cascades, shadowDepthFormat is GL_DEPTH_COMPONENT16, 24 or 32F
+lighting *create_lighting(GLFWwindow *window, camera *cam, GLuint *cascadeSizes, GLenum shadowDepthFormat, float cascade0range,
 													float cascade1range, float cascade2range, float cascade3range, float fog_start, float fog_end,
 													vec3 fog_color, unsigned char deferred, unsigned char ssao);
 
-void use_lighting_shadowpass(lighting *l, GLuint program);
+// returns 0 if every cascade is cached, then static casters dont need to be drawn
+unsigned char use_lighting_shadowpass(lighting *l, GLuint program);
+
+// call it every frame after static casters. copies static cascades into shadowMap, then dynamic objects
+// inside the sphere can be drawn on top
+void use_lighting_shadowpass_dynamic(lighting *l, GLuint program, vec3 center, float radius);
+
+// every cascade is drawn separately, returns 0 if current shadow pass has nothing to draw into this cascade
+unsigned char use_lighting_shadow_cascade(lighting *l, GLuint program, int cascade);
+
+// static casters changed, every cascade is drawn again next frame
+void invalidate_shadow_cache(lighting *l);
 
 void use_lighting_forward(lighting *l, GLuint program);
 
 void use_lighting_gbuffer(lighting *l, GLuint program, unsigned char clear);
 
+// water goes into the same gbuffer, its albedo is alpha blended over what is already there
+void use_lighting_gbuffer_blend(lighting *l, GLuint program);
+
+// program variants matching the current flags, see shaders.h
+unsigned int get_lighting_deferred_variant(lighting *l);
+
+unsigned int get_lighting_ssao_variant(lighting *l);
+
+unsigned int get_lighting_postprocess_variant(lighting *l);
+
+// declares render targets in a reset graph, passes using them are added after this
+void add_lighting_targets(lighting *l, frame_graph *g);
+
+// call after compile_frame_graph
+void get_lighting_targets(lighting *l, frame_graph *g);
+
+// gbuffer, ssao and deferred passes draw into the framebuffer the frame graph bound for them
 void use_lighting_deferred(lighting *l, GLuint program);
 
 void use_lighting_postprocess(lighting *l, GLuint program);
 
+// post process and everything after it goes into an offscreen framebuffer of window size instead of the window
+void create_lighting_offscreen(lighting *l);
+
 void use_lighting_ssao(lighting *l, GLuint program);
 
 void use_lighting_ssao_blur(lighting *l, GLuint program);
 
-void delete_lighting(lighting *l);
+// lights are read by update_lighting, change them on the thread that renders. returns the id of the light
+unsigned int add_lighting_point_light(lighting *l, vec3 position, vec3 color, float radius);
+
+// angles are half angles of the cone in degrees, light fades out between inner_angle and outer_angle
+unsigned int add_lighting_spot_light(lighting *l, vec3 position, vec3 direction, vec3 color, float radius, float inner_angle,
+																		 float outer_angle);
+
+void set_lighting_light_position(lighting *l, unsigned int id, vec3 position);
+
+void set_lighting_light_color(lighting *l, unsigned int id, vec3 color);
+
+void set_lighting_light_direction(lighting *l, unsigned int id, vec3 direction);
+
+void remove_lighting_light(lighting *l, unsigned int id);
 
-void lighting_set_uniforms(lighting *l, GLuint program);
\ No newline at end of file
+void delete_lighting(lighting *l);
\ No newline at end of file
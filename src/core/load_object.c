@@ -36,7 +36,7 @@ void replaceChar(char *str, char oldChar, char newChar)
 }
 
 br_scene load_object_br(br_object_manager *obj_manager, br_texture_manager *text_manager,
-												struct aiScene *scene, float texture_start_index, unsigned char has_physics,
+												struct aiScene *scene, unsigned char has_physics,
 												unsigned char priority, float mass, float friction, float bounce)
 {
 	br_scene res;
@@ -50,8 +50,11 @@ br_scene load_object_br(br_object_manager *obj_manager, br_texture_manager *text
 	res.texture_count = scene->mNumMaterials;
 	res.textures = (br_texture **)malloc(sizeof(br_texture *) * res.texture_count);
 	res.meshes = (br_object **)malloc(sizeof(br_object *) * res.mesh_count);
+	// every material is at most one layer, arrays dont have to grow while they load
+	reserve_br_texture_layers(text_manager, scene->mNumMaterials);
 	for (unsigned int i = 0; i < scene->mNumMaterials; i++)
 	{
+		res.textures[i] = 0;
 		struct aiString texturePath = {0};
 		struct aiColor4D diffuseColor = {0};
 		if (aiGetMaterialTexture(scene->mMaterials[i], aiTextureType_DIFFUSE, 0, &texturePath, 0, 0, 0, 0, 0, 0) == aiReturn_SUCCESS)
@@ -78,8 +81,8 @@ br_scene load_object_br(br_object_manager *obj_manager, br_texture_manager *text
 						data[j * 4 + 2] = scene->mTextures[k]->pcData[j].b;
 						data[j * 4 + 3] = scene->mTextures[k]->pcData[j].a;
 					}
-					res.textures[i] = create_br_texture_memory(text_manager, data, width, height, GL_TEXTURE_2D, GL_NEAREST,
-																										 GL_NEAREST, (int)texture_start_index + (int)i, GL_REPEAT, GL_REPEAT);
+					res.textures[i] = create_br_texture_memory(text_manager, data, width, height, GL_NEAREST, GL_NEAREST,
+																										 GL_REPEAT, GL_REPEAT);
 					free(data);
 					break;
 				}
@@ -89,8 +92,7 @@ br_scene load_object_br(br_object_manager *obj_manager, br_texture_manager *text
 				char ext_path[1024] = {0};
 				sprintf(ext_path, "./models/%s", texturePath.data);
 				replaceChar(ext_path, '\\', '/');
-				res.textures[i] = create_br_texture(text_manager, ext_path, GL_TEXTURE_2D, GL_NEAREST, GL_NEAREST,
-																						(int)texture_start_index + (int)i, GL_REPEAT, GL_REPEAT);
+				res.textures[i] = create_br_texture(text_manager, ext_path, GL_NEAREST, GL_NEAREST, GL_REPEAT, GL_REPEAT);
 			}
 		}
 		else if (aiGetMaterialColor(scene->mMaterials[i], AI_MATKEY_COLOR_DIFFUSE, &diffuseColor) == AI_SUCCESS)
@@ -100,13 +102,14 @@ br_scene load_object_br(br_object_manager *obj_manager, br_texture_manager *text
 			data[1] = (unsigned char)max(0, min(255, (int)floorf(diffuseColor.g * 256.0f)));
 			data[2] = (unsigned char)max(0, min(255, (int)floorf(diffuseColor.b * 256.0f)));
 			data[3] = (unsigned char)max(0, min(255, (int)floorf(diffuseColor.a * 256.0f)));
-			res.textures[i] = create_br_texture_memory(text_manager, data, 1, 1, GL_TEXTURE_2D, GL_NEAREST,
-																								 GL_NEAREST, (int)texture_start_index + (int)i, GL_REPEAT, GL_REPEAT);
+			res.textures[i] = create_br_texture_memory(text_manager, data, 1, 1, GL_NEAREST, GL_NEAREST, GL_REPEAT, GL_REPEAT);
 		}
 	}
 	for (unsigned int i = 0; i < scene->mNumMeshes; i++)
 	{
 		unsigned int vertex_number = scene->mMeshes[i]->mNumVertices;
+		br_texture *texture = res.textures[scene->mMeshes[i]->mMaterialIndex];
+		GLfloat material = texture != 0 ? texture->material : 0;
 		GLfloat *vertices = (GLfloat *)malloc(sizeof(GLfloat) * vertex_number * 9);
 		for (unsigned int k = 0; k < vertex_number; k++)
 		{
@@ -121,7 +124,7 @@ br_scene load_object_br(br_object_manager *obj_manager, br_texture_manager *text
 			vertices[k * 9 + 6] = scene->mMeshes[i]->mNormals[k].y;
 			vertices[k * 9 + 7] = scene->mMeshes[i]->mNormals[k].z;
 
-			vertices[k * 9 + 8] = scene->mMeshes[i]->mMaterialIndex + texture_start_index;
+			vertices[k * 9 + 8] = material;
 		}
 		unsigned int indice_number = 0;
 		for (unsigned int k = 0; k < scene->mMeshes[i]->mNumFaces; k++)
@@ -139,7 +142,7 @@ br_scene load_object_br(br_object_manager *obj_manager, br_texture_manager *text
 			}
 		}
 		res.meshes[i] = create_br_object(obj_manager, vertices, vertex_number, indices, indice_number,
-																		 scene->mMeshes[i]->mMaterialIndex + texture_start_index,
+																		 material,
 																		 has_physics, priority, mass, friction, bounce);
 		free(vertices);
 		free(indices);
@@ -1,4 +1,5 @@
 #include "object.h"
+#include "gl_state.h"
 #include <stdlib.h>
 
 DA *objects = 0;
@@ -61,7 +62,7 @@ object *create_object(GLfloat *vertices, unsigned int vertex_number, GLenum usag
 		indices = 0;
 		indice_number = 0;
 	}
-	glBindVertexArray(0);
+	bind_vertex_array(0);
 	object *obj = calloc(1, sizeof(object));
 	glGenVertexArrays(1, &(obj->VAO));
 	glGenBuffers(1, &(obj->VBO));
@@ -69,8 +70,8 @@ object *create_object(GLfloat *vertices, unsigned int vertex_number, GLenum usag
 	{
 		glGenBuffers(1, &(obj->EBO));
 	}
-	glBindVertexArray(obj->VAO);
-	glBindBuffer(GL_ARRAY_BUFFER, obj->VBO);
+	bind_vertex_array(obj->VAO);
+	bind_buffer(GL_ARRAY_BUFFER, obj->VBO);
 	if (!is_tex_vertex)
 	{
 		if (!is_norm_vertex)
@@ -133,12 +134,12 @@ object *create_object(GLfloat *vertices, unsigned int vertex_number, GLenum usag
 	}
 	if (indices != 0 && indice_number != 0)
 	{
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, obj->EBO);
+		bind_buffer(GL_ELEMENT_ARRAY_BUFFER, obj->EBO);
 		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indice_number * sizeof(GLuint), indices, GL_STATIC_DRAW);
 	}
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindVertexArray(0);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	bind_buffer(GL_ARRAY_BUFFER, 0);
+	bind_vertex_array(0);
+	bind_buffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 	obj->vertex_number = vertex_number;
 	obj->indice_number = indice_number;
 	glm_mat4_copy(GLM_MAT4_IDENTITY, obj->model);
@@ -249,9 +250,9 @@ void delete_object(object *obj)
 		delete_physic(obj->phy);
 		if (obj->copy == 0)
 		{
-			glDeleteVertexArrays(1, &(obj->VAO));
-			glDeleteBuffers(1, &(obj->VBO));
-			glDeleteBuffers(1, &(obj->EBO));
+			delete_vertex_arrays(1, &(obj->VAO));
+			delete_buffers(1, &(obj->VBO));
+			delete_buffers(1, &(obj->EBO));
 			delete_DA(obj->programs);
 			delete_DA(obj->uniforms);
 		}
@@ -275,7 +276,7 @@ void use_object(object *obj, GLuint program)
 	glm_mat4_inv(obj->model, obj->normal);
 	glm_mat4_transpose(obj->normal);
 	glUniformMatrix4fv(uniforms[index * 2 + 1], 1, GL_FALSE, obj->normal[0]);
-	glBindVertexArray(obj->VAO);
+	bind_vertex_array(obj->VAO);
 	if (obj->indice_number == 0)
 	{
 		glDrawArrays(GL_TRIANGLES, 0, obj->vertex_number);
@@ -284,7 +285,6 @@ void use_object(object *obj, GLuint program)
 	{
 		glDrawElements(GL_TRIANGLES, obj->indice_number, GL_UNSIGNED_INT, 0);
 	}
-	glBindVertexArray(0);
 }
 
 object *create_object_copy(object *obj, unsigned char has_physics)
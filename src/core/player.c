@@ -25,7 +25,7 @@ player *create_player(camera *fp_camera, float speed, float jumpspeed, float air
   p->phy = create_player_jolt(p->height, p->width / 2, maxslopeangle, maxstrength, mass, start_pos);
   {
     struct aiScene *player_model = load_model(modelpath, 1);
-    br_scene player = load_object_br(p->model, p->textures, player_model, 0, 0, 3, 10, 0.1f, 0.5f);
+    br_scene player = load_object_br(p->model, p->textures, player_model, 0, 3, 10, 0.1f, 0.5f);
 
     if (scaleall0_scaleonlyheight1 == 0)
     {
@@ -210,8 +210,22 @@ void run_input_player(player *p, GLFWwindow *window, double framems, unsigned ch
   }
 }
 
-void render_player(player *p, GLuint program)
+void snapshot_player(player *p, player_snapshot *s)
 {
-  use_br_texture_manager(p->textures, program);
-  use_br_object_manager(p->model, program);
+  br_object_manager *m = p->model;
+  glm_mat4_mulN((mat4 *[]){&m->translation, &m->rotation, &m->scale}, 3, s->model);
+  if (p->phy != 0)
+  {
+    get_position_player_jolt(p->phy, s->position);
+  }
+  else
+  {
+    glm_vec3_copy(p->fp_camera->position, s->position);
+  }
+}
+
+void render_player(player *p, player_snapshot *s, GLuint program)
+{
+  use_br_texture_manager(p->textures, 0);
+  use_br_object_manager_model(p->model, program, s->model);
 }
\ No newline at end of file
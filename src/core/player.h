@@ -26,6 +26,13 @@ typedef struct player
   br_texture_manager *textures;
 } player;
 
+// what rendering needs of a player, taken after its simulation so it can be drawn while the next one runs
+typedef struct player_snapshot
+{
+  mat4 model;
+  vec3 position; // physics position, not the camera
+} player_snapshot;
+
 player *create_player(camera *fp_camera, float speed, float jumpspeed, float airspeedfactor,
                       float boostspeedfactor, float width, float height, int **hm, int dimensionx,
                       int dimensionz, const char *modelpath, float *start_pos, float maxslopeangle,
@@ -35,4 +42,6 @@ void delete_player(player *p);
 
 void run_input_player(player *p, GLFWwindow *window, double framems, unsigned char fp0_tp1);
 
-void render_player(player *p, GLuint program);
+void snapshot_player(player *p, player_snapshot *s);
+
+void render_player(player *p, player_snapshot *s, GLuint program);
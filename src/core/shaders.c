@@ -1,6 +1,17 @@
 #include "shaders.h"
+#include "gl_state.h"
+#include "br_texture.h"
+#include "gl_extensions.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <direct.h>
+#define make_directory(path) _mkdir(path)
+#else
+#include <sys/stat.h>
+#define make_directory(path) mkdir(path, 0755)
+#endif
 
 GLuint def_program = 0;
 GLuint def_tex_program = 0;
@@ -9,13 +20,8 @@ GLuint def_shadowmap_program = 0;
 GLuint def_tex_light_br_program = 0;
 GLuint def_tex_light_opt_br_program = 0;
 GLuint def_shadowmap_br_program = 0;
-GLuint def_tex_light_ins_program = 0;
-GLuint def_shadowmap_ins_program = 0;
 GLuint def_gbuffer_br_program = 0;
-GLuint def_deferred_br_program = 0;
-GLuint def_ssao_program = 0;
 GLuint def_ssao_blur_program = 0;
-GLuint def_post_process_program = 0;
 GLuint def_text_program = 0;
 GLuint def_skybox_program = 0;
 GLuint def_water_program = 0;
@@ -40,88 +46,365 @@ char *get_shader_content(const char *fileName)
 	return shaderContent;
 }
 
+// program cache files are named by a hash of driver and shader sources, a changed shader or driver gets a new file
+#define PROGRAM_CACHE_DIRECTORY "./shader_cache"
+
+// one program being built. builds are started before any of them is checked so drivers
+// with parallel shader compile can work on all of them together
+typedef struct program_build
+{
+	const char *files[3]; // fragment, vertex and optional geometry shader
+	const char *defines;	// lines put after #version of every shader
+	char *sources[3];
+	GLuint shaders[3];
+	GLuint program;
+	unsigned long long hash;
+	unsigned char cached;
+} program_build;
+
+// fnv-1a
+unsigned long long hash_string(unsigned long long hash, const char *str)
+{
+	for (; str != 0 && *str != 0; str++)
+	{
+		hash ^= (unsigned char)*str;
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+void get_program_cache_path(unsigned long long hash, char *path, size_t size)
+{
+	snprintf(path, size, "%s/%016llx.bin", PROGRAM_CACHE_DIRECTORY, hash);
+}
+
+// file is the binary format followed by the binary
+unsigned char load_program_binary(program_build *b)
+{
+	char path[64];
+	get_program_cache_path(b->hash, path, sizeof(path));
+	FILE *fp = fopen(path, "rb");
+	if (fp == 0)
+	{
+		return 0;
+	}
+	fseek(fp, 0L, SEEK_END);
+	long size = ftell(fp) - (long)sizeof(GLenum);
+	fseek(fp, 0L, SEEK_SET);
+	GLenum format = 0;
+	void *binary = size > 0 ? malloc(size) : 0;
+	unsigned char ok = binary != 0 && fread(&format, sizeof(GLenum), 1, fp) == 1 && fread(binary, 1, size, fp) == (size_t)size;
+	fclose(fp);
+	GLint status = GL_FALSE;
+	if (ok)
+	{
+		// driver rejects binaries of another driver version, program is built from sources then
+		glProgramBinary(b->program, format, binary, (GLsizei)size);
+		glGetProgramiv(b->program, GL_LINK_STATUS, &status);
+	}
+	free(binary);
+	return status == GL_TRUE;
+}
+
+void save_program_binary(program_build *b)
+{
+	GLint size = 0;
+	glGetProgramiv(b->program, GL_PROGRAM_BINARY_LENGTH, &size);
+	if (size <= 0)
+	{
+		return;
+	}
+	void *binary = malloc(size);
+	GLenum format = 0;
+	glGetProgramBinary(b->program, size, 0, &format, binary);
+	make_directory(PROGRAM_CACHE_DIRECTORY);
+	char path[64];
+	get_program_cache_path(b->hash, path, sizeof(path));
+	FILE *fp = fopen(path, "wb");
+	if (fp != 0)
+	{
+		fwrite(&format, sizeof(GLenum), 1, fp);
+		fwrite(binary, 1, size, fp);
+		fclose(fp);
+	}
+	free(binary);
+}
+
+void start_program_build(program_build *b, const char *frag_shader_file, const char *vert_shader_file, const char *geo_shader_file,
+												 const char *defines)
+{
+	const GLenum types[3] = {GL_FRAGMENT_SHADER, GL_VERTEX_SHADER, GL_GEOMETRY_SHADER};
+	b->files[0] = frag_shader_file;
+	b->files[1] = vert_shader_file;
+	b->files[2] = geo_shader_file;
+	b->defines = defines;
+	b->program = 0;
+	b->cached = 0;
+	b->hash = 14695981039346656037ULL;
+	b->hash = hash_string(b->hash, (const char *)glGetString(GL_VENDOR));
+	b->hash = hash_string(b->hash, (const char *)glGetString(GL_RENDERER));
+	b->hash = hash_string(b->hash, (const char *)glGetString(GL_VERSION));
+	b->hash = hash_string(b->hash, defines);
+	for (int i = 0; i < 3; i++)
+	{
+		b->shaders[i] = 0;
+		b->sources[i] = b->files[i] != 0 ? get_shader_content(b->files[i]) : 0;
+		b->hash = hash_string(b->hash, b->files[i]);
+		b->hash = hash_string(b->hash, b->sources[i]);
+	}
+	for (int i = 0; i < 3; i++)
+	{
+		if (b->files[i] != 0 && b->sources[i] == 0)
+		{
+			fprintf(stderr, "shader %s can not be read\n", b->files[i]);
+			return;
+		}
+	}
+	b->program = glCreateProgram();
+	if (has_program_binary && load_program_binary(b))
+	{
+		b->cached = 1;
+		return;
+	}
+	for (int i = 0; i < 3; i++)
+	{
+		if (b->sources[i] == 0)
+		{
+			continue;
+		}
+		b->shaders[i] = glCreateShader(types[i]);
+		// #version has to stay the first line, defines go right after it
+		const char *newline = strchr(b->sources[i], '\n');
+		if (b->defines != 0 && newline != 0)
+		{
+			const char *parts[3] = {b->sources[i], b->defines, newline + 1};
+			GLint lengths[3] = {(GLint)(newline + 1 - b->sources[i]), -1, -1};
+			glShaderSource(b->shaders[i], 3, parts, lengths);
+		}
+		else
+		{
+			glShaderSource(b->shaders[i], 1, (const char *const *)&b->sources[i], 0);
+		}
+		glCompileShader(b->shaders[i]);
+		glAttachShader(b->program, b->shaders[i]);
+	}
+	if (has_program_binary)
+	{
+		glProgramParameteri(b->program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+	glLinkProgram(b->program);
+}
+
+// waits for the build, prints errors with file names and returns 0 if it failed
+GLuint finish_program_build(program_build *b)
+{
+	char log[1024];
+	if (b->program != 0 && !b->cached)
+	{
+		GLint status = GL_FALSE;
+		for (int i = 0; i < 3; i++)
+		{
+			if (b->shaders[i] == 0)
+			{
+				continue;
+			}
+			glGetShaderiv(b->shaders[i], GL_COMPILE_STATUS, &status);
+			if (status != GL_TRUE)
+			{
+				glGetShaderInfoLog(b->shaders[i], sizeof(log), 0, log);
+				fprintf(stderr, "shader %s can not be compiled:\n%s\n", b->files[i], log);
+			}
+		}
+		glGetProgramiv(b->program, GL_LINK_STATUS, &status);
+		if (status != GL_TRUE)
+		{
+			glGetProgramInfoLog(b->program, sizeof(log), 0, log);
+			fprintf(stderr, "program %s %s can not be linked:\n%s\n", b->files[1], b->files[0], log);
+			delete_program(b->program);
+			b->program = 0;
+		}
+		else if (has_program_binary)
+		{
+			save_program_binary(b);
+		}
+	}
+	for (int i = 0; i < 3; i++)
+	{
+		if (b->shaders[i] != 0)
+		{
+			glDeleteShader(b->shaders[i]);
+		}
+		free(b->sources[i]);
+	}
+	if (b->program != 0)
+	{
+		set_program_bindings(b->program);
+	}
+	return b->program;
+}
+
 GLuint compile_program(const char *frag_shader_file, const char *vert_shader_file, const char *geo_shader_file)
 {
-	char *vertexShaderSource = get_shader_content(vert_shader_file);
-	char *fragmentShaderSource = get_shader_content(frag_shader_file);
-	char *geoshadersource = 0;
-	if (geo_shader_file != 0)
+	program_build b;
+	start_program_build(&b, frag_shader_file, vert_shader_file, geo_shader_file, 0);
+	return finish_program_build(&b);
+}
+
+// a program with #define permutations, a variant is a mask of defines and is built the first time it is used.
+// binary cache makes later runs load them instead of compiling in the middle of a frame
+#define PROGRAM_VARIANT_DEFINES 5
+
+typedef struct program_variants
+{
+	const char *files[3];
+	const char *defines[PROGRAM_VARIANT_DEFINES];
+	GLuint programs[1 << PROGRAM_VARIANT_DEFINES];
+	unsigned char built[1 << PROGRAM_VARIANT_DEFINES]; // failed builds are not tried again
+} program_variants;
+
+program_variants deferred_br_variants = {{"./shaders/deferred_br.fs", "./shaders/deferred_br.vs", 0}, {"SSAO", "SSAO_UPSAMPLE", "FOG", "POINT_LIGHTS"}};
+program_variants ssao_variants = {{"./shaders/ssao.fs", "./shaders/deferred_br.vs", 0}, {"SAMPLES_16", "SAMPLES_8"}};
+program_variants post_process_variants = {{"./shaders/post_process.fs", "./shaders/deferred_br.vs", 0},
+																					{"VIGNETTE", "KERNEL", "WAVE", "INVERSE", "FXAA"}};
+// variant is the INS_FORMAT of the manager
+program_variants tex_light_ins_variants = {{"./shaders/def_tex_light_br.fs", "./shaders/def_tex_light_ins.vs", 0}, {"INS_PACKED", "INS_VOXEL"}};
+program_variants shadowmap_ins_variants = {{"./shaders/def_shadowmap.fs", "./shaders/def_shadowmap_ins.vs", 0}, {"INS_PACKED", "INS_VOXEL"}};
+
+GLuint get_program_variant(program_variants *v, unsigned int variant)
+{
+	variant &= (1 << PROGRAM_VARIANT_DEFINES) - 1;
+	if (v->built[variant])
 	{
-		geoshadersource = get_shader_content(geo_shader_file);
+		return v->programs[variant];
 	}
-	GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-	glShaderSource(vertexShader, 1, (const char *const *)&vertexShaderSource, 0);
-	glCompileShader(vertexShader);
-	GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-	glShaderSource(fragmentShader, 1, (const char *const *)&fragmentShaderSource, 0);
-	glCompileShader(fragmentShader);
-	GLuint geoshader = 0;
-	if (geo_shader_file != 0)
+	char defines[256];
+	int length = 0;
+	defines[0] = 0;
+	for (int i = 0; i < PROGRAM_VARIANT_DEFINES; i++)
 	{
-		geoshader = glCreateShader(GL_GEOMETRY_SHADER);
-		glShaderSource(geoshader, 1, (const char *const *)&geoshadersource, 0);
-		glCompileShader(geoshader);
+		if ((variant & (1 << i)) && v->defines[i] != 0)
+		{
+			length += snprintf(defines + length, sizeof(defines) - length, "#define %s\n", v->defines[i]);
+		}
 	}
-	GLuint shaderProgram = glCreateProgram();
-	glAttachShader(shaderProgram, vertexShader);
-	glAttachShader(shaderProgram, fragmentShader);
-	if (geo_shader_file != 0)
+	program_build b;
+	start_program_build(&b, v->files[0], v->files[1], v->files[2], defines);
+	v->programs[variant] = finish_program_build(&b);
+	v->built[variant] = 1;
+	return v->programs[variant];
+}
+
+void delete_program_variants(program_variants *v)
+{
+	for (int i = 0; i < 1 << PROGRAM_VARIANT_DEFINES; i++)
+	{
+		if (v->built[i])
+		{
+			delete_program(v->programs[i]);
+		}
+		v->programs[i] = 0;
+		v->built[i] = 0;
+	}
+}
+
+void set_block_binding(GLuint program, const char *name, GLuint binding)
+{
+	GLuint index = glGetUniformBlockIndex(program, name);
+	if (index != GL_INVALID_INDEX)
 	{
-		glAttachShader(shaderProgram, geoshader);
+		glUniformBlockBinding(program, index, binding);
 	}
-	glLinkProgram(shaderProgram);
-	glDeleteShader(vertexShader);
-	glDeleteShader(fragmentShader);
-	if (geo_shader_file != 0)
+}
+
+void set_sampler_unit(GLuint program, const char *name, GLint unit)
+{
+	GLint uniform = glGetUniformLocation(program, name);
+	if (uniform != -1)
 	{
-		glDeleteShader(geoshader);
+		glUniform1i(uniform, unit);
 	}
-	free(vertexShaderSource);
-	free(fragmentShaderSource);
-	free(geoshadersource);
-	return shaderProgram;
+}
+
+void set_program_bindings(GLuint program)
+{
+	set_block_binding(program, "camera_block", CAMERA_BLOCK_BINDING);
+	set_block_binding(program, "lighting_block", LIGHTING_BLOCK_BINDING);
+	set_block_binding(program, "fog_block", FOG_BLOCK_BINDING);
+	set_block_binding(program, "postprocess_block", POSTPROCESS_BLOCK_BINDING);
+	set_block_binding(program, "ssao_block", SSAO_BLOCK_BINDING);
+
+	// texture units used by lighting passes never change
+	use_program(program);
+	set_sampler_unit(program, "shadowMap", 31);
+	set_sampler_unit(program, "texNoise", 31);
+	set_sampler_unit(program, "ssaoInput", 31);
+	set_sampler_unit(program, "deferred", 31);
+	set_sampler_unit(program, "gDepth", 30);
+	set_sampler_unit(program, "gNormal", 29);
+	set_sampler_unit(program, "gTexCoord", 28);
+	set_sampler_unit(program, "ssao", 27);
+	set_sampler_unit(program, "lightData", 26);
+	set_sampler_unit(program, "lightClusters", 25);
+	set_sampler_unit(program, "lightIndices", 24);
+	// the br_texture array of a draw is bound to unit 0
+	set_sampler_unit(program, "materials", 0);
+	use_program(0);
 }
 
 void init_programs(void)
 {
-	def_program = compile_program("./shaders/def.fs", "./shaders/def.vs", 0);
-	def_tex_program = compile_program("./shaders/def_tex.fs", "./shaders/def_tex.vs", 0);
-	def_tex_light_program = compile_program("./shaders/def_tex_light.fs", "./shaders/def_tex_light.vs", 0);
-	def_shadowmap_program = compile_program("./shaders/def_shadowmap.fs", "./shaders/def_shadowmap.vs", "./shaders/def_shadowmap.gs");
-	def_tex_light_br_program = compile_program("./shaders/def_tex_light_br.fs", "./shaders/def_tex_light_br.vs", 0);
-	def_tex_light_opt_br_program = compile_program("./shaders/def_tex_light_opt_br.fs", "./shaders/def_tex_light_opt_br.vs", 0);
-	def_shadowmap_br_program = compile_program("./shaders/def_shadowmap.fs", "./shaders/def_shadowmap_br.vs", "./shaders/def_shadowmap.gs");
-	def_tex_light_ins_program = compile_program("./shaders/def_tex_light_br.fs", "./shaders/def_tex_light_ins.vs", 0);
-	def_shadowmap_ins_program = compile_program("./shaders/def_shadowmap.fs", "./shaders/def_shadowmap_ins.vs", "./shaders/def_shadowmap.gs");
-	def_gbuffer_br_program = compile_program("./shaders/gbuffer_br.fs", "./shaders/gbuffer_br.vs", 0);
-	def_deferred_br_program = compile_program("./shaders/deferred_br.fs", "./shaders/deferred_br.vs", 0);
-	def_ssao_program = compile_program("./shaders/ssao.fs", "./shaders/deferred_br.vs", 0);
-	def_ssao_blur_program = compile_program("./shaders/ssao_blur.fs", "./shaders/deferred_br.vs", 0);
-	def_post_process_program = compile_program("./shaders/post_process.fs", "./shaders/deferred_br.vs", 0);
-	def_text_program = compile_program("./shaders/text.fs", "./shaders/text.vs", 0);
-	def_skybox_program = compile_program("./shaders/skybox.fs", "./shaders/skybox.vs", 0);
-	def_water_program = compile_program("./shaders/water.fs", "./shaders/water.vs", 0);
+	if (has_parallel_shader_compile)
+	{
+		// let the driver pick the thread count
+		glMaxShaderCompilerThreadsKHR(0xffffffff);
+	}
+	// deferred, ssao, post process and instanced programs are program_variants, they are built when a variant is first used
+	program_build builds[12];
+	start_program_build(&builds[0], "./shaders/def.fs", "./shaders/def.vs", 0, 0);
+	start_program_build(&builds[1], "./shaders/def_tex.fs", "./shaders/def_tex.vs", 0, 0);
+	start_program_build(&builds[2], "./shaders/def_tex_light.fs", "./shaders/def_tex_light.vs", 0, 0);
+	start_program_build(&builds[3], "./shaders/def_shadowmap.fs", "./shaders/def_shadowmap.vs", 0, 0);
+	start_program_build(&builds[4], "./shaders/def_tex_light_br.fs", "./shaders/def_tex_light_br.vs", 0, 0);
+	start_program_build(&builds[5], "./shaders/def_tex_light_opt_br.fs", "./shaders/def_tex_light_opt_br.vs", 0, 0);
+	start_program_build(&builds[6], "./shaders/def_shadowmap.fs", "./shaders/def_shadowmap_br.vs", 0, 0);
+	start_program_build(&builds[7], "./shaders/gbuffer_br.fs", "./shaders/gbuffer_br.vs", 0, 0);
+	start_program_build(&builds[8], "./shaders/ssao_blur.fs", "./shaders/deferred_br.vs", 0, 0);
+	start_program_build(&builds[9], "./shaders/text.fs", "./shaders/text.vs", 0, 0);
+	start_program_build(&builds[10], "./shaders/skybox.fs", "./shaders/skybox.vs", 0, 0);
+	start_program_build(&builds[11], "./shaders/water.fs", "./shaders/water.vs", 0, 0);
+	def_program = finish_program_build(&builds[0]);
+	def_tex_program = finish_program_build(&builds[1]);
+	def_tex_light_program = finish_program_build(&builds[2]);
+	def_shadowmap_program = finish_program_build(&builds[3]);
+	def_tex_light_br_program = finish_program_build(&builds[4]);
+	def_tex_light_opt_br_program = finish_program_build(&builds[5]);
+	def_shadowmap_br_program = finish_program_build(&builds[6]);
+	def_gbuffer_br_program = finish_program_build(&builds[7]);
+	def_ssao_blur_program = finish_program_build(&builds[8]);
+	def_text_program = finish_program_build(&builds[9]);
+	def_skybox_program = finish_program_build(&builds[10]);
+	def_water_program = finish_program_build(&builds[11]);
 }
 
 void destroy_programs(void)
 {
-	glDeleteProgram(def_program);
-	glDeleteProgram(def_tex_program);
-	glDeleteProgram(def_tex_light_program);
-	glDeleteProgram(def_shadowmap_program);
-	glDeleteProgram(def_tex_light_br_program);
-	glDeleteProgram(def_tex_light_opt_br_program);
-	glDeleteProgram(def_shadowmap_br_program);
-	glDeleteProgram(def_tex_light_ins_program);
-	glDeleteProgram(def_shadowmap_ins_program);
-	glDeleteProgram(def_gbuffer_br_program);
-	glDeleteProgram(def_deferred_br_program);
-	glDeleteProgram(def_ssao_program);
-	glDeleteProgram(def_ssao_blur_program);
-	glDeleteProgram(def_post_process_program);
-	glDeleteProgram(def_text_program);
-	glDeleteProgram(def_skybox_program);
-	glDeleteProgram(def_water_program);
+	delete_program(def_program);
+	delete_program(def_tex_program);
+	delete_program(def_tex_light_program);
+	delete_program(def_shadowmap_program);
+	delete_program(def_tex_light_br_program);
+	delete_program(def_tex_light_opt_br_program);
+	delete_program(def_shadowmap_br_program);
+	delete_program_variants(&tex_light_ins_variants);
+	delete_program_variants(&shadowmap_ins_variants);
+	delete_program(def_gbuffer_br_program);
+	delete_program_variants(&deferred_br_variants);
+	delete_program_variants(&ssao_variants);
+	delete_program(def_ssao_blur_program);
+	delete_program_variants(&post_process_variants);
+	delete_program(def_text_program);
+	delete_program(def_skybox_program);
+	delete_program(def_water_program);
 }
 
 GLuint get_def_program(void)
@@ -159,14 +442,14 @@ GLuint get_def_shadowmap_br_program(void)
 	return def_shadowmap_br_program;
 }
 
-GLuint get_def_tex_light_ins_program(void)
+GLuint get_def_tex_light_ins_program(unsigned int format)
 {
-	return def_tex_light_ins_program;
+	return get_program_variant(&tex_light_ins_variants, format);
 }
 
-GLuint get_def_shadowmap_ins_program(void)
+GLuint get_def_shadowmap_ins_program(unsigned int format)
 {
-	return def_shadowmap_ins_program;
+	return get_program_variant(&shadowmap_ins_variants, format);
 }
 
 GLuint get_def_gbuffer_br_program(void)
@@ -174,14 +457,14 @@ GLuint get_def_gbuffer_br_program(void)
 	return def_gbuffer_br_program;
 }
 
-GLuint get_def_deferred_br_program(void)
+GLuint get_def_deferred_br_program(unsigned int variant)
 {
-	return def_deferred_br_program;
+	return get_program_variant(&deferred_br_variants, variant);
 }
 
-GLuint get_def_ssao_program(void)
+GLuint get_def_ssao_program(unsigned int variant)
 {
-	return def_ssao_program;
+	return get_program_variant(&ssao_variants, variant);
 }
 
 GLuint get_def_ssao_blur_program(void)
@@ -189,9 +472,9 @@ GLuint get_def_ssao_blur_program(void)
 	return def_ssao_blur_program;
 }
 
-GLuint get_def_post_process_program(void)
+GLuint get_def_post_process_program(unsigned int variant)
 {
-	return def_post_process_program;
+	return get_program_variant(&post_process_variants, variant);
 }
 
 GLuint get_def_text_program(void)
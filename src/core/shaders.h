@@ -1,6 +1,29 @@
 #pragma once
 #include "../../third_party/opengl/include/glad/glad.h"
 
+// uniform blocks shared by every program in /shaders, bound once after linking
+#define CAMERA_BLOCK_BINDING 0
+#define LIGHTING_BLOCK_BINDING 1
+#define FOG_BLOCK_BINDING 2
+#define POSTPROCESS_BLOCK_BINDING 3
+#define SSAO_BLOCK_BINDING 4
+
+// variants of deferred, ssao and post process programs, a mask of these picks the #defines a variant is built with
+#define DEFERRED_SSAO 1					 // ssao ran this frame
+#define DEFERRED_SSAO_UPSAMPLE 2 // ssao is smaller than the g-buffer
+#define DEFERRED_FOG 4
+#define DEFERRED_POINT_LIGHTS 8 // some point or spot light is visible
+#define SSAO_SAMPLES_16 1
+#define SSAO_SAMPLES_8 2
+#define POSTPROCESS_VIGNETTE 1
+#define POSTPROCESS_KERNEL 2
+#define POSTPROCESS_WAVE 4
+#define POSTPROCESS_INVERSE 8
+#define POSTPROCESS_FXAA 16
+
+// binds uniform blocks and sets samplers to their fixed texture units
+void set_program_bindings(GLuint program);
+
 void init_programs(void);
 
 void destroy_programs(void);
@@ -19,19 +42,20 @@ GLuint get_def_tex_light_opt_br_program(void);
 
 GLuint get_def_shadowmap_br_program(void);
 
-GLuint get_def_tex_light_ins_program(void);
+// format is the INS_FORMAT of the ins_object_manager that is drawn
+GLuint get_def_tex_light_ins_program(unsigned int format);
 
-GLuint get_def_shadowmap_ins_program(void);
+GLuint get_def_shadowmap_ins_program(unsigned int format);
 
 GLuint get_def_gbuffer_br_program(void);
 
-GLuint get_def_deferred_br_program(void);
+GLuint get_def_deferred_br_program(unsigned int variant);
 
-GLuint get_def_ssao_program(void);
+GLuint get_def_ssao_program(unsigned int variant);
 
 GLuint get_def_ssao_blur_program(void);
 
-GLuint get_def_post_process_program(void);
+GLuint get_def_post_process_program(unsigned int variant);
 
 GLuint get_def_text_program(void);
 
@@ -1,4 +1,5 @@
 #include "skybox.h"
+#include "gl_state.h"
 #include "stdlib.h"
 #include "../../third_party/stb/stb_image.h"
 #include "timing.h"
@@ -46,21 +47,21 @@ skybox *create_skybox(const char *right_texture, const char *left_texture, const
   glGenVertexArrays(1, &s->VAO);
   glGenBuffers(1, &s->VBO);
   glGenBuffers(1, &s->EBO);
-  glBindVertexArray(s->VAO);
-  glBindBuffer(GL_ARRAY_BUFFER, s->VBO);
+  bind_vertex_array(s->VAO);
+  bind_buffer(GL_ARRAY_BUFFER, s->VBO);
   glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), &skyboxVertices, GL_STATIC_DRAW);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, s->EBO);
+  bind_buffer(GL_ELEMENT_ARRAY_BUFFER, s->EBO);
   glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(skyboxIndices), &skyboxIndices, GL_STATIC_DRAW);
   glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *)0);
   glEnableVertexAttribArray(0);
-  glBindBuffer(GL_ARRAY_BUFFER, 0);
-  glBindVertexArray(0);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+  bind_buffer(GL_ARRAY_BUFFER, 0);
+  bind_vertex_array(0);
+  bind_buffer(GL_ELEMENT_ARRAY_BUFFER, 0);
   s->programs = create_DA(sizeof(GLuint), 0);
   s->uniforms = create_DA(sizeof(GLint), 0);
   s->cam = cam;
   glGenTextures(1, &s->cubemap);
-  glBindTexture(GL_TEXTURE_CUBE_MAP, s->cubemap);
+  bind_texture(GL_TEXTURE_CUBE_MAP, s->cubemap);
   glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
   glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
   // These are very important to prevent seams
@@ -247,10 +248,10 @@ skybox *create_skybox(const char *right_texture, const char *left_texture, const
 
 void delete_skybox(skybox *s)
 {
-  glDeleteVertexArrays(1, &(s->VAO));
-  glDeleteBuffers(1, &(s->VBO));
-  glDeleteBuffers(1, &(s->EBO));
-  glDeleteTextures(1, &(s->cubemap));
+  delete_vertex_arrays(1, &(s->VAO));
+  delete_buffers(1, &(s->VBO));
+  delete_buffers(1, &(s->EBO));
+  delete_textures(1, &(s->cubemap));
   delete_DA(s->programs);
   delete_DA(s->uniforms);
   free32(s);
@@ -279,9 +280,8 @@ void use_skybox(skybox *s, GLuint program)
   unsigned int index = get_index_DA(s->programs, &program);
   glUniformMatrix4fv(uniforms[index * 2], 1, GL_FALSE, s->result[0]);
   glUniform1i(uniforms[index * 2 + 1], 0);
-  glActiveTexture(GL_TEXTURE0);
-  glBindTexture(GL_TEXTURE_CUBE_MAP, s->cubemap);
-  glBindVertexArray(s->VAO);
+  active_texture(GL_TEXTURE0);
+  bind_texture(GL_TEXTURE_CUBE_MAP, s->cubemap);
+  bind_vertex_array(s->VAO);
   glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-  glBindVertexArray(0);
 }
\ No newline at end of file
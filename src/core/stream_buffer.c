@@ -0,0 +1,139 @@
+#include "stream_buffer.h"
+#include "gl_state.h"
+#include <stdlib.h>
+#include <string.h>
+
+stream_buffer *create_stream_buffer(GLsizeiptr size, const void *data)
+{
+	stream_buffer *x = malloc(sizeof(stream_buffer));
+	x->size = size;
+	x->region = 0;
+	x->mapped = 0;
+	for (int i = 0; i < STREAM_BUFFER_REGIONS; i++)
+	{
+		x->fences[i] = 0;
+		x->dirty_start[i] = size;
+		x->dirty_end[i] = 0;
+	}
+	glGenBuffers(1, &(x->buffer));
+	bind_buffer(GL_COPY_WRITE_BUFFER, x->buffer);
+	if (has_buffer_storage)
+	{
+		x->region_count = STREAM_BUFFER_REGIONS;
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_COPY_WRITE_BUFFER, size * x->region_count, 0, flags);
+		x->mapped = glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size * x->region_count, flags);
+		if (x->mapped == 0)
+		{
+			// immutable storage can not be written with glBufferSubData, start over with a mutable buffer
+			delete_buffers(1, &(x->buffer));
+			glGenBuffers(1, &(x->buffer));
+			bind_buffer(GL_COPY_WRITE_BUFFER, x->buffer);
+		}
+		for (unsigned int i = 0; i < x->region_count && x->mapped != 0 && data != 0; i++)
+		{
+			memcpy(x->mapped + size * i, data, size);
+		}
+	}
+	if (x->mapped == 0)
+	{
+		x->region_count = 1;
+		glBufferData(GL_COPY_WRITE_BUFFER, size, data, GL_DYNAMIC_DRAW);
+	}
+	bind_buffer(GL_COPY_WRITE_BUFFER, 0);
+	return x;
+}
+
+void delete_stream_buffer(stream_buffer *s)
+{
+	if (s == 0)
+	{
+		return;
+	}
+	for (int i = 0; i < STREAM_BUFFER_REGIONS; i++)
+	{
+		if (s->fences[i] != 0)
+		{
+			glDeleteSync(s->fences[i]);
+		}
+	}
+	if (s->mapped != 0)
+	{
+		bind_buffer(GL_COPY_WRITE_BUFFER, s->buffer);
+		glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+		bind_buffer(GL_COPY_WRITE_BUFFER, 0);
+	}
+	delete_buffers(1, &(s->buffer));
+	free(s);
+}
+
+void mark_stream_buffer(stream_buffer *s, GLintptr offset, GLsizeiptr size)
+{
+	for (unsigned int i = 0; i < s->region_count; i++)
+	{
+		if (offset < s->dirty_start[i])
+		{
+			s->dirty_start[i] = offset;
+		}
+		if (offset + size > s->dirty_end[i])
+		{
+			s->dirty_end[i] = offset + size;
+		}
+	}
+}
+
+void wait_stream_buffer(stream_buffer *s, unsigned int region)
+{
+	if (s->fences[region] == 0)
+	{
+		return;
+	}
+	GLenum result = glClientWaitSync(s->fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+	while (result == GL_TIMEOUT_EXPIRED)
+	{
+		result = glClientWaitSync(s->fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+	}
+	glDeleteSync(s->fences[region]);
+	s->fences[region] = 0;
+}
+
+GLintptr update_stream_buffer(stream_buffer *s, const void *data)
+{
+	// current region is complete, keep drawing from it
+	if (s->dirty_start[s->region] >= s->dirty_end[s->region])
+	{
+		return s->size * s->region;
+	}
+	if (s->mapped != 0)
+	{
+		s->region = (s->region + 1) % s->region_count;
+		unsigned int r = s->region;
+		if (s->dirty_start[r] < s->dirty_end[r])
+		{
+			wait_stream_buffer(s, r);
+			memcpy(s->mapped + s->size * r + s->dirty_start[r], (const char *)data + s->dirty_start[r], s->dirty_end[r] - s->dirty_start[r]);
+		}
+	}
+	else
+	{
+		bind_buffer(GL_COPY_WRITE_BUFFER, s->buffer);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, s->dirty_start[0], s->dirty_end[0] - s->dirty_start[0], (const char *)data + s->dirty_start[0]);
+		bind_buffer(GL_COPY_WRITE_BUFFER, 0);
+	}
+	s->dirty_start[s->region] = s->size;
+	s->dirty_end[s->region] = 0;
+	return s->size * s->region;
+}
+
+void fence_stream_buffer(stream_buffer *s)
+{
+	if (s->mapped == 0)
+	{
+		return;
+	}
+	if (s->fences[s->region] != 0)
+	{
+		glDeleteSync(s->fences[s->region]);
+	}
+	s->fences[s->region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
\ No newline at end of file
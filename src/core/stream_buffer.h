@@ -0,0 +1,34 @@
+#pragma once
+#include "../../third_party/opengl/include/glad/glad.h"
+#include "gl_extensions.h"
+
+#define STREAM_BUFFER_REGIONS 3
+
+// buffer for data that changes while rendering. with buffer storage it is persistently mapped and split into
+// 3 regions, cpu writes one region while gpu may still read the others, fences keep them apart.
+// without buffer storage there is one region and dirty ranges are uploaded with glBufferSubData.
+// the buffer keeps a full copy in every region so only changed ranges are copied
+typedef struct stream_buffer
+{
+	GLuint buffer;
+	GLsizeiptr size; // size of one region
+	unsigned int region_count;
+	unsigned int region;
+	char *mapped;
+	GLsync fences[STREAM_BUFFER_REGIONS];
+	GLsizeiptr dirty_start[STREAM_BUFFER_REGIONS];
+	GLsizeiptr dirty_end[STREAM_BUFFER_REGIONS];
+} stream_buffer;
+
+stream_buffer *create_stream_buffer(GLsizeiptr size, const void *data);
+
+void delete_stream_buffer(stream_buffer *s);
+
+// marks bytes [offset, offset + size) as changed
+void mark_stream_buffer(stream_buffer *s, GLintptr offset, GLsizeiptr size);
+
+// copies changed ranges of data into a free region and returns the byte offset of the region to draw from
+GLintptr update_stream_buffer(stream_buffer *s, const void *data);
+
+// call it after the draws that read the current region
+void fence_stream_buffer(stream_buffer *s);
\ No newline at end of file
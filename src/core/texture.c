@@ -3,10 +3,11 @@
 #endif
 #include "../../third_party/stb/stb_image.h"
 #include "texture.h"
+#include "gl_state.h"
 
 texture *load_texture(const char *path, GLenum texType, GLenum pixelType, GLint min_filter, GLint mag_filter, float shininess)
 {
-	glBindTexture(texType, 0);
+	bind_texture(texType, 0);
 	texture *tex = calloc(1, sizeof(texture));
 	int widthImg, heightImg, numColCh;
 	stbi_set_flip_vertically_on_load(1);
@@ -29,8 +30,8 @@ texture *load_texture(const char *path, GLenum texType, GLenum pixelType, GLint
 		format = GL_RGBA;
 	}
 	glGenTextures(1, &(tex->id));
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(texType, tex->id);
+	active_texture(GL_TEXTURE0);
+	bind_texture(texType, tex->id);
 	glTexParameteri(texType, GL_TEXTURE_MIN_FILTER, min_filter);
 	glTexParameteri(texType, GL_TEXTURE_MAG_FILTER, mag_filter);
 	glTexParameteri(texType, GL_TEXTURE_WRAP_S, GL_REPEAT);
@@ -44,7 +45,7 @@ texture *load_texture(const char *path, GLenum texType, GLenum pixelType, GLint
 		glGenerateMipmap(texType);
 	}
 	stbi_image_free(bytes);
-	glBindTexture(texType, 0);
+	bind_texture(texType, 0);
 	tex->type = texType;
 	tex->programs = create_DA(sizeof(GLuint), 0);
 	tex->uniforms = create_DA(sizeof(GLint), 0);
@@ -66,14 +67,14 @@ void use_texture(texture *tex, GLuint program)
 	unsigned int index = get_index_DA(tex->programs, &program);
 	glUniform1f(uniforms[index * 2], tex->shininess);
 	glUniform1i(uniforms[index * 2 + 1], 0);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(tex->type, tex->id);
+	active_texture(GL_TEXTURE0);
+	bind_texture(tex->type, tex->id);
 }
 
 void delete_texture(texture *tex)
 {
 	delete_DA(tex->programs);
 	delete_DA(tex->uniforms);
-	glDeleteTextures(1, &(tex->id));
+	delete_textures(1, &(tex->id));
 	free(tex);
 }
\ No newline at end of file
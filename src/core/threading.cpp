@@ -2,6 +2,11 @@
 #include "threading.h"
 #include <thread>
 #include <mutex>
+#include <condition_variable>
+#include <chrono>
+#ifdef _WIN32
+#include <windows.h>
+#endif
 
 // Define the structure for the thread handle
 struct Thread
@@ -14,6 +19,13 @@ struct Mutex
   std::mutex m;
 };
 
+struct Semaphore
+{
+  std::mutex m;
+  std::condition_variable c;
+  unsigned int count;
+};
+
 // Function to create a new thread
 Thread *create_thread(ThreadFunction func, void *arg)
 {
@@ -48,4 +60,52 @@ void lock_mutex(Mutex *m)
 void unlock_mutex(Mutex *m)
 {
   m->m.unlock();
+}
+
+Semaphore *create_semaphore(unsigned int count)
+{
+  Semaphore *s = new Semaphore;
+  s->count = count;
+  return s;
+}
+
+void destroy_semaphore(Semaphore *s)
+{
+  delete s;
+}
+
+void wait_semaphore(Semaphore *s)
+{
+  std::unique_lock<std::mutex> lock(s->m);
+  s->c.wait(lock, [s]
+            { return s->count > 0; });
+  s->count--;
+}
+
+void post_semaphore(Semaphore *s)
+{
+  {
+    std::lock_guard<std::mutex> lock(s->m);
+    s->count++;
+  }
+  s->c.notify_one();
+}
+
+void sleep_thread(double ms)
+{
+#ifdef _WIN32
+  // default timer resolution of windows is 15.6 ms, high resolution waitable timers dont change it for the whole system
+  static thread_local HANDLE timer = CreateWaitableTimerExW(0, 0, 0x00000002 /* CREATE_WAITABLE_TIMER_HIGH_RESOLUTION */, TIMER_ALL_ACCESS);
+  if (timer != 0)
+  {
+    LARGE_INTEGER due;
+    due.QuadPart = -(LONGLONG)(ms * 10000.0);
+    if (SetWaitableTimerEx(timer, &due, 0, 0, 0, 0, 0))
+    {
+      WaitForSingleObject(timer, INFINITE);
+      return;
+    }
+  }
+#endif
+  std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(ms));
 }
\ No newline at end of file
@@ -9,6 +9,8 @@ extern "C"
 
   typedef struct Mutex Mutex;
 
+  typedef struct Semaphore Semaphore;
+
   typedef void (*ThreadFunction)(void *);
 
   Thread *create_thread(ThreadFunction func, void *arg);
@@ -23,6 +25,18 @@ extern "C"
 
   void unlock_mutex(Mutex *m);
 
+  Semaphore *create_semaphore(unsigned int count);
+
+  void destroy_semaphore(Semaphore *s);
+
+  // blocks until count is above 0, then decrements it
+  void wait_semaphore(Semaphore *s);
+
+  void post_semaphore(Semaphore *s);
+
+  // sleeps at least ms, with a high resolution timer where there is one
+  void sleep_thread(double ms);
+
 #ifdef __cplusplus
 }
 #endif
\ No newline at end of file
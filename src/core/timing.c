@@ -1,35 +1,118 @@
 #include "timing.h"
+#include "threading.h"
 #include "../../third_party/glfw/include/GLFW/glfw3.h"
 
 double timer = 0;
 double frame_ms = 0;
 double old_frame_ms = 0;
+double work_ms = 0;
+double old_work_ms = 0;
 
-unsigned long long int avg_count = 0;
-double average_ms = 0;
+double frame_window[FRAME_TIME_WINDOW];
+unsigned int window_count = 0;
+unsigned int window_index = 0;
+double window_sum = 0;
+
+double pacer_target_ms = 0;
+double pacer_deadline = 0;
+double pacer_margin_ms = 1.0; // sleeping stops this early, follows how late sleeps wake up
+unsigned int pacer_frames_in_flight = 0;
 
 void start_game_loop(void)
 {
   timer = glfwGetTime() * 1000;
   old_frame_ms = frame_ms;
+  old_work_ms = work_ms;
   frame_ms = 0;
 }
 
+// sleeps most of the way and spins the rest, spinning is only as long as the scheduler is late
+void wait_until_timems(double deadline)
+{
+  double now = get_timems();
+  while (deadline - now > pacer_margin_ms)
+  {
+    double request = deadline - now - pacer_margin_ms;
+    sleep_thread(request);
+    double after = get_timems();
+    double late = after - now - request;
+    pacer_margin_ms = late > pacer_margin_ms ? late : pacer_margin_ms * 0.99 + late * 0.01;
+    if (pacer_margin_ms < 0.2)
+    {
+      pacer_margin_ms = 0.2;
+    }
+    else if (pacer_margin_ms > 4)
+    {
+      pacer_margin_ms = 4;
+    }
+    now = after;
+  }
+  while (now < deadline)
+  {
+    now = get_timems();
+  }
+}
+
+void add_frame_time(void)
+{
+  if (window_count == FRAME_TIME_WINDOW)
+  {
+    window_sum -= frame_window[window_index];
+  }
+  else
+  {
+    window_count++;
+  }
+  frame_window[window_index] = frame_ms;
+  window_sum += frame_ms;
+  window_index = (window_index + 1) % FRAME_TIME_WINDOW;
+  // sum again once a window so rounding does not pile up
+  if (window_index == 0)
+  {
+    window_sum = 0;
+    for (unsigned int i = 0; i < window_count; i++)
+    {
+      window_sum += frame_window[i];
+    }
+  }
+}
+
 void end_game_loop(void)
 {
+  work_ms = get_timems() - timer;
+  if (pacer_target_ms > 0)
+  {
+    // deadlines follow each other so a slow frame is not made up with a short one, unless it was more than a frame late
+    double now = get_timems();
+    pacer_deadline = pacer_deadline == 0 ? timer + pacer_target_ms : pacer_deadline + pacer_target_ms;
+    if (pacer_deadline < now - pacer_target_ms)
+    {
+      pacer_deadline = now;
+    }
+    wait_until_timems(pacer_deadline);
+  }
   frame_ms = glfwGetTime() * 1000 - timer;
-  average_ms = (average_ms * avg_count + frame_ms) / (avg_count + 1);
-  avg_count++;
+  add_frame_time();
 }
 
 void end_game_loop_targetms(double targetms)
 {
-  while (frame_ms < targetms)
-  {
-    frame_ms = glfwGetTime() * 1000 - timer;
-  }
-  average_ms = (average_ms * avg_count + frame_ms) / (avg_count + 1);
-  avg_count++;
+  work_ms = get_timems() - timer;
+  wait_until_timems(timer + targetms);
+  frame_ms = glfwGetTime() * 1000 - timer;
+  add_frame_time();
+}
+
+void set_frame_pacer(double target_fps, unsigned int frames_in_flight)
+{
+  pacer_target_ms = target_fps > 0 ? 1000.0 / target_fps : 0;
+  pacer_deadline = 0;
+  pacer_frames_in_flight = frames_in_flight;
+}
+
+unsigned int get_frames_in_flight(void)
+{
+  return pacer_frames_in_flight;
 }
 
 double get_frame_timems(void)
@@ -37,6 +120,11 @@ double get_frame_timems(void)
   return old_frame_ms;
 }
 
+double get_work_timems(void)
+{
+  return old_work_ms;
+}
+
 double get_timems(void)
 {
   return glfwGetTime() * 1000;
@@ -44,5 +132,5 @@ double get_timems(void)
 
 double get_average_frame_timems(void)
 {
-  return average_ms;
+  return window_count == 0 ? 0 : window_sum / window_count;
 }
\ No newline at end of file
@@ -1,13 +1,26 @@
 #pragma once
 
+#define FRAME_TIME_WINDOW 128 // frames in get_average_frame_timems
+
 void start_game_loop(void);
 
+// waits for the frame pacer when it has a target
 void end_game_loop(void);
 
 void end_game_loop_targetms(double targetms);
 
+// target_fps 0 runs unpaced, otherwise frames are held until their deadline independent of vsync.
+// frames_in_flight is how many frames the gpu may be behind, 0 for no limit (see throttle_gpu_frames)
+void set_frame_pacer(double target_fps, unsigned int frames_in_flight);
+
+unsigned int get_frames_in_flight(void);
+
 double get_frame_timems(void);
 
+// last frame without the time it waited for the frame pacer
+double get_work_timems(void);
+
 double get_timems(void);
 
+// average of the last FRAME_TIME_WINDOW frames
 double get_average_frame_timems(void);
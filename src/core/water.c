@@ -1,20 +1,116 @@
 #include "water.h"
 #include "core.h"
 
-GLfloat vertices[] = {
-    0.5f, 5, -0.5f, 0, 0, 0, 1, 0, 0,  // 0
-    -0.5f, 5, -0.5f, 1, 0, 0, 1, 0, 0, // 1
-    -0.5f, 5, 0.5f, 1, 1, 0, 1, 0, 0,  // 2
-    0.5f, 5, 0.5f, 0, 1, 0, 1, 0, 0,   // 3
-};
-
-GLuint indices[] = {
-    2, 1, 0, //
-    0, 3, 2, //
-};
+// water surface is tessellated every WATER_STEP cells, water.vs keeps waves long enough for it
+#define WATER_STEP 2
 
 br_texture_manager *water_texture = 0;
 
+typedef struct water_cells
+{
+  unsigned char *cells; // water cells of the chunk that are not in a merged rectangle
+  int startx, startz, widthx, widthz;
+  int **hm;
+  int dimensionx, dimensionz;
+  float sealevel;
+} water_cells;
+
+unsigned char is_water_cell(water_cells *c, int i, int i2)
+{
+  int x = c->startx + i + (int)(c->dimensionx / 2);
+  int z = c->startz + i2 + (int)(c->dimensionz / 2);
+  return !(x >= 0 && z >= 0 && x < c->dimensionx && z < c->dimensionz && c->hm[x][z] > (int)floorf(c->sealevel - 0.5f));
+}
+
+// cell (i, i2) gets a quad of its own, outside of the chunk every water cell counts as one so
+// the chunks on both sides of a border split their edges the same way
+unsigned char is_single_water_cell(water_cells *c, int i, int i2)
+{
+  if (i < 0 || i2 < 0 || i >= c->widthx || i2 >= c->widthz)
+  {
+    return is_water_cell(c, i, i2);
+  }
+  return c->cells[i * c->widthz + i2];
+}
+
+// uv is the world position so the texture repeats once per cell like single cell quads did
+GLuint push_water_vertex(DA *vertices, float sealevel, float x, float z)
+{
+  GLfloat vertex[9] = {x, sealevel, z, 0.5f - x, z + 0.5f, 0, 1, 0, 0};
+  pushback_many_DA(vertices, vertex, 9);
+  return get_size_DA(vertices) / 9 - 1;
+}
+
+void push_water_quad(DA *vertices, DA *indices, float sealevel, float x0, float z0)
+{
+  GLuint a = push_water_vertex(vertices, sealevel, x0, z0);
+  GLuint b = push_water_vertex(vertices, sealevel, x0 + 1, z0);
+  GLuint d = push_water_vertex(vertices, sealevel, x0, z0 + 1);
+  GLuint e = push_water_vertex(vertices, sealevel, x0 + 1, z0 + 1);
+  GLuint quad[6] = {d, a, b, b, e, d};
+  pushback_many_DA(indices, quad, 6);
+}
+
+// rectangle of sizex x sizez blocks from cell (i, i2), split every WATER_STEP along both axes.
+// single cell quads have a vertex in the middle of a block side, blocks next to them get one too and
+// are drawn as a fan around their center so waves dont open cracks at the t-junctions
+void push_water_rect(DA *vertices, DA *indices, water_cells *c, int i, int i2, int sizex, int sizez)
+{
+  float x0 = c->startx + i - 0.5f;
+  float z0 = c->startz + i2 - 0.5f;
+  GLuint first = get_size_DA(vertices) / 9;
+  for (int r = 0; r <= sizez; r++)
+  {
+    for (int k = 0; k <= sizex; k++)
+    {
+      push_water_vertex(vertices, c->sealevel, x0 + k * WATER_STEP, z0 + r * WATER_STEP);
+    }
+  }
+  for (int r = 0; r < sizez; r++)
+  {
+    for (int k = 0; k < sizex; k++)
+    {
+      GLuint a = first + r * (sizex + 1) + k;
+      GLuint b = a + 1;
+      GLuint d = a + sizex + 1;
+      GLuint e = d + 1;
+      int ci = i + k * WATER_STEP;
+      int ci2 = i2 + r * WATER_STEP;
+      // left, bottom, right and top sides in the order of the fan
+      unsigned char split[4] = {is_single_water_cell(c, ci - 1, ci2) || is_single_water_cell(c, ci - 1, ci2 + 1),
+                                is_single_water_cell(c, ci, ci2 - 1) || is_single_water_cell(c, ci + 1, ci2 - 1),
+                                is_single_water_cell(c, ci + 2, ci2) || is_single_water_cell(c, ci + 2, ci2 + 1),
+                                is_single_water_cell(c, ci, ci2 + 2) || is_single_water_cell(c, ci + 1, ci2 + 2)};
+      if (!split[0] && !split[1] && !split[2] && !split[3])
+      {
+        GLuint quad[6] = {d, a, b, b, e, d};
+        pushback_many_DA(indices, quad, 6);
+        continue;
+      }
+      float x = x0 + k * WATER_STEP;
+      float z = z0 + r * WATER_STEP;
+      GLuint center = push_water_vertex(vertices, c->sealevel, x + 1, z + 1);
+      GLuint corners[4] = {d, a, b, e};
+      float middles[4][2] = {{x, z + 1}, {x + 1, z}, {x + 2, z + 1}, {x + 1, z + 2}};
+      GLuint around[8];
+      int count = 0;
+      for (int side = 0; side < 4; side++)
+      {
+        around[count++] = corners[side];
+        if (split[side])
+        {
+          around[count++] = push_water_vertex(vertices, c->sealevel, middles[side][0], middles[side][1]);
+        }
+      }
+      for (int n = 0; n < count; n++)
+      {
+        GLuint triangle[3] = {center, around[n], around[(n + 1) % count]};
+        pushback_many_DA(indices, triangle, 3);
+      }
+    }
+  }
+}
+
 water *create_water(float sealevel, int **hm, const char *texture_path, int startx,
                     int startz, int widthx, int widthz, int dimensionx, int dimensionz, unsigned char create_physic)
 {
@@ -23,26 +119,104 @@ water *create_water(float sealevel, int **hm, const char *texture_path, int star
   if (water_texture == 0)
   {
     water_texture = create_br_texture_manager();
-    create_br_texture(water_texture, texture_path, GL_TEXTURE_2D, GL_LINEAR_MIPMAP_LINEAR, GL_NEAREST, 0, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE);
+    // first texture of a manager is material 0, vertices already use it. merged quads repeat it
+    create_br_texture(water_texture, texture_path, GL_LINEAR_MIPMAP_LINEAR, GL_NEAREST, GL_REPEAT, GL_REPEAT);
+  }
+  // cell (i, i2) is centered on it and water where terrain is not above sea level
+  unsigned char *cells = calloc(widthx * widthz, 1);
+  water_cells c = {cells, startx, startz, widthx, widthz, hm, dimensionx, dimensionz, sealevel};
+  for (int i = 0; i < widthx; i++)
+  {
+    for (int i2 = 0; i2 < widthz; i2++)
+    {
+      cells[i * widthz + i2] = is_water_cell(&c, i, i2);
+    }
+  }
+
+  // 2x2 blocks starting on even world cells that are all water are merged into rectangles greedily.
+  // blocks share the even lattice so neighbour rectangles have the same vertices on their common edges
+  int offsetx = ((startx % 2) + 2) % 2;
+  int offsetz = ((startz % 2) + 2) % 2;
+  int blocksx = max(0, (widthx - offsetx) / 2);
+  int blocksz = max(0, (widthz - offsetz) / 2);
+  unsigned char *blocks = calloc(blocksx * blocksz + 1, 1); // 1 free, 2 merged
+  for (int bx = 0; bx < blocksx; bx++)
+  {
+    for (int bz = 0; bz < blocksz; bz++)
+    {
+      int i = offsetx + bx * 2;
+      int i2 = offsetz + bz * 2;
+      blocks[bx * blocksz + bz] = cells[i * widthz + i2] && cells[(i + 1) * widthz + i2] &&
+                                  cells[i * widthz + i2 + 1] && cells[(i + 1) * widthz + i2 + 1];
+    }
   }
-  vertices[1] = sealevel;
-  vertices[10] = sealevel;
-  vertices[19] = sealevel;
-  vertices[28] = sealevel;
-  for (int i = startx; i < startx + widthx; i++)
+  DA *rects = create_DA(sizeof(int), 0); // first block and size of every rectangle
+  for (int bz = 0; bz < blocksz; bz++)
   {
-    for (int i2 = startz; i2 < startz + widthz; i2++)
+    for (int bx = 0; bx < blocksx; bx++)
     {
-      if (i + (int)(dimensionx / 2) < dimensionx && i2 + (int)(dimensionz / 2) < dimensionz &&
-          hm[i + (int)(dimensionx / 2)][i2 + (int)(dimensionz / 2)] > (int)floorf(sealevel - 0.5f))
+      if (blocks[bx * blocksz + bz] != 1)
       {
         continue;
       }
-      br_object *tmp = create_br_object(w->obj, vertices, 4, indices, 6, 0, 0, 0, 0, 0, 0);
-      translate_br_object(tmp, (vec3){(float)i, 0, (float)i2}, 0);
+      int sizex = 1;
+      while (bx + sizex < blocksx && blocks[(bx + sizex) * blocksz + bz] == 1)
+      {
+        sizex++;
+      }
+      int sizez = 1;
+      unsigned char grow = 1;
+      while (grow && bz + sizez < blocksz)
+      {
+        for (int k = 0; k < sizex; k++)
+        {
+          grow = grow && blocks[(bx + k) * blocksz + bz + sizez] == 1;
+        }
+        sizez += grow;
+      }
+      for (int k = 0; k < sizex; k++)
+      {
+        for (int k2 = 0; k2 < sizez; k2++)
+        {
+          blocks[(bx + k) * blocksz + bz + k2] = 2;
+          int i = offsetx + (bx + k) * 2;
+          int i2 = offsetz + (bz + k2) * 2;
+          cells[i * widthz + i2] = 0;
+          cells[(i + 1) * widthz + i2] = 0;
+          cells[i * widthz + i2 + 1] = 0;
+          cells[(i + 1) * widthz + i2 + 1] = 0;
+        }
+      }
+      int rect[4] = {bx, bz, sizex, sizez};
+      pushback_many_DA(rects, rect, 4);
+    }
+  }
+  // rectangles are meshed once every shore cell is known, their sides next to shore cells are split
+  DA *vertices = create_DA(sizeof(GLfloat), 0);
+  DA *indices = create_DA(sizeof(GLuint), 0);
+  int *rect = get_data_DA(rects);
+  for (unsigned int r = 0; r < get_size_DA(rects); r += 4)
+  {
+    push_water_rect(vertices, indices, &c, offsetx + rect[r] * 2, offsetz + rect[r + 1] * 2, rect[r + 2], rect[r + 3]);
+  }
+  // shore cells left out of blocks get a quad each
+  for (int i = 0; i < widthx; i++)
+  {
+    for (int i2 = 0; i2 < widthz; i2++)
+    {
+      if (cells[i * widthz + i2])
+      {
+        push_water_quad(vertices, indices, sealevel, startx + i - 0.5f, startz + i2 - 0.5f);
+      }
     }
   }
-  prepare_render_br_object_manager(w->obj);
+  // whole chunk is one object
+  create_br_object(w->obj, get_data_DA(vertices), get_size_DA(vertices) / 9, get_data_DA(indices), get_size_DA(indices), 0, 0, 0, 0, 0, 0);
+  delete_DA(vertices);
+  delete_DA(indices);
+  delete_DA(rects);
+  free(blocks);
+  free(cells);
   if (create_physic)
   {
     create_water_jolt(sealevel, 1.1f, 0.3f, 0.05f);
@@ -56,10 +230,9 @@ void delete_water(water *w)
   free(w);
 }
 
-void use_water(water *w, GLuint program)
+br_texture_manager *get_water_texture_manager(void)
 {
-  use_br_texture_manager(water_texture, program);
-  use_br_object_manager(w->obj, program);
+  return water_texture;
 }
 
 void delete_water_texture_manager(void)
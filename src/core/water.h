@@ -12,6 +12,6 @@ water *create_water(float sealevel, int **hm, const char *texture_path, int star
 
 void delete_water(water *w);
 
-void use_water(water *w, GLuint program);
+br_texture_manager *get_water_texture_manager(void);
 
 void delete_water_texture_manager(void);
\ No newline at end of file
@@ -1,4 +1,6 @@
 #include "window.h"
+#include "gl_state.h"
+#include "gl_extensions.h"
 #include <locale.h>
 
 // make the computer use best gpu
@@ -61,14 +63,46 @@ void poll_events(GLFWwindow *window)
 	}
 }
 
-GLFWwindow *create_window(int width, int height, unsigned char is_full, unsigned char vsync, int msaa)
+void set_window_hints(void)
 {
-	setlocale(LC_ALL, "Turkish"); // for turkish characters
-	glfwInit();
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 	glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+}
+
+void init_window_context(GLFWwindow *window, int width, int height, unsigned char vsync, int msaa)
+{
+	glfwMakeContextCurrent(window);
+	if (vsync)
+	{
+		glfwSwapInterval(1);
+	}
+	else
+	{
+		glfwSwapInterval(0);
+	}
+	gladLoadGL();
+	load_gl_extensions((GLADloadproc)glfwGetProcAddress);
+	reset_gl_state();
+	set_viewport(0, 0, width, height);
+	glEnable(GL_DEPTH_TEST);
+	glDepthFunc(GL_LEQUAL);
+	glClearDepth(1.0);
+	if (msaa > 1)
+	{
+		glEnable(GL_MULTISAMPLE);
+	}
+	glEnable(GL_CULL_FACE);
+	set_cull_face(GL_FRONT);
+	glFrontFace(GL_CCW);
+}
+
+GLFWwindow *create_window(int width, int height, unsigned char is_full, unsigned char vsync, int msaa)
+{
+	setlocale(LC_ALL, "Turkish"); // for turkish characters
+	glfwInit();
+	set_window_hints();
 	glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
 	if (msaa > 1)
 	{
@@ -94,27 +128,26 @@ GLFWwindow *create_window(int width, int height, unsigned char is_full, unsigned
 		glfwTerminate();
 		return 0;
 	}
-	glfwMakeContextCurrent(window);
-	if (vsync)
-	{
-		glfwSwapInterval(1);
-	}
-	else
+	init_window_context(window, width, height, vsync, msaa);
+	return window;
+}
+
+GLFWwindow *create_window_headless(int width, int height)
+{
+	if (!glfwInit())
 	{
-		glfwSwapInterval(0);
+		return 0;
 	}
-	gladLoadGL();
-	glViewport(0, 0, width, height);
-	glEnable(GL_DEPTH_TEST);
-	glDepthFunc(GL_LEQUAL);
-	glClearDepth(1.0);
-	if (msaa > 1)
+	set_window_hints();
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	GLFWwindow *window = glfwCreateWindow(width, height, "Şükrü Çiriş Engine", 0, 0);
+	if (window == 0)
 	{
-		glEnable(GL_MULTISAMPLE);
+		glfwTerminate();
+		return 0;
 	}
-	glEnable(GL_CULL_FACE);
-	glCullFace(GL_FRONT);
-	glFrontFace(GL_CCW);
+	// there is nothing to wait for
+	init_window_context(window, width, height, 0, 0);
 	return window;
 }
 
@@ -4,6 +4,11 @@
 
 GLFWwindow *create_window(int width, int height, unsigned char is_full, unsigned char vsync, int msaa);
 
+// hidden window that only carries a context, frames go to an offscreen framebuffer (see create_lighting_offscreen).
+// when glfw is built with HEADLESS it has no display backend and the context comes from osmesa,
+// so this also runs on mesa software rasterizer without a display or gpu
+GLFWwindow *create_window_headless(int width, int height);
+
 void delete_window(GLFWwindow *window);
 
 unsigned char get_key_pressed(int key);
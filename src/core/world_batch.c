@@ -51,35 +51,53 @@ int grass_border = 30;
 int snow_border = 80;
 
 br_texture_manager *tex_manager = 0;
+GLfloat terrain_materials[7]; // texture_i of surfaces to array layer of its texture
+
+void create_terrain_textures(void)
+{
+	tex_manager = create_br_texture_manager();
+	const char *paths[7] = {"./textures/side.png", "./textures/dirt_side.png", "./textures/dirt.png", "./textures/grass_side.png",
+													"./textures/grass.png", "./textures/snow_side.png", "./textures/snow.png"};
+	for (int i = 0; i < 7; i++)
+	{
+		// all of them share one array, side textures are clamped vertically in the shader instead of by the sampler
+		br_texture *tex = create_br_texture(tex_manager, paths[i], GL_LINEAR_MIPMAP_LINEAR, GL_NEAREST, GL_REPEAT, GL_REPEAT);
+		terrain_materials[i] = tex != 0 ? tex->material : 0;
+		if (i == 1 || i == 3 || i == 5)
+		{
+			terrain_materials[i] += BR_MATERIAL_CLAMP_T;
+		}
+	}
+}
 
 br_object *create_top_surface(br_object_manager *x, GLfloat texture_i)
 {
-	return create_br_object(x, &(cube_vertices[180]), 4, cube_indices, 6, texture_i, 0, 3, 10, 0.1f, 0.5f);
+	return create_br_object(x, &(cube_vertices[180]), 4, cube_indices, 6, terrain_materials[(int)texture_i], 0, 3, 10, 0.1f, 0.5f);
 }
 
 br_object *create_bottom_surface(br_object_manager *x, GLfloat texture_i)
 {
-	return create_br_object(x, &(cube_vertices[144]), 4, cube_indices, 6, texture_i, 0, 3, 10, 0.1f, 0.5f);
+	return create_br_object(x, &(cube_vertices[144]), 4, cube_indices, 6, terrain_materials[(int)texture_i], 0, 3, 10, 0.1f, 0.5f);
 }
 
 br_object *create_right_surface(br_object_manager *x, GLfloat texture_i)
 {
-	return create_br_object(x, &(cube_vertices[108]), 4, cube_indices, 6, texture_i, 0, 3, 10, 0.1f, 0.5f);
+	return create_br_object(x, &(cube_vertices[108]), 4, cube_indices, 6, terrain_materials[(int)texture_i], 0, 3, 10, 0.1f, 0.5f);
 }
 
 br_object *create_left_surface(br_object_manager *x, GLfloat texture_i)
 {
-	return create_br_object(x, &(cube_vertices[72]), 4, cube_indices, 6, texture_i, 0, 3, 10, 0.1f, 0.5f);
+	return create_br_object(x, &(cube_vertices[72]), 4, cube_indices, 6, terrain_materials[(int)texture_i], 0, 3, 10, 0.1f, 0.5f);
 }
 
 br_object *create_back_surface(br_object_manager *x, GLfloat texture_i)
 {
-	return create_br_object(x, &(cube_vertices[36]), 4, cube_indices, 6, texture_i, 0, 3, 10, 0.1f, 0.5f);
+	return create_br_object(x, &(cube_vertices[36]), 4, cube_indices, 6, terrain_materials[(int)texture_i], 0, 3, 10, 0.1f, 0.5f);
 }
 
 br_object *create_front_surface(br_object_manager *x, GLfloat texture_i)
 {
-	return create_br_object(x, cube_vertices, 4, cube_indices, 6, texture_i, 0, 3, 10, 0.1f, 0.5f);
+	return create_br_object(x, cube_vertices, 4, cube_indices, 6, terrain_materials[(int)texture_i], 0, 3, 10, 0.1f, 0.5f);
 }
 
 void create_surfaces(br_object_manager *x, int i, int i2, int i3, int dimensionx,
@@ -207,14 +225,7 @@ world_batch *create_world_batch(int **hm, int startx, int startz, int widthx, in
 	// textures
 	if (tex_manager == 0)
 	{
-		tex_manager = create_br_texture_manager();
-		create_br_texture(tex_manager, "./textures/side.png", GL_TEXTURE_2D, GL_LINEAR_MIPMAP_LINEAR, GL_NEAREST, 0, GL_REPEAT, GL_REPEAT);
-		create_br_texture(tex_manager, "./textures/dirt_side.png", GL_TEXTURE_2D, GL_LINEAR_MIPMAP_LINEAR, GL_NEAREST, 1, GL_REPEAT, GL_CLAMP_TO_EDGE);
-		create_br_texture(tex_manager, "./textures/dirt.png", GL_TEXTURE_2D, GL_LINEAR_MIPMAP_LINEAR, GL_NEAREST, 2, GL_REPEAT, GL_REPEAT);
-		create_br_texture(tex_manager, "./textures/grass_side.png", GL_TEXTURE_2D, GL_LINEAR_MIPMAP_LINEAR, GL_NEAREST, 3, GL_REPEAT, GL_CLAMP_TO_EDGE);
-		create_br_texture(tex_manager, "./textures/grass.png", GL_TEXTURE_2D, GL_LINEAR_MIPMAP_LINEAR, GL_NEAREST, 4, GL_REPEAT, GL_REPEAT);
-		create_br_texture(tex_manager, "./textures/snow_side.png", GL_TEXTURE_2D, GL_LINEAR_MIPMAP_LINEAR, GL_NEAREST, 5, GL_REPEAT, GL_CLAMP_TO_EDGE);
-		create_br_texture(tex_manager, "./textures/snow.png", GL_TEXTURE_2D, GL_LINEAR_MIPMAP_LINEAR, GL_NEAREST, 6, GL_REPEAT, GL_REPEAT);
+		create_terrain_textures();
 	}
 
 	if (sealevel > 0)
@@ -249,7 +260,8 @@ world_batch *create_world_batch(int **hm, int startx, int startz, int widthx, in
 			}
 		}
 	}
-	prepare_render_br_object_manager(x->obj_manager);
+	x->land_draw = (world_draw){0, 0, 0};
+	x->water_draw = (world_draw){0, 0, 0};
 	return x;
 }
 
@@ -292,7 +304,7 @@ void merge_top(br_object_manager *x, int **hm, int startx, int startz, int width
 				if (type == 2)
 				{
 					vec3 translate = {(float)(i - (int)(dimensionx / 2)), (float)hm[i][i2], (float)(i2 - (int)(dimensionz / 2))};
-					br_object *tmp = create_br_object(x, &(cube_vertices[180]), 4, cube_indices, 6, texture_i, 0, 3, 10, 0.1f, 0.5f);
+					br_object *tmp = create_br_object(x, &(cube_vertices[180]), 4, cube_indices, 6, terrain_materials[(int)texture_i], 0, 3, 10, 0.1f, 0.5f);
 					translate_br_object(tmp, translate, 0);
 					done[i - startx][i2 - startz] = 1;
 				}
@@ -307,7 +319,7 @@ void merge_top(br_object_manager *x, int **hm, int startx, int startz, int width
 					vec3 scale = {1, 1, (float)loop};
 					cube_vertices[180 + 22] = (float)loop;
 					cube_vertices[180 + 31] = (float)loop;
-					br_object *tmp = create_br_object(x, &(cube_vertices[180]), 4, cube_indices, 6, texture_i, 0, 3, 10, 0.1f, 0.5f);
+					br_object *tmp = create_br_object(x, &(cube_vertices[180]), 4, cube_indices, 6, terrain_materials[(int)texture_i], 0, 3, 10, 0.1f, 0.5f);
 					scale_br_object(tmp, scale, 0);
 					translate_br_object(tmp, translate, 0);
 					cube_vertices[180 + 22] = 1;
@@ -324,7 +336,7 @@ void merge_top(br_object_manager *x, int **hm, int startx, int startz, int width
 					vec3 scale = {(float)loop, 1, 1};
 					cube_vertices[180 + 12] = (float)loop;
 					cube_vertices[180 + 21] = (float)loop;
-					br_object *tmp = create_br_object(x, &(cube_vertices[180]), 4, cube_indices, 6, texture_i, 0, 3, 10, 0.1f, 0.5f);
+					br_object *tmp = create_br_object(x, &(cube_vertices[180]), 4, cube_indices, 6, terrain_materials[(int)texture_i], 0, 3, 10, 0.1f, 0.5f);
 					scale_br_object(tmp, scale, 0);
 					translate_br_object(tmp, translate, 0);
 					cube_vertices[180 + 12] = 1;
@@ -381,7 +393,7 @@ void merge_front(br_object_manager *x, int **hm, int startx, int startz, int wid
 				if (type == 2)
 				{
 					vec3 translate = {(float)(i - (int)(dimensionx / 2)), (float)hm[i][i2], (float)(i2 - (int)(dimensionz / 2))};
-					br_object *tmp = create_br_object(x, cube_vertices, 4, cube_indices, 6, texture_i, 0, 3, 10, 0.1f, 0.5f);
+					br_object *tmp = create_br_object(x, cube_vertices, 4, cube_indices, 6, terrain_materials[(int)texture_i], 0, 3, 10, 0.1f, 0.5f);
 					translate_br_object(tmp, translate, 0);
 					done[i - startx][i2 - startz] = 1;
 				}
@@ -403,7 +415,7 @@ void merge_front(br_object_manager *x, int **hm, int startx, int startz, int wid
 					vec3 scale = {1, 1, (float)loop};
 					cube_vertices[0 + 13] = (float)loop;
 					cube_vertices[0 + 22] = (float)loop;
-					br_object *tmp = create_br_object(x, cube_vertices, 4, cube_indices, 6, texture_i, 0, 3, 10, 0.1f, 0.5f);
+					br_object *tmp = create_br_object(x, cube_vertices, 4, cube_indices, 6, terrain_materials[(int)texture_i], 0, 3, 10, 0.1f, 0.5f);
 					cube_vertices[0 + 13] = 1;
 					cube_vertices[0 + 22] = 1;
 					scale_br_object(tmp, scale, 0);
@@ -427,7 +439,7 @@ void merge_front(br_object_manager *x, int **hm, int startx, int startz, int wid
 					vec3 scale = {(float)loop, 1, 1};
 					cube_vertices[0 + 21] = (float)loop;
 					cube_vertices[0 + 30] = (float)loop;
-					br_object *tmp = create_br_object(x, cube_vertices, 4, cube_indices, 6, texture_i, 0, 3, 10, 0.1f, 0.5f);
+					br_object *tmp = create_br_object(x, cube_vertices, 4, cube_indices, 6, terrain_materials[(int)texture_i], 0, 3, 10, 0.1f, 0.5f);
 					cube_vertices[0 + 21] = 1;
 					cube_vertices[0 + 30] = 1;
 					scale_br_object(tmp, scale, 0);
@@ -484,7 +496,7 @@ void merge_back(br_object_manager *x, int **hm, int startx, int startz, int widt
 				if (type == 2)
 				{
 					vec3 translate = {(float)(i - (int)(dimensionx / 2)), (float)hm[i][i2], (float)(i2 - (int)(dimensionz / 2))};
-					br_object *tmp = create_br_object(x, &(cube_vertices[36]), 4, cube_indices, 6, texture_i, 0, 3, 10, 0.1f, 0.5f);
+					br_object *tmp = create_br_object(x, &(cube_vertices[36]), 4, cube_indices, 6, terrain_materials[(int)texture_i], 0, 3, 10, 0.1f, 0.5f);
 					translate_br_object(tmp, translate, 0);
 					done[i - startx][i2 - startz] = 1;
 				}
@@ -506,7 +518,7 @@ void merge_back(br_object_manager *x, int **hm, int startx, int startz, int widt
 					vec3 scale = {1, 1, (float)loop};
 					cube_vertices[36 + 22] = (float)loop;
 					cube_vertices[36 + 31] = (float)loop;
-					br_object *tmp = create_br_object(x, &(cube_vertices[36]), 4, cube_indices, 6, texture_i, 0, 3, 10, 0.1f, 0.5f);
+					br_object *tmp = create_br_object(x, &(cube_vertices[36]), 4, cube_indices, 6, terrain_materials[(int)texture_i], 0, 3, 10, 0.1f, 0.5f);
 					cube_vertices[36 + 22] = 1;
 					cube_vertices[36 + 31] = 1;
 					scale_br_object(tmp, scale, 0);
@@ -530,7 +542,7 @@ void merge_back(br_object_manager *x, int **hm, int startx, int startz, int widt
 					vec3 scale = {(float)loop, 1, 1};
 					cube_vertices[36 + 12] = (float)loop;
 					cube_vertices[36 + 21] = (float)loop;
-					br_object *tmp = create_br_object(x, &(cube_vertices[36]), 4, cube_indices, 6, texture_i, 0, 3, 10, 0.1f, 0.5f);
+					br_object *tmp = create_br_object(x, &(cube_vertices[36]), 4, cube_indices, 6, terrain_materials[(int)texture_i], 0, 3, 10, 0.1f, 0.5f);
 					cube_vertices[36 + 12] = 1;
 					cube_vertices[36 + 21] = 1;
 					scale_br_object(tmp, scale, 0);
@@ -587,7 +599,7 @@ void merge_left(br_object_manager *x, int **hm, int startx, int startz, int widt
 				if (type == 2)
 				{
 					vec3 translate = {(float)(i - (int)(dimensionx / 2)), (float)hm[i][i2], (float)(i2 - (int)(dimensionz / 2))};
-					br_object *tmp = create_br_object(x, &(cube_vertices[72]), 4, cube_indices, 6, texture_i, 0, 3, 10, 0.1f, 0.5f);
+					br_object *tmp = create_br_object(x, &(cube_vertices[72]), 4, cube_indices, 6, terrain_materials[(int)texture_i], 0, 3, 10, 0.1f, 0.5f);
 					translate_br_object(tmp, translate, 0);
 					done[i - startx][i2 - startz] = 1;
 				}
@@ -609,7 +621,7 @@ void merge_left(br_object_manager *x, int **hm, int startx, int startz, int widt
 					vec3 scale = {1, 1, (float)loop};
 					cube_vertices[72 + 21] = (float)loop;
 					cube_vertices[72 + 30] = (float)loop;
-					br_object *tmp = create_br_object(x, &(cube_vertices[72]), 4, cube_indices, 6, texture_i, 0, 3, 10, 0.1f, 0.5f);
+					br_object *tmp = create_br_object(x, &(cube_vertices[72]), 4, cube_indices, 6, terrain_materials[(int)texture_i], 0, 3, 10, 0.1f, 0.5f);
 					cube_vertices[72 + 21] = 1;
 					cube_vertices[72 + 30] = 1;
 					scale_br_object(tmp, scale, 0);
@@ -633,7 +645,7 @@ void merge_left(br_object_manager *x, int **hm, int startx, int startz, int widt
 					vec3 scale = {(float)loop, 1, 1};
 					cube_vertices[72 + 4] = (float)loop;
 					cube_vertices[72 + 31] = (float)loop;
-					br_object *tmp = create_br_object(x, &(cube_vertices[72]), 4, cube_indices, 6, texture_i, 0, 3, 10, 0.1f, 0.5f);
+					br_object *tmp = create_br_object(x, &(cube_vertices[72]), 4, cube_indices, 6, terrain_materials[(int)texture_i], 0, 3, 10, 0.1f, 0.5f);
 					cube_vertices[72 + 4] = 1;
 					cube_vertices[72 + 31] = 1;
 					scale_br_object(tmp, scale, 0);
@@ -690,7 +702,7 @@ void merge_right(br_object_manager *x, int **hm, int startx, int startz, int wid
 				if (type == 2)
 				{
 					vec3 translate = {(float)(i - (int)(dimensionx / 2)), (float)hm[i][i2], (float)(i2 - (int)(dimensionz / 2))};
-					br_object *tmp = create_br_object(x, &(cube_vertices[108]), 4, cube_indices, 6, texture_i, 0, 3, 10, 0.1f, 0.5f);
+					br_object *tmp = create_br_object(x, &(cube_vertices[108]), 4, cube_indices, 6, terrain_materials[(int)texture_i], 0, 3, 10, 0.1f, 0.5f);
 					translate_br_object(tmp, translate, 0);
 					done[i - startx][i2 - startz] = 1;
 				}
@@ -712,7 +724,7 @@ void merge_right(br_object_manager *x, int **hm, int startx, int startz, int wid
 					vec3 scale = {1, 1, (float)loop};
 					cube_vertices[108 + 21] = (float)loop;
 					cube_vertices[108 + 30] = (float)loop;
-					br_object *tmp = create_br_object(x, &(cube_vertices[108]), 4, cube_indices, 6, texture_i, 0, 3, 10, 0.1f, 0.5f);
+					br_object *tmp = create_br_object(x, &(cube_vertices[108]), 4, cube_indices, 6, terrain_materials[(int)texture_i], 0, 3, 10, 0.1f, 0.5f);
 					cube_vertices[108 + 21] = 1;
 					cube_vertices[108 + 30] = 1;
 					scale_br_object(tmp, scale, 0);
@@ -736,7 +748,7 @@ void merge_right(br_object_manager *x, int **hm, int startx, int startz, int wid
 					vec3 scale = {(float)loop, 1, 1};
 					cube_vertices[108 + 13] = (float)loop;
 					cube_vertices[108 + 22] = (float)loop;
-					br_object *tmp = create_br_object(x, &(cube_vertices[108]), 4, cube_indices, 6, texture_i, 0, 3, 10, 0.1f, 0.5f);
+					br_object *tmp = create_br_object(x, &(cube_vertices[108]), 4, cube_indices, 6, terrain_materials[(int)texture_i], 0, 3, 10, 0.1f, 0.5f);
 					cube_vertices[108 + 13] = 1;
 					cube_vertices[108 + 22] = 1;
 					scale_br_object(tmp, scale, 0);
@@ -793,7 +805,7 @@ void merge_vertical(br_object_manager *x, int **hm, int startx, int startz, int
 						vec3 scale = {1, (float)front, 1};
 						cube_vertices[0 + 13] = (float)front;
 						cube_vertices[0 + 22] = (float)front;
-						br_object *tmp = create_br_object(x, cube_vertices, 4, cube_indices, 6, 0, 0, 3, 10, 0.1f, 0.5f);
+						br_object *tmp = create_br_object(x, cube_vertices, 4, cube_indices, 6, terrain_materials[0], 0, 3, 10, 0.1f, 0.5f);
 						cube_vertices[0 + 13] = 1;
 						cube_vertices[0 + 22] = 1;
 						scale_br_object(tmp, scale, 0);
@@ -805,7 +817,7 @@ void merge_vertical(br_object_manager *x, int **hm, int startx, int startz, int
 						vec3 scale = {1, (float)back, 1};
 						cube_vertices[36 + 22] = (float)back;
 						cube_vertices[36 + 31] = (float)back;
-						br_object *tmp = create_br_object(x, &(cube_vertices[36]), 4, cube_indices, 6, 0, 0, 3, 10, 0.1f, 0.5f);
+						br_object *tmp = create_br_object(x, &(cube_vertices[36]), 4, cube_indices, 6, terrain_materials[0], 0, 3, 10, 0.1f, 0.5f);
 						cube_vertices[36 + 22] = 1;
 						cube_vertices[36 + 31] = 1;
 						scale_br_object(tmp, scale, 0);
@@ -817,7 +829,7 @@ void merge_vertical(br_object_manager *x, int **hm, int startx, int startz, int
 						vec3 scale = {1, (float)left, 1};
 						cube_vertices[72 + 4] = (float)left;
 						cube_vertices[72 + 31] = (float)left;
-						br_object *tmp = create_br_object(x, &(cube_vertices[72]), 4, cube_indices, 6, 0, 0, 3, 10, 0.1f, 0.5f);
+						br_object *tmp = create_br_object(x, &(cube_vertices[72]), 4, cube_indices, 6, terrain_materials[0], 0, 3, 10, 0.1f, 0.5f);
 						cube_vertices[72 + 4] = 1;
 						cube_vertices[72 + 31] = 1;
 						scale_br_object(tmp, scale, 0);
@@ -829,7 +841,7 @@ void merge_vertical(br_object_manager *x, int **hm, int startx, int startz, int
 						vec3 scale = {1, (float)right, 1};
 						cube_vertices[108 + 13] = (float)right;
 						cube_vertices[108 + 22] = (float)right;
-						br_object *tmp = create_br_object(x, &(cube_vertices[108]), 4, cube_indices, 6, 0, 0, 3, 10, 0.1f, 0.5f);
+						br_object *tmp = create_br_object(x, &(cube_vertices[108]), 4, cube_indices, 6, terrain_materials[0], 0, 3, 10, 0.1f, 0.5f);
 						cube_vertices[108 + 13] = 1;
 						cube_vertices[108 + 22] = 1;
 						scale_br_object(tmp, scale, 0);
@@ -864,14 +876,7 @@ world_batch *create_world_batch_facemerged(int **hm, int startx, int startz, int
 	// textures
 	if (tex_manager == 0)
 	{
-		tex_manager = create_br_texture_manager();
-		create_br_texture(tex_manager, "./textures/side.png", GL_TEXTURE_2D, GL_LINEAR_MIPMAP_LINEAR, GL_NEAREST, 0, GL_REPEAT, GL_REPEAT);
-		create_br_texture(tex_manager, "./textures/dirt_side.png", GL_TEXTURE_2D, GL_LINEAR_MIPMAP_LINEAR, GL_NEAREST, 1, GL_REPEAT, GL_CLAMP_TO_EDGE);
-		create_br_texture(tex_manager, "./textures/dirt.png", GL_TEXTURE_2D, GL_LINEAR_MIPMAP_LINEAR, GL_NEAREST, 2, GL_REPEAT, GL_REPEAT);
-		create_br_texture(tex_manager, "./textures/grass_side.png", GL_TEXTURE_2D, GL_LINEAR_MIPMAP_LINEAR, GL_NEAREST, 3, GL_REPEAT, GL_CLAMP_TO_EDGE);
-		create_br_texture(tex_manager, "./textures/grass.png", GL_TEXTURE_2D, GL_LINEAR_MIPMAP_LINEAR, GL_NEAREST, 4, GL_REPEAT, GL_REPEAT);
-		create_br_texture(tex_manager, "./textures/snow_side.png", GL_TEXTURE_2D, GL_LINEAR_MIPMAP_LINEAR, GL_NEAREST, 5, GL_REPEAT, GL_CLAMP_TO_EDGE);
-		create_br_texture(tex_manager, "./textures/snow.png", GL_TEXTURE_2D, GL_LINEAR_MIPMAP_LINEAR, GL_NEAREST, 6, GL_REPEAT, GL_REPEAT);
+		create_terrain_textures();
 	}
 
 	if (sealevel > 0)
@@ -911,21 +916,30 @@ world_batch *create_world_batch_facemerged(int **hm, int startx, int startz, int
 	merge_right(x->obj_manager, hm, startx, startz, widthx, widthz, dimensionx, dimensionz, done);
 	merge_vertical(x->obj_manager, hm, startx, startz, widthx, widthz, dimensionx, dimensionz);
 
-	prepare_render_br_object_manager(x->obj_manager);
+	x->land_draw = (world_draw){0, 0, 0};
+	x->water_draw = (world_draw){0, 0, 0};
 	return x;
 }
 
-void use_world_batch_land(world_batch *w, GLuint land_program)
+void add_world_batch(world_batch *w, world_buffer *b)
+{
+	w->land_draw = add_world_buffer(b, w->obj_manager);
+	if (w->w != 0)
+	{
+		w->water_draw = add_world_buffer(b, w->w->obj);
+	}
+}
+
+void push_world_batch_land(world_batch *w, world_buffer *b, vec3 offset)
 {
-	use_br_texture_manager(tex_manager, land_program);
-	use_br_object_manager(w->obj_manager, land_program);
+	push_world_buffer(b, &(w->land_draw), offset);
 }
 
-void use_world_batch_water(world_batch *w, GLuint water_program)
+void push_world_batch_water(world_batch *w, world_buffer *b, vec3 offset)
 {
 	if (w->w != 0)
 	{
-		use_water(w->w, water_program);
+		push_world_buffer(b, &(w->water_draw), offset);
 	}
 }
 
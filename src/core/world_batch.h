@@ -2,11 +2,14 @@
 #include "br_object.h"
 #include "br_texture.h"
 #include "water.h"
+#include "world_buffer.h"
 
 typedef struct world_batch
 {
 	br_object_manager *obj_manager;
 	water *w;
+	world_draw land_draw;
+	world_draw water_draw;
 	int chunk_id;
 } world_batch;
 
@@ -18,9 +21,13 @@ world_batch *create_world_batch_facemerged(int **hm, int startx, int startz, int
 																					 int dimensionx, int dimensionz, float sealevel,
 																					 unsigned char create_water_physic, unsigned char **done);
 
-void use_world_batch_land(world_batch *w, GLuint land_program);
+// copies the meshes into the shared world buffer, cpu memory of the managers can be deleted after this
+void add_world_batch(world_batch *w, world_buffer *b);
 
-void use_world_batch_water(world_batch *w, GLuint water_program);
+// offset is the translation of the chunk when it was snapshotted
+void push_world_batch_land(world_batch *w, world_buffer *b, vec3 offset);
+
+void push_world_batch_water(world_batch *w, world_buffer *b, vec3 offset);
 
 void delete_world_batch(world_batch *w);
 
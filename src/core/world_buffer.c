@@ -0,0 +1,219 @@
+#include "world_buffer.h"
+#include "gl_state.h"
+#include "macro.h"
+
+void setup_world_buffer_vao(world_buffer *b)
+{
+	bind_vertex_array(b->VAO);
+	bind_buffer(GL_ARRAY_BUFFER, b->VBO);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(GLfloat), 0);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 9 * sizeof(GLfloat), (void *)(3 * sizeof(GLfloat)));
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(GLfloat), (void *)(5 * sizeof(GLfloat)));
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, 9 * sizeof(GLfloat), (void *)(8 * sizeof(GLfloat)));
+	glEnableVertexAttribArray(3);
+	if (has_multi_draw_indirect)
+	{
+		// base_instance of every command points to its offset
+		bind_buffer(GL_ARRAY_BUFFER, b->OBO);
+		glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), 0);
+		glVertexAttribDivisor(4, 1);
+		glEnableVertexAttribArray(4);
+	}
+	bind_buffer(GL_ELEMENT_ARRAY_BUFFER, b->EBO);
+	bind_vertex_array(0);
+	bind_buffer(GL_ARRAY_BUFFER, 0);
+	bind_buffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+// makes a bigger buffer and copies the old content into it
+void grow_world_buffer_object(GLuint *buffer, GLsizeiptr old_size, GLsizeiptr new_size)
+{
+	GLuint x = 0;
+	glGenBuffers(1, &x);
+	bind_buffer(GL_COPY_WRITE_BUFFER, x);
+	glBufferData(GL_COPY_WRITE_BUFFER, new_size, 0, GL_STATIC_DRAW);
+	if (*buffer != 0 && old_size > 0)
+	{
+		bind_buffer(GL_COPY_READ_BUFFER, *buffer);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, old_size);
+		bind_buffer(GL_COPY_READ_BUFFER, 0);
+	}
+	bind_buffer(GL_COPY_WRITE_BUFFER, 0);
+	delete_buffers(1, buffer);
+	*buffer = x;
+}
+
+world_buffer *create_world_buffer(unsigned int vertex_capacity, unsigned int indice_capacity)
+{
+	world_buffer *x = malloc(sizeof(world_buffer));
+	x->VAO = 0;
+	x->VBO = 0;
+	x->EBO = 0;
+	x->IBO = 0;
+	x->OBO = 0;
+	x->vertex_capacity = max(vertex_capacity, 1);
+	x->vertex_number = 0;
+	x->indice_capacity = max(indice_capacity, 1);
+	x->indice_number = 0;
+	x->commands = create_DA_HIGH_MEMORY(sizeof(draw_elements_indirect_command), 0);
+	x->offsets = create_DA_HIGH_MEMORY(sizeof(vec4), 0);
+	x->counts = create_DA_HIGH_MEMORY(sizeof(GLsizei), 0);
+	x->starts = create_DA_HIGH_MEMORY(sizeof(void *), 0);
+	x->bases = create_DA_HIGH_MEMORY(sizeof(GLint), 0);
+	x->programs = create_DA(sizeof(GLuint), 0);
+	x->uniforms = create_DA(sizeof(GLint), 0);
+	glGenVertexArrays(1, &(x->VAO));
+	glGenBuffers(1, &(x->IBO));
+	glGenBuffers(1, &(x->OBO));
+	grow_world_buffer_object(&(x->VBO), 0, (GLsizeiptr)x->vertex_capacity * 9 * sizeof(GLfloat));
+	grow_world_buffer_object(&(x->EBO), 0, (GLsizeiptr)x->indice_capacity * sizeof(GLuint));
+	setup_world_buffer_vao(x);
+	return x;
+}
+
+void delete_world_buffer(world_buffer *b)
+{
+	delete_vertex_arrays(1, &(b->VAO));
+	delete_buffers(1, &(b->VBO));
+	delete_buffers(1, &(b->EBO));
+	delete_buffers(1, &(b->IBO));
+	delete_buffers(1, &(b->OBO));
+	delete_DA(b->commands);
+	delete_DA(b->offsets);
+	delete_DA(b->counts);
+	delete_DA(b->starts);
+	delete_DA(b->bases);
+	delete_DA(b->programs);
+	delete_DA(b->uniforms);
+	free(b);
+}
+
+world_draw add_world_buffer(world_buffer *b, br_object_manager *manager)
+{
+	world_draw d = {0, 0, 0};
+	if (manager->vertices == 0 || manager->indices == 0 || get_size_DA(manager->indices) == 0)
+	{
+		return d;
+	}
+	unsigned int vertex_number = get_size_DA(manager->vertices) / 9;
+	unsigned int indice_number = get_size_DA(manager->indices);
+	unsigned char regrow = 0;
+	if (b->vertex_number + vertex_number > b->vertex_capacity)
+	{
+		unsigned int capacity = max(b->vertex_capacity * 2, b->vertex_number + vertex_number);
+		grow_world_buffer_object(&(b->VBO), (GLsizeiptr)b->vertex_number * 9 * sizeof(GLfloat), (GLsizeiptr)capacity * 9 * sizeof(GLfloat));
+		b->vertex_capacity = capacity;
+		regrow = 1;
+	}
+	if (b->indice_number + indice_number > b->indice_capacity)
+	{
+		unsigned int capacity = max(b->indice_capacity * 2, b->indice_number + indice_number);
+		grow_world_buffer_object(&(b->EBO), (GLsizeiptr)b->indice_number * sizeof(GLuint), (GLsizeiptr)capacity * sizeof(GLuint));
+		b->indice_capacity = capacity;
+		regrow = 1;
+	}
+	if (regrow)
+	{
+		setup_world_buffer_vao(b);
+	}
+	d.vertex_start = b->vertex_number;
+	d.indice_start = b->indice_number;
+	d.indice_number = indice_number;
+	bind_buffer(GL_COPY_WRITE_BUFFER, b->VBO);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)d.vertex_start * 9 * sizeof(GLfloat), (GLsizeiptr)vertex_number * 9 * sizeof(GLfloat), get_data_DA(manager->vertices));
+	bind_buffer(GL_COPY_WRITE_BUFFER, b->EBO);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)d.indice_start * sizeof(GLuint), (GLsizeiptr)indice_number * sizeof(GLuint), get_data_DA(manager->indices));
+	bind_buffer(GL_COPY_WRITE_BUFFER, 0);
+	b->vertex_number += vertex_number;
+	b->indice_number += indice_number;
+	return d;
+}
+
+void clear_world_buffer(world_buffer *b)
+{
+	clear_DA(b->commands);
+	clear_DA(b->offsets);
+}
+
+void push_world_buffer(world_buffer *b, world_draw *d, vec3 offset)
+{
+	if (d->indice_number == 0)
+	{
+		return;
+	}
+	draw_elements_indirect_command x = {
+			.count = d->indice_number,
+			.instance_count = 1,
+			.first_index = d->indice_start,
+			.base_vertex = (GLint)d->vertex_start,
+			.base_instance = get_size_DA(b->commands)};
+	pushback_DA(b->commands, &x);
+	vec4 o = {offset[0], offset[1], offset[2], 0};
+	pushback_DA(b->offsets, o);
+}
+
+void use_world_buffer(world_buffer *b, GLuint program)
+{
+	unsigned int draw_number = get_size_DA(b->commands);
+	if (draw_number == 0)
+	{
+		return;
+	}
+	if (get_index_DA(b->programs, &program) == UINT_MAX)
+	{
+		pushback_DA(b->programs, &program);
+		GLint uniform = glGetUniformLocation(program, "model");
+		pushback_DA(b->uniforms, &uniform);
+		uniform = glGetUniformLocation(program, "normalMatrix");
+		pushback_DA(b->uniforms, &uniform);
+	}
+	GLint *uniforms = get_data_DA(b->uniforms);
+	unsigned int index = get_index_DA(b->programs, &program);
+	mat4 identity = GLM_MAT4_IDENTITY_INIT;
+	glUniformMatrix4fv(uniforms[index * 2], 1, GL_FALSE, identity[0]);
+	glUniformMatrix4fv(uniforms[index * 2 + 1], 1, GL_FALSE, identity[0]);
+
+	draw_elements_indirect_command *commands = get_data_DA(b->commands);
+	vec4 *offsets = get_data_DA(b->offsets);
+	bind_vertex_array(b->VAO);
+	if (has_multi_draw_indirect)
+	{
+		bind_buffer(GL_ARRAY_BUFFER, b->OBO);
+		glBufferData(GL_ARRAY_BUFFER, draw_number * sizeof(vec4), offsets, GL_STREAM_DRAW);
+		bind_buffer(GL_DRAW_INDIRECT_BUFFER, b->IBO);
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, draw_number * sizeof(draw_elements_indirect_command), commands, GL_STREAM_DRAW);
+		glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, 0, draw_number, 0);
+	}
+	else
+	{
+		// chunks that are not moving go in one multi draw, animating ones are drawn one by one with a constant offset
+		clear_DA(b->counts);
+		clear_DA(b->starts);
+		clear_DA(b->bases);
+		for (unsigned int i = 0; i < draw_number; i++)
+		{
+			void *start = (void *)((size_t)commands[i].first_index * sizeof(GLuint));
+			if (offsets[i][0] == 0 && offsets[i][1] == 0 && offsets[i][2] == 0)
+			{
+				GLsizei count = (GLsizei)commands[i].count;
+				pushback_DA(b->counts, &count);
+				pushback_DA(b->starts, &start);
+				pushback_DA(b->bases, &(commands[i].base_vertex));
+			}
+			else
+			{
+				glVertexAttrib3f(4, offsets[i][0], offsets[i][1], offsets[i][2]);
+				glDrawElementsBaseVertex(GL_TRIANGLES, commands[i].count, GL_UNSIGNED_INT, start, commands[i].base_vertex);
+			}
+		}
+		glVertexAttrib3f(4, 0, 0, 0);
+		if (get_size_DA(b->counts) > 0)
+		{
+			glMultiDrawElementsBaseVertex(GL_TRIANGLES, get_data_DA(b->counts), GL_UNSIGNED_INT, get_data_DA(b->starts),
+																		get_size_DA(b->counts), get_data_DA(b->bases));
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,45 @@
+#pragma once
+#include "../../third_party/opengl/include/glad/glad.h"
+#include "dynamic.h"
+#include "br_object.h"
+#include "gl_extensions.h"
+
+// all chunk meshes live in one vertex buffer and one index buffer, every pass draws its visible chunks with one multi draw.
+// vertex layout is same as br_object_manager. only translation of a chunk is used, it is sent as a per draw offset (location 4)
+
+typedef struct world_draw
+{
+	unsigned int vertex_start;
+	unsigned int indice_start;
+	unsigned int indice_number;
+} world_draw;
+
+typedef struct world_buffer
+{
+	GLuint VAO, VBO, EBO, IBO, OBO; // IBO holds indirect commands, OBO holds per draw offsets
+	unsigned int vertex_capacity;
+	unsigned int vertex_number;
+	unsigned int indice_capacity;
+	unsigned int indice_number;
+	DA *commands;
+	DA *offsets;
+	DA *counts; // used when there is no multi draw indirect
+	DA *starts;
+	DA *bases;
+	DA *programs; // i will save uniforms here. i wont find their locations everytime i render for performance
+	DA *uniforms;
+} world_buffer;
+
+world_buffer *create_world_buffer(unsigned int vertex_capacity, unsigned int indice_capacity);
+
+void delete_world_buffer(world_buffer *b);
+
+// copies the cpu side vertices and indices of manager, call it before delete_cpu_memory_br_object_manager
+world_draw add_world_buffer(world_buffer *b, br_object_manager *manager);
+
+void clear_world_buffer(world_buffer *b);
+
+void push_world_buffer(world_buffer *b, world_draw *d, vec3 offset);
+
+// draws everything pushed since last clear
+void use_world_buffer(world_buffer *b, GLuint program);
\ No newline at end of file
@@ -2,18 +2,23 @@
 #include "ins_object.h"
 #include "br_texture.h"
 
+// visible voxel faces of a heightmap, 8 bytes each. every chunk_size x chunk_size chunk is one INS_FORMAT_VOXEL manager
+// and one draw, chunks are ordered like chunk_op (x * chunknumberincolumn + z)
 typedef struct world_instanced
 {
-	ins_object_manager *obj_manager_left;
-	ins_object_manager *obj_manager_right;
-	ins_object_manager *obj_manager_front;
-	ins_object_manager *obj_manager_back;
-	ins_object_manager *obj_manager_top;
+	DA *chunks; // ins_object_manager *
+	int chunk_size;
+	int chunknumberinrow;
+	int chunknumberincolumn;
 	br_texture_manager *tex_manager;
 } world_instanced;
 
-world_instanced *create_world_instanced(int **hm, int dimensionx, int dimensionz);
+world_instanced *create_world_instanced(int **hm, int dimensionx, int dimensionz, int chunk_size);
 
+// program is get_def_tex_light_ins_program(INS_FORMAT_VOXEL) or the shadow map one
 void use_world_instanced(world_instanced *w, GLuint program);
 
+// draws one chunk, tex_manager has to be bound already
+void use_world_instanced_chunk(world_instanced *w, int chunk_id);
+
 void delete_world_instanced(world_instanced *w);
\ No newline at end of file
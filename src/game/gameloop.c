@@ -1,11 +1,37 @@
 #include "gameloop.h"
 #include "../core/core.h"
+#include <stdio.h>
 
 unsigned char loading_done = 0;
 
+typedef struct hud_fields
+{
+  unsigned int frame, fps, average_frame, average_fps, threads;
+  unsigned int bodies, triangles, lights, gpu;
+} hud_fields;
+
+// everything a frame is rendered from, written at the end of its simulation. with threaded there are two,
+// the simulation of the next frame writes one while the render thread draws the other
+typedef struct frame_snapshot
+{
+  vec3 cam_position, cam_orientation, cam_up;
+  player_snapshot player;
+  DA *chunks; // chunk_draw
+  unsigned char terrain_changed;
+  unsigned char wireframe;
+  unsigned char fxaa;
+  unsigned char toggle_csv;
+  unsigned char quit; // render thread stops without drawing it
+  double frame_ms, average_frame_ms, sim_ms;
+  double work_ms; // frame_ms without the pacer wait, resolution scale follows it
+  int body_count, active_body_count;
+  vec3 gravity;
+} frame_snapshot;
+
 typedef struct loads
 {
-  camera *cam;
+  camera *cam;     // render camera, positioned from the snapshot
+  camera *sim_cam; // moved by input and the player
   lighting *light;
   void *window;
   int **hm;
@@ -13,6 +39,7 @@ typedef struct loads
   int dimensionz;
   player *p;
   chunk_op *chunks;
+  glyph_atlas *atlas;
   text_manager *t;
   skybox *s;
   bodyid *hm_boxes;
@@ -22,16 +49,54 @@ typedef struct loads
   unsigned char loadgsu;
   unsigned char ssao;
   unsigned char facemerged;
+  unsigned char headless;
+  unsigned char demo_lights;
+  unsigned int lamp; // point light following the camera with demo_lights
+  // render side
+  frame_graph *graph;
+  hud_fields hud;
+  frame_snapshot *frame; // being rendered
+  frame_snapshot frames[2];
+  Semaphore *snapshot_ready, *snapshot_free;
+  double render_ms;
+  char gpu_text[512];
+  char graph_text[128];
 } loads;
 
+// torches on the terrain around the start and a lamp that follows the camera,
+// lighting only visits the ones near a pixel
+void add_demo_lights(loads *resss, vec3 cam_pos)
+{
+  for (int i = -8; i < 8; i++)
+  {
+    for (int i2 = -8; i2 < 8; i2++)
+    {
+      int x = resss->dimensionx / 2 + i * 8;
+      int z = resss->dimensionz / 2 + i2 * 8;
+      if (x < 0 || z < 0 || x >= resss->dimensionx || z >= resss->dimensionz)
+      {
+        continue;
+      }
+      vec3 position = {(float)(i * 8), max((float)resss->hm[x][z], resss->sealevel) + 2.0f, (float)(i2 * 8)};
+      vec3 color = {random_float(2, 4), random_float(1, 2), random_float(0.2f, 0.6f)};
+      add_lighting_point_light(resss->light, position, color, 10);
+    }
+  }
+  vec3 lamp_color = {1.5f, 1.5f, 1.2f};
+  resss->lamp = add_lighting_point_light(resss->light, cam_pos, lamp_color, 8);
+}
+
 void loadres(void *ress)
 {
   loads *resss = (loads *)ress;
   glfwMakeContextCurrent((GLFWwindow *)resss->window);
+  reset_gl_state();
   int window_w = 0, window_h = 0;
   glfwGetWindowSize((GLFWwindow *)resss->window, &window_w, &window_h);
+  // sdf glyphs serve the loading screen and the hud from one atlas
+  resss->atlas = create_glyph_atlas("./fonts/arial.ttf", 1024, 1024, 1);
   {
-    text_manager *t = create_text_manager("./fonts/arial.ttf", 128, 1920, 1080, window_w, window_h, GL_LINEAR, GL_LINEAR);
+    text_manager *t = create_text_manager(resss->atlas, 128, 1920, 1080, window_w, window_h);
     float width, height;
     vec4 red = {1, 1, 1, 1};
     get_text_size(t, 1, "Loading...", &width, &height);
@@ -43,7 +108,7 @@ void loadres(void *ress)
     height = (1080 - height) / 2.0f - 200;
     add_text(t, width, height, 1, 1, red, "Sukru Ciris Engine");
     glClear(GL_COLOR_BUFFER_BIT);
-    glUseProgram(get_def_text_program());
+    use_program(get_def_text_program());
     use_text_manager(t, get_def_text_program());
     glfwSwapBuffers((GLFWwindow *)resss->window);
     delete_text_manager(t);
@@ -57,11 +122,28 @@ void loadres(void *ress)
   vec3 cam_pos = {0.0f, 5, 60.0f};
   vec3 angle_axis = {0, 1, 0};
   resss->cam = create_camera(window_w, window_h, cam_pos, 60, 0.1f, render_distance, 1, 100, -90, angle_axis);
+  resss->sim_cam = create_camera(window_w, window_h, cam_pos, 60, 0.1f, render_distance, 1, 100, -90, angle_axis);
 
-  resss->light = create_lighting((GLFWwindow *)resss->window, resss->cam, 4096, 4096, render_distance / 64, render_distance / 16,
+  // near cascade gets most of the texels, far ones cover more but need less detail
+  GLuint cascade_sizes[4] = {4096, 2048, 1024, 1024};
+  resss->light = create_lighting((GLFWwindow *)resss->window, resss->cam, cascade_sizes, GL_DEPTH_COMPONENT32F, render_distance / 64, render_distance / 16,
                                  render_distance / 4, render_distance, fog_start, fog_end, dark_fog_color, 1, resss->ssao);
   resss->light->fxaa = 1;
+  // scene passes go down to half resolution when a frame takes longer than 60 fps
+  resss->light->target_frame_ms = 1000.0 / 60.0;
+  resss->light->min_resolution_scale = 0.5f;
   resss->light->vignette_pp = 1;
+  if (resss->headless)
+  {
+    create_lighting_offscreen(resss->light);
+    // timing runs should be comparable, keep full resolution
+    resss->light->target_frame_ms = 0;
+  }
+
+  if (resss->demo_lights)
+  {
+    add_demo_lights(resss, cam_pos);
+  }
 
   struct aiScene *gsu_model = 0;
   if (resss->loadgsu)
@@ -71,20 +153,14 @@ void loadres(void *ress)
   }
 
   float startpos[3] = {0, max((float)resss->hm[resss->dimensionx / 2][resss->dimensionz / 2], resss->sealevel) + 5.0f, 0};
-  resss->p = create_player(resss->cam, 3, 5, 0.75f, 2, 0.8f, 2, resss->hm, resss->dimensionx, resss->dimensionz,
+  resss->p = create_player(resss->sim_cam, 3, 5, 0.75f, 2, 0.8f, 2, resss->hm, resss->dimensionx, resss->dimensionz,
                            "./models/player.fbx", startpos, 80, 100, 70, 1);
 
   resss->chunks = create_chunk_op(resss->chunk_size, resss->chunk_range, resss->p, resss->hm,
                                   resss->dimensionx, resss->dimensionz, 0, resss->sealevel, resss->facemerged);
 
-  resss->t = create_text_manager("./fonts/arial.ttf", 16, 1920, 1080, window_w, window_h, GL_LINEAR, GL_LINEAR);
-
-  float width, height;
-  vec4 red = {1, 0, 0, 1};
-  get_text_size(resss->t, 1, "Sukru Ciris Engine", &width, &height);
-  width = 1920 - width;
-  height = 1080 - height;
-  add_text(resss->t, width, height, 1, 1, red, "Sukru Ciris Engine");
+  resss->t = create_text_manager(resss->atlas, 16, 1920, 1080, window_w, window_h);
+  resss->t->framebuffer = resss->light->outputfbo;
 
   vec3 rotate_axis = {1, 1, 1};
   resss->s = create_skybox("./textures/skybox/eso/right.png",
@@ -102,9 +178,321 @@ void loadres(void *ress)
   loading_done = 1;
 }
 
+int compare_frame_times(const void *a, const void *b)
+{
+  double x = *(const double *)a;
+  double y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+void print_run_statistics(DA *frame_times)
+{
+  unsigned int count = get_size_DA(frame_times);
+  if (count == 0)
+  {
+    return;
+  }
+  double *times = get_data_DA(frame_times);
+  double total = 0;
+  for (unsigned int i = 0; i < count; i++)
+  {
+    total += times[i];
+  }
+  qsort(times, count, sizeof(double), compare_frame_times);
+  char gpu_text[512];
+  get_gpu_timing_text(gpu_text, sizeof(gpu_text));
+  printf("Frames: %u\nTotal: %.2lf s\nAverage Frame: %.2lf ms\nAverage FPS: %.1lf\n"
+         "Min Frame: %.2lf ms\nMedian Frame: %.2lf ms\n99th Percentile Frame: %.2lf ms\nMax Frame: %.2lf ms\n%s\n",
+         count, total / 1000.0, total / count, 1000.0 * count / total, times[0], times[count / 2],
+         times[(unsigned int)(count * 0.99)], times[count - 1], gpu_text);
+  fflush(stdout);
+}
+
+void shadow_pass(void *data)
+{
+  loads *resss = (loads *)data;
+  use_program(get_def_shadowmap_br_program());
+  if (use_lighting_shadowpass(resss->light, get_def_shadowmap_br_program()))
+  {
+    for (int i = 0; i < 4; i++)
+    {
+      if (use_lighting_shadow_cascade(resss->light, get_def_shadowmap_br_program(), i))
+      {
+        use_chunk_op_cascade(resss->chunks, get_def_shadowmap_br_program(), i);
+      }
+    }
+  }
+  // player is the only dynamic caster, its sphere is generous because model origin is not centered
+  use_lighting_shadowpass_dynamic(resss->light, get_def_shadowmap_br_program(), resss->frame->player.position, resss->p->height + resss->p->width);
+  for (int i = 0; i < 4; i++)
+  {
+    if (use_lighting_shadow_cascade(resss->light, get_def_shadowmap_br_program(), i))
+    {
+      render_player(resss->p, &resss->frame->player, get_def_shadowmap_br_program());
+    }
+  }
+}
+
+void gbuffer_pass(void *data)
+{
+  loads *resss = (loads *)data;
+  if (resss->frame->wireframe == 1)
+  {
+    set_polygon_mode(GL_FRONT_AND_BACK, GL_LINE);
+  }
+  use_program(get_def_gbuffer_br_program());
+  use_lighting_gbuffer(resss->light, get_def_gbuffer_br_program(), 1);
+  use_chunk_op(resss->chunks, get_def_gbuffer_br_program(), 0);
+  render_player(resss->p, &resss->frame->player, get_def_gbuffer_br_program());
+}
+
+void skybox_pass(void *data)
+{
+  loads *resss = (loads *)data;
+  use_program(get_def_skybox_program());
+  use_skybox(resss->s, get_def_skybox_program());
+}
+
+void water_pass(void *data)
+{
+  loads *resss = (loads *)data;
+  use_program(get_def_water_program());
+  use_lighting_gbuffer_blend(resss->light, get_def_water_program());
+  use_chunk_op(resss->chunks, get_def_water_program(), 1);
+  if (resss->frame->wireframe == 1)
+  {
+    set_polygon_mode(GL_FRONT_AND_BACK, GL_FILL);
+  }
+}
+
+void ssao_pass(void *data)
+{
+  loads *resss = (loads *)data;
+  GLuint ssao_program = get_def_ssao_program(get_lighting_ssao_variant(resss->light));
+  use_program(ssao_program);
+  use_lighting_ssao(resss->light, ssao_program);
+}
+
+void ssao_blur_pass(void *data)
+{
+  loads *resss = (loads *)data;
+  use_program(get_def_ssao_blur_program());
+  use_lighting_ssao_blur(resss->light, get_def_ssao_blur_program());
+}
+
+void deferred_pass(void *data)
+{
+  loads *resss = (loads *)data;
+  GLuint deferred_program = get_def_deferred_br_program(get_lighting_deferred_variant(resss->light));
+  use_program(deferred_program);
+  use_lighting_deferred(resss->light, deferred_program);
+}
+
+void postprocess_pass(void *data)
+{
+  loads *resss = (loads *)data;
+  GLuint post_process_program = get_def_post_process_program(get_lighting_postprocess_variant(resss->light));
+  use_program(post_process_program);
+  use_lighting_postprocess(resss->light, post_process_program);
+}
+
+void text_pass(void *data)
+{
+  loads *resss = (loads *)data;
+  use_program(get_def_text_program());
+  use_text_manager(resss->t, get_def_text_program());
+}
+
+// passes are declared again every frame, ssao is culled when deferred does not read it
+void declare_frame(frame_graph *g, loads *resss)
+{
+  lighting *l = resss->light;
+  reset_frame_graph(g);
+  add_lighting_targets(l, g);
+  unsigned int gbuffer[3] = {l->gnormal_target, l->gtexcoord_target, l->gdepth_target};
+
+  unsigned int pass = add_frame_graph_pass(g, "shadow", shadow_pass, resss, 0);
+  write_frame_graph_pass(g, pass, l->shadow_target);
+
+  // sky after the scene so water blends over it, all three draw into the same gbuffer
+  frame_graph_execute gbuffer_passes[3] = {gbuffer_pass, skybox_pass, water_pass};
+  const char *gbuffer_names[3] = {"gbuffer", "skybox", "water"};
+  for (int i = 0; i < 3; i++)
+  {
+    pass = add_frame_graph_pass(g, gbuffer_names[i], gbuffer_passes[i], resss, 0);
+    for (int j = 0; j < 3; j++)
+    {
+      write_frame_graph_pass(g, pass, gbuffer[j]);
+    }
+  }
+
+  pass = add_frame_graph_pass(g, "ssao", ssao_pass, resss, 0);
+  read_frame_graph_pass(g, pass, l->gdepth_target);
+  read_frame_graph_pass(g, pass, l->gnormal_target);
+  write_frame_graph_pass(g, pass, l->ssao_target);
+
+  pass = add_frame_graph_pass(g, "ssao blur", ssao_blur_pass, resss, 0);
+  read_frame_graph_pass(g, pass, l->ssao_target);
+  write_frame_graph_pass(g, pass, l->ssaoblur_target);
+
+  pass = add_frame_graph_pass(g, "deferred", deferred_pass, resss, 0);
+  for (int j = 0; j < 3; j++)
+  {
+    read_frame_graph_pass(g, pass, gbuffer[j]);
+  }
+  read_frame_graph_pass(g, pass, l->shadow_target);
+  if (resss->ssao != SSAO_OFF)
+  {
+    read_frame_graph_pass(g, pass, l->ssaoblur_target);
+  }
+  write_frame_graph_pass(g, pass, l->deferred_target);
+
+  // these two write the window or the offscreen output
+  pass = add_frame_graph_pass(g, "postprocess", postprocess_pass, resss, 1);
+  read_frame_graph_pass(g, pass, l->deferred_target);
+  read_frame_graph_pass(g, pass, l->gdepth_target);
+
+  add_frame_graph_pass(g, "text", text_pass, resss, 1);
+}
+
+// labels that never change are added once, values are fields so a frame only rewrites the glyphs of changed lines
+void create_hud(text_manager *t, int seedx, int seedz, hud_fields *hud)
+{
+  float width, height;
+  vec4 red = {1, 0, 0, 1};
+  float line = get_text_line_height(t, 1);
+
+  get_text_size(t, 1, "Sukru Ciris Engine", &width, &height);
+  add_text(t, 1920 - width, 1080 - height, 1, 1, red, "Sukru Ciris Engine");
+  get_text_size(t, 1, "AI Enhanced Voxel Game Engine", &width, &height);
+  add_text(t, 1920 - width, 1060 - height, 1, 1, red, "AI Enhanced Voxel Game Engine");
+
+  // gpu pass names are not known before the first frames, the block starts where the widest line would
+  get_text_size(t, 1, "GPU postprocess: 00.00 ms", &width, &height);
+  hud->gpu = add_text_field(t, 1920 - width, 1020 - height, 1, 1, red, 512);
+
+  get_text_size(t, 1, "Frame: 0.00 ms", &width, &height);
+  float y = 1080 - height;
+  hud->frame = add_text_field(t, 0, y, 1, 1, red, 32);
+  hud->fps = add_text_field(t, 0, y - line, 1, 1, red, 32);
+  hud->average_frame = add_text_field(t, 0, y - line * 2, 1, 1, red, 32);
+  hud->average_fps = add_text_field(t, 0, y - line * 3, 1, 1, red, 32);
+  hud->threads = add_text_field(t, 0, y - line * 4, 1, 1, red, 64);
+  y -= line * 6;
+
+  if (seedx != -1 || seedz != -1)
+  {
+    add_text_variadic(t, 0, y, 1, 1, red, "Seedx: %d\nSeedz: %d", seedx, seedz);
+    y -= line * 3;
+  }
+  else
+  {
+    add_text(t, 0, y, 1, 1, red, "Using heightmap texture");
+    y -= line * 2;
+  }
+
+  hud->bodies = add_text_field(t, 0, y, 1, 1, red, 128);
+  y -= line * 4;
+
+  add_text(t, 0, y, 1, 1, red, "Press K to change camera\nPress F to disable/enable FXAA\nPress R to disable/enable wireframe render\nPress P to start/stop GPU timing csv");
+  y -= line * 5;
+
+  hud->triangles = add_text_field(t, 0, y, 1, 1, red, 256);
+  y -= line * 5;
+
+  hud->lights = add_text_field(t, 0, y, 1, 1, red, 64);
+}
+
+// draws f, the gl context has to be current on the calling thread
+void render_frame(loads *resss, frame_snapshot *f)
+{
+  double render_start = get_timems();
+  next_frame_gl_state();
+  next_frame_gpu_timing();
+  resss->frame = f;
+
+  {
+    text_manager *t = resss->t;
+    hud_fields *hud = &resss->hud;
+    set_text_field_variadic(t, hud->frame, "Frame: %.2lf ms", f->frame_ms);
+    set_text_field_variadic(t, hud->fps, "FPS: %d", (int)(1000.0 / f->frame_ms));
+    set_text_field_variadic(t, hud->average_frame, "Average Frame: %.2lf ms", f->average_frame_ms);
+    set_text_field_variadic(t, hud->average_fps, "Average FPS: %d", (int)(1000.0 / f->average_frame_ms));
+    set_text_field_variadic(t, hud->threads, "Simulation: %.2lf ms, Render: %.2lf ms", f->sim_ms, resss->render_ms);
+    set_text_field_variadic(t, hud->bodies, "Jolt Body Count: %d\nJolt Active Body Count: %d\nJolt Gravity: {%.2lf | %.2lf | %.2lf}",
+                            f->body_count, f->active_body_count, f->gravity[0], f->gravity[1], f->gravity[2]);
+    get_frame_graph_text(resss->graph, resss->graph_text, sizeof(resss->graph_text));
+    set_text_field_variadic(t, hud->triangles, "Whole world triangle count: %d\nCurrently rendering triangle count: %d\nSaved GL state calls: %u\n%s",
+                            get_world_triangle_count(), get_rendered_triangle_count(), get_saved_gl_calls(), resss->graph_text);
+    get_gpu_timing_text(resss->gpu_text, sizeof(resss->gpu_text));
+    set_text_field(t, hud->gpu, resss->gpu_text);
+  }
+
+  if (f->toggle_csv)
+  {
+    if (is_gpu_timing_csv())
+    {
+      stop_gpu_timing_csv();
+    }
+    else
+    {
+      start_gpu_timing_csv("./gpu_timing.csv");
+    }
+  }
+  resss->light->fxaa = f->fxaa;
+
+  glm_vec3_copy(f->cam_position, resss->cam->position);
+  glm_vec3_copy(f->cam_orientation, resss->cam->orientation);
+  glm_vec3_copy(f->cam_up, resss->cam->up);
+  if (resss->demo_lights)
+  {
+    set_lighting_light_position(resss->light, resss->lamp, f->cam_position);
+  }
+  if (f->terrain_changed)
+  {
+    invalidate_shadow_cache(resss->light);
+  }
+  update_lighting_resolution(resss->light, f->work_ms);
+  update_lighting(resss->light);
+  // counted by update_lighting for this frame
+  set_text_field_variadic(resss->t, resss->hud.lights, "Point lights: %u visible of %u", resss->light->visible_light_count,
+                          resss->light->light_count);
+  update_visibility_chunk_op(resss->chunks, f->chunks, resss->cam, resss->light);
+
+  declare_frame(resss->graph, resss);
+  compile_frame_graph(resss->graph);
+  get_lighting_targets(resss->light, resss->graph);
+  execute_frame_graph(resss->graph);
+
+  glfwSwapBuffers((GLFWwindow *)resss->window);
+  throttle_gpu_frames(get_frames_in_flight());
+  resss->render_ms = get_timems() - render_start;
+}
+
+// owns the gl context while the main thread simulates, snapshots are drawn in the order they were written
+void render_thread(void *data)
+{
+  loads *resss = (loads *)data;
+  glfwMakeContextCurrent((GLFWwindow *)resss->window);
+  reset_gl_state();
+  for (unsigned int i = 0;; i++)
+  {
+    wait_semaphore(resss->snapshot_ready);
+    frame_snapshot *f = &resss->frames[i % 2];
+    if (f->quit)
+    {
+      break;
+    }
+    render_frame(resss, f);
+    post_semaphore(resss->snapshot_free);
+  }
+  glfwMakeContextCurrent(0);
+}
+
 void gameloop(void *window, int **hm, int seedx, int seedz, int dimensionx, int dimensionz,
               float sealevel, int chunk_range, int chunk_size, unsigned char loadgsu, unsigned char ssao,
-              unsigned char facemerged, unsigned char chunkanimations)
+              unsigned char facemerged, unsigned char chunkanimations,
+              unsigned char headless, unsigned char threaded, unsigned char demo_lights, int run_frames, double run_seconds)
 {
   init_animations();
   float gravity[3] = {0, -10, 0};
@@ -121,6 +509,8 @@ void gameloop(void *window, int **hm, int seedx, int seedz, int dimensionx, int
   resss.loadgsu = loadgsu;
   resss.ssao = ssao;
   resss.facemerged = facemerged;
+  resss.headless = headless;
+  resss.demo_lights = demo_lights;
   glfwMakeContextCurrent(0);
   Thread *load_thread = create_thread(loadres, &resss);
 
@@ -142,51 +532,40 @@ void gameloop(void *window, int **hm, int seedx, int seedz, int dimensionx, int
     }
     glfwSetInputMode((GLFWwindow *)window, GLFW_CURSOR, GLFW_CURSOR_HIDDEN);
     glfwMakeContextCurrent(window);
+    reset_gl_state();
   }
+  init_gpu_timing();
 
-  float width, height;
-  vec4 red = {1, 0, 0, 1};
+  DA *frame_times = create_DA(sizeof(double), 0);
+  double run_start = get_timems();
+  double frame_start = run_start;
+
+  create_hud(resss.t, seedx, seedz, &resss.hud);
+  resss.graph = create_frame_graph();
+  resss.graph_text[0] = 0;
+  resss.render_ms = 0;
+  for (int i = 0; i < 2; i++)
+  {
+    resss.frames[i].chunks = create_DA_HIGH_MEMORY(sizeof(chunk_draw), 0);
+    resss.frames[i].quit = 0;
+  }
+  resss.snapshot_ready = create_semaphore(0);
+  resss.snapshot_free = create_semaphore(2);
 
   unsigned char wireframe = 0;
+  unsigned char fxaa = resss.light->fxaa;
+  Thread *render = 0;
+  if (threaded)
+  {
+    glfwMakeContextCurrent(0);
+    render = create_thread(render_thread, &resss);
+  }
+  unsigned int frame_number = 0;
 
   while (!glfwWindowShouldClose((GLFWwindow *)window))
   {
     start_game_loop();
-
-    {
-      clear_text_manager(resss.t);
-
-      get_text_size(resss.t, 1, "Sukru Ciris Engine", &width, &height);
-      width = 1920 - width;
-      height = 1080 - height;
-      add_text(resss.t, width, height, 1, 1, red, "Sukru Ciris Engine");
-
-      get_text_size(resss.t, 1, "AI Enhanced Voxel Game Engine", &width, &height);
-      width = 1920 - width;
-      height = 1060 - height;
-      add_text(resss.t, width, height, 1, 1, red, "AI Enhanced Voxel Game Engine");
-
-      get_gravity_jolt(gravity);
-
-      if (seedx != -1 || seedz != -1)
-      {
-        get_text_size_variadic(resss.t, 1, &width, &height, "Frame: %.2lf ms\nFPS: %d\nAverage Frame: %.2lf ms\nAverage FPS: %d\n\nSeedx: %d\nSeedz: %d\n\nJolt Body Count: %d\nJolt Active Body Count: %d\nJolt Gravity: {%.2lf | %.2lf | %.2lf}\n\nPress K to change camera\nPress F to disable/enable FXAA\nPress R to disable/enable wireframe render\n\nWhole world triangle count: %d\nCurrently rendering triangle count: %d",
-                               get_frame_timems(), (int)(1000.0 / get_frame_timems()), get_average_frame_timems(), (int)(1000.0 / get_average_frame_timems()), seedx, seedz, get_body_count_jolt(), get_active_body_count_jolt(), gravity[0], gravity[1], gravity[2], get_world_triangle_count(), get_rendered_triangle_count());
-        width = 0;
-        height = 1080 - height;
-        add_text_variadic(resss.t, width, height, 1, 1, red, "Frame: %.2lf ms\nFPS: %d\nAverage Frame: %.2lf ms\nAverage FPS: %d\n\nSeedx: %d\nSeedz: %d\n\nJolt Body Count: %d\nJolt Active Body Count: %d\nJolt Gravity: {%.2lf | %.2lf | %.2lf}\n\nPress K to change camera\nPress F to disable/enable FXAA\nPress R to disable/enable wireframe render\n\nWhole world triangle count: %d\nCurrently rendering triangle count: %d",
-                          get_frame_timems(), (int)(1000.0 / get_frame_timems()), get_average_frame_timems(), (int)(1000.0 / get_average_frame_timems()), seedx, seedz, get_body_count_jolt(), get_active_body_count_jolt(), gravity[0], gravity[1], gravity[2], get_world_triangle_count(), get_rendered_triangle_count());
-      }
-      else
-      {
-        get_text_size_variadic(resss.t, 1, &width, &height, "Frame: %.2lf ms\nFPS: %d\nAverage Frame: %.2lf ms\nAverage FPS: %d\n\nUsing heightmap texture\n\nJolt Body Count: %d\nJolt Active Body Count: %d\nJolt Gravity: {%.2lf | %.2lf | %.2lf}\n\nPress K to change camera\nPress F to disable/enable FXAA\nPress R to disable/enable wireframe render\n\nWhole world triangle count: %d\nCurrently rendering triangle count: %d",
-                               get_frame_timems(), (int)(1000.0 / get_frame_timems()), get_average_frame_timems(), (int)(1000.0 / get_average_frame_timems()), get_body_count_jolt(), get_active_body_count_jolt(), gravity[0], gravity[1], gravity[2], get_world_triangle_count(), get_rendered_triangle_count());
-        width = 0;
-        height = 1080 - height;
-        add_text_variadic(resss.t, width, height, 1, 1, red, "Frame: %.2lf ms\nFPS: %d\nAverage Frame: %.2lf ms\nAverage FPS: %d\n\nUsing heightmap texture\n\nJolt Body Count: %d\nJolt Active Body Count: %d\nJolt Gravity: {%.2lf | %.2lf | %.2lf}\n\nPress K to change camera\nPress F to disable/enable FXAA\nPress R to disable/enable wireframe render\n\nWhole world triangle count: %d\nCurrently rendering triangle count: %d",
-                          get_frame_timems(), (int)(1000.0 / get_frame_timems()), get_average_frame_timems(), (int)(1000.0 / get_average_frame_timems()), get_body_count_jolt(), get_active_body_count_jolt(), gravity[0], gravity[1], gravity[2], get_world_triangle_count(), get_rendered_triangle_count());
-      }
-    }
+    double sim_start = get_timems();
 
     glfwPollEvents();
     poll_events((GLFWwindow *)window);
@@ -220,7 +599,7 @@ void gameloop(void *window, int **hm, int seedx, int seedz, int dimensionx, int
     }
     else if (freec == 2)
     {
-      run_input_free_camera(resss.cam, (GLFWwindow *)window);
+      run_input_free_camera(resss.sim_cam, (GLFWwindow *)window);
     }
     if (get_key_pressed(GLFW_KEY_R))
     {
@@ -233,64 +612,82 @@ void gameloop(void *window, int **hm, int seedx, int seedz, int dimensionx, int
         wireframe = 0;
       }
     }
-
-    glUseProgram(get_def_shadowmap_br_program());
-    use_lighting_shadowpass(resss.light, get_def_shadowmap_br_program());
-    use_chunk_op(resss.chunks, get_def_shadowmap_br_program(), resss.cam, 0);
-    render_player(resss.p, get_def_shadowmap_br_program());
-
-    if (wireframe == 1)
+    if (get_key_pressed(GLFW_KEY_F))
     {
-      glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+      fxaa = 1 - fxaa;
     }
 
-    glUseProgram(get_def_gbuffer_br_program());
-    use_lighting_gbuffer(resss.light, get_def_gbuffer_br_program(), 1);
-    use_chunk_op(resss.chunks, get_def_gbuffer_br_program(), resss.cam, 0);
-    render_player(resss.p, get_def_gbuffer_br_program());
-
-    glUseProgram(get_def_water_program());
-    use_lighting_gbuffer(resss.light, get_def_water_program(), 0);
-    use_chunk_op(resss.chunks, get_def_water_program(), resss.cam, 1);
-
-    glUseProgram(get_def_skybox_program());
-    use_skybox(resss.s, get_def_skybox_program());
+    run_jolt((float)get_frame_timems() / 1000.0f);
 
-    if (wireframe == 1)
+    // with threaded this waits until the frame before the last one is drawn, so simulation stays one frame ahead
+    frame_snapshot *f = &resss.frames[threaded ? frame_number % 2 : 0];
+    if (threaded)
     {
-      glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+      wait_semaphore(resss.snapshot_free);
     }
-
-    if (ssao)
+    glm_vec3_copy(resss.sim_cam->position, f->cam_position);
+    glm_vec3_copy(resss.sim_cam->orientation, f->cam_orientation);
+    glm_vec3_copy(resss.sim_cam->up, f->cam_up);
+    snapshot_player(resss.p, &f->player);
+    snapshot_chunk_op(resss.chunks, f->chunks);
+    f->terrain_changed = resss.chunks->terrain_changed;
+    f->wireframe = wireframe;
+    f->fxaa = fxaa;
+    f->toggle_csv = get_key_pressed(GLFW_KEY_P);
+    f->frame_ms = get_frame_timems();
+    f->work_ms = get_work_timems();
+    f->average_frame_ms = get_average_frame_timems();
+    f->body_count = get_body_count_jolt();
+    f->active_body_count = get_active_body_count_jolt();
+    get_gravity_jolt(f->gravity);
+    f->sim_ms = get_timems() - sim_start;
+    if (threaded)
     {
-      glUseProgram(get_def_ssao_program());
-      use_lighting_ssao(resss.light, get_def_ssao_program());
-
-      glUseProgram(get_def_ssao_blur_program());
-      use_lighting_ssao_blur(resss.light, get_def_ssao_blur_program());
+      post_semaphore(resss.snapshot_ready);
     }
-
-    glUseProgram(get_def_deferred_br_program());
-    use_lighting_deferred(resss.light, get_def_deferred_br_program());
-
-    glUseProgram(get_def_post_process_program());
-    use_lighting_postprocess(resss.light, get_def_post_process_program());
-
-    glUseProgram(get_def_text_program());
-    use_text_manager(resss.t, get_def_text_program());
-
-    glfwSwapBuffers((GLFWwindow *)window);
-
-    if (get_key_pressed(GLFW_KEY_F))
+    else
     {
-      resss.light->fxaa = 1 - resss.light->fxaa;
+      render_frame(&resss, f);
     }
+    frame_number++;
 
-    run_jolt((float)get_frame_timems() / 1000.0f);
     end_game_loop();
+
+    double now = get_timems();
+    double frame_time = now - frame_start;
+    pushback_DA(frame_times, &frame_time);
+    frame_start = now;
+    if ((run_frames > 0 && (int)get_size_DA(frame_times) >= run_frames) || (run_seconds > 0 && now - run_start >= run_seconds * 1000.0))
+    {
+      glfwSetWindowShouldClose((GLFWwindow *)window, GLFW_TRUE);
+    }
+  }
+  if (threaded)
+  {
+    frame_snapshot *f = &resss.frames[frame_number % 2];
+    wait_semaphore(resss.snapshot_free);
+    f->quit = 1;
+    post_semaphore(resss.snapshot_ready);
+    join_thread(render);
+    glfwMakeContextCurrent(window);
+    reset_gl_state();
+  }
+  if (run_frames > 0 || run_seconds > 0)
+  {
+    print_run_statistics(frame_times);
   }
+  delete_DA(frame_times);
 
+  for (int i = 0; i < 2; i++)
+  {
+    delete_DA(resss.frames[i].chunks);
+  }
+  destroy_semaphore(resss.snapshot_ready);
+  destroy_semaphore(resss.snapshot_free);
+  delete_frame_graph(resss.graph);
+  delete_gpu_timing();
   delete_camera(resss.cam);
+  delete_camera(resss.sim_cam);
   delete_lighting(resss.light);
 
   delete_chunk_op(resss.chunks);
@@ -298,6 +695,7 @@ void gameloop(void *window, int **hm, int seedx, int seedz, int dimensionx, int
   delete_all_physic();
   delete_animations();
   delete_text_manager(resss.t);
+  delete_glyph_atlas(resss.atlas);
   delete_skybox(resss.s);
 
   delete_body_jolt(resss.hm_boxes);
@@ -307,7 +705,8 @@ void gameloop(void *window, int **hm, int seedx, int seedz, int dimensionx, int
 
 void loadmenu(void *window, unsigned char usetexture, float sealevel, int chunk_range, int chunk_size,
               int dimensionx, int dimensionz, int seedx, int seedz, unsigned char loadgsu, unsigned char ssao,
-              unsigned char facemerged, unsigned char chunkanimations)
+              unsigned char facemerged, unsigned char chunkanimations,
+              unsigned char headless, unsigned char threaded, unsigned char demo_lights, int run_frames, double run_seconds)
 {
   int **hm = 0;
   if (usetexture)
@@ -332,7 +731,7 @@ void loadmenu(void *window, unsigned char usetexture, float sealevel, int chunk_
   }
 
   gameloop(window, hm, seedx, seedz, dimensionx, dimensionz, sealevel, chunk_range,
-           chunk_size, loadgsu, ssao, facemerged, chunkanimations);
+           chunk_size, loadgsu, ssao, facemerged, chunkanimations, headless, threaded, demo_lights, run_frames, run_seconds);
 
   for (int i = 0; i < dimensionx; i++)
   {
@@ -1,7 +1,13 @@
 #pragma once
 #include "../core/core.h"
 
+// headless renders offscreen, window has to come from create_window_headless.
+// a run ends after run_frames frames or run_seconds seconds and prints timing statistics, 0 for no limit.
+// threaded draws on a render thread while the main thread simulates the next frame.
+// demo_lights adds point lights around the start to show clustered lighting
+
 void loadmenu(void *window, unsigned char usetexture, float sealevel,
               int chunk_range, int chunk_size, int dimensionx, int dimensionz,
               int seedx, int seedz, unsigned char loadgsu, unsigned char ssao,
-              unsigned char facemerged, unsigned char chunkanimations);
\ No newline at end of file
+              unsigned char facemerged, unsigned char chunkanimations,
+              unsigned char headless, unsigned char threaded, unsigned char demo_lights, int run_frames, double run_seconds);
\ No newline at end of file
@@ -1,18 +1,83 @@
 #include "./core/core.h"
 #include "./game/gameloop.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
-int main(void)
+int main(int argc, char **argv)
 {
 	int windoww = 0;
 	int windowh = 0;
 	unsigned char vsync = 0;
 	unsigned char fullscreen = 1;
-	GLFWwindow *window = create_window(windoww, windowh, fullscreen, vsync, 0);
+
+	// --headless [--size 1280x720] [--frames 1000] [--seconds 30] renders offscreen and prints timing statistics
+	// --threaded renders on its own thread, one frame behind the simulation
+	// --demo-lights puts torches around the start and a lamp on the camera
+	// --fps 144 paces frames without vsync, --frames-in-flight 1 keeps the gpu at most that many frames behind
+	unsigned char headless = 0;
+	unsigned char threaded = 0;
+	unsigned char demo_lights = 0;
+	double target_fps = 0;
+	int frames_in_flight = 0;
+	int run_frames = 0;
+	double run_seconds = 0;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--headless") == 0)
+		{
+			headless = 1;
+		}
+		else if (strcmp(argv[i], "--threaded") == 0)
+		{
+			threaded = 1;
+		}
+		else if (strcmp(argv[i], "--demo-lights") == 0)
+		{
+			demo_lights = 1;
+		}
+		else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc)
+		{
+			sscanf(argv[++i], "%dx%d", &windoww, &windowh);
+		}
+		else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+		{
+			run_frames = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc)
+		{
+			run_seconds = atof(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--fps") == 0 && i + 1 < argc)
+		{
+			target_fps = atof(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--frames-in-flight") == 0 && i + 1 < argc)
+		{
+			frames_in_flight = max(atoi(argv[++i]), 0);
+		}
+	}
+
+	GLFWwindow *window = 0;
+	if (headless)
+	{
+		if (windoww <= 0 || windowh <= 0)
+		{
+			windoww = 1920;
+			windowh = 1080;
+		}
+		window = create_window_headless(windoww, windowh);
+	}
+	else
+	{
+		window = create_window(windoww, windowh, fullscreen, vsync, 0);
+	}
 	if (window == 0)
 	{
 		return -1;
 	}
 	random_seed(get_timems() * get_timems());
+	set_frame_pacer(target_fps, (unsigned int)frames_in_flight);
 	init_programs();
 
 	float sealevel = 25.2f;
@@ -22,14 +87,14 @@ int main(void)
 	int dimensionz = 2048;
 	int seedx = 1453;
 	int seedz = 1071;
-	unsigned char ssao = 0;
+	unsigned char ssao = SSAO_HALF;
 	unsigned char facemerged = 1;
 	unsigned char loadgsu = 0;
 	unsigned char usetexture = 1;
 	unsigned char chunkanimations = 0;
 
 	loadmenu(window, usetexture, sealevel, chunk_range, chunk_size, dimensionx,
-					 dimensionz, seedx, seedz, loadgsu, ssao, facemerged, chunkanimations);
+					 dimensionz, seedx, seedz, loadgsu, ssao, facemerged, chunkanimations, headless, threaded, demo_lights, run_frames, run_seconds);
 
 	destroy_programs();
 	delete_window(window);